@@ -1,6 +1,6 @@
 
 from __future__ import annotations
-from typing import Any
+from typing import Any, Iterator, NamedTuple
 
 import usb
 import struct
@@ -21,14 +21,39 @@ VREQ_INTEGRATION_TIME = 0x2
 VREQ_PL_CTRL = 0x3
 VREQ_MOVING_AVG_N = 0x4
 VREQ_TOTAL_AVG_N = 0x5
+VREQ_DC_CALIB = 0x6
+VREQ_OVERFLOW = 0x7
+VREQ_STREAM = 0x8
+VREQ_STOP = 0x9
+VREQ_STATS = 0xa
+VREQ_AUTO_EXPOSURE = 0xb
+VREQ_ROI = 0xc
+VREQ_BIN = 0xd
+VREQ_DUAL = 0xe
 
 PL_CTRL_DC_OFFSET = 0
 PL_CTRL_MOVAVG_OFFSET = 1
 PL_CTRL_TOTAVG_OFFSET = 2
+FRAME_FLAG_BIN_SUM_OFFSET = 3
+
+# Readout phases timed by the device, in the order of enum bofp1_phase
+PHASES = ('flush', 'dc_calib', 'light', 'sample', 'chunk', 'readout', 'total')
+STATS_BUCKETS = 16
+STATS_FMT = f'<IIIQ{STATS_BUCKETS}I'
 
 DATA_COUNT = 3648
 DATA_SIZE = DATA_COUNT * 2
 
+# Header preceding every frame on the bulk endpoint
+FRAME_MAGIC = 0xb0f1
+FRAME_VERSION = 4
+FRAME_HEADER_FMT = '<HBBIQIHBBHHH'
+FRAME_HEADER_SIZE = struct.calcsize(FRAME_HEADER_FMT)
+
+# Large enough for the header and a full frame, multiple of the max packet
+# size so that a transfer is never cut short
+READ_SIZE = 8192
+
 
 def _ep_find_kind(kind: int) -> callable:
     def match(e: usb.Endpoint) -> bool:
@@ -37,8 +62,86 @@ def _ep_find_kind(kind: int) -> callable:
     return match
 
 
+class FrameHeader(NamedTuple):
+    seq: int
+    timestamp_ns: int
+    integration_time: int
+    pixels: int
+    dc: bool
+    movavg: bool
+    totavg: bool
+    status: int
+    offset: int
+    bin: int
+    bin_sum: bool
+    raw_pixels: int
+
+    @classmethod
+    def unpack(cls, data: bytes) -> FrameHeader:
+        if len(data) < FRAME_HEADER_SIZE:
+            raise ValueError(f'short frame: {len(data)} bytes')
+
+        (magic, version, size, seq, timestamp, int_time, pixels, flags,
+         status, offset, bin_, raw_pixels) = struct.unpack_from(
+             FRAME_HEADER_FMT, data)
+
+        if magic != FRAME_MAGIC:
+            raise ValueError(f'bad frame magic: {magic:#x}')
+        if version != FRAME_VERSION:
+            raise ValueError(f'unsupported frame version: {version}')
+        if size < FRAME_HEADER_SIZE:
+            raise ValueError(f'bad frame header size: {size}')
+
+        return cls(seq=seq, timestamp_ns=timestamp, integration_time=int_time,
+                   pixels=pixels,
+                   dc=bool(flags & (1 << PL_CTRL_DC_OFFSET)),
+                   movavg=bool(flags & (1 << PL_CTRL_MOVAVG_OFFSET)),
+                   totavg=bool(flags & (1 << PL_CTRL_TOTAVG_OFFSET)),
+                   status=status, offset=offset, bin=bin_,
+                   bin_sum=bool(flags & (1 << FRAME_FLAG_BIN_SUM_OFFSET)),
+                   raw_pixels=raw_pixels)
+
+
+class PhaseStats(NamedTuple):
+    """Latency statistics of a readout phase, durations in us
+
+    Bucket i of the histogram counts durations of [2^i, 2^(i+1)) us.
+    """
+    count: int
+    min: int
+    max: int
+    sum: int
+    hist: tuple[int, ...]
+
+    @property
+    def avg(self) -> float:
+        return self.sum / self.count if self.count else 0.0
+
+
 class Frame(tuple):
-    pass
+    header: FrameHeader | None = None
+    # Raw frame of the same exposure, with a dual readout
+    raw: Frame | None = None
+
+    @classmethod
+    def unpack(cls, data: bytes) -> Frame:
+        header = FrameHeader.unpack(data)
+        size = data[3]
+        total = (header.pixels + header.raw_pixels) * 2
+        payload = bytes(data[size:size + total])
+
+        if len(payload) != total:
+            raise ValueError(f'truncated frame {header.seq}: '
+                             f'{len(payload)} of {total} bytes')
+
+        frame = cls(struct.unpack_from(f'<{header.pixels}H', payload))
+        frame.header = header
+
+        if header.raw_pixels:
+            frame.raw = cls(struct.unpack_from(f'<{header.raw_pixels}H',
+                                               payload, header.pixels * 2))
+
+        return frame
 
 
 class Device:
@@ -67,11 +170,13 @@ class Device:
                       data_or_len: int | bytes | None = None,
                       direction: int = USB_MSG_DIR_DEV,
                       type_: int = USB_MSG_TYPE_VENDOR,
-                      recip: int = USB_MSG_RECIP_DEV) -> Any:
+                      recip: int = USB_MSG_RECIP_DEV,
+                      value: int = 0) -> Any:
         bmtype = recip | (type_ << USB_MSG_TYPE_OFFSET) | (
             direction << USB_MSG_DIR_OFFSET)
 
-        return self._dev.ctrl_transfer(bmtype, endpoint, 0, 0, data_or_len)
+        return self._dev.ctrl_transfer(bmtype, endpoint, value, 0,
+                                       data_or_len)
 
     @property
     def integration_time(self) -> int:
@@ -85,6 +190,53 @@ class Device:
         self._ctrl_message(
             VREQ_INTEGRATION_TIME, data, direction=USB_MSG_DIR_DEV)
 
+    @property
+    def auto_exposure(self) -> int:
+        """Target peak of the auto exposure, 0 when disabled"""
+        data = self._ctrl_message(
+            VREQ_AUTO_EXPOSURE, 2, direction=USB_MSG_DIR_HOST)
+        return struct.unpack('<H', data)[0]
+
+    @auto_exposure.setter
+    def auto_exposure(self, target: int) -> None:
+        data = struct.pack('<H', target)
+        self._ctrl_message(
+            VREQ_AUTO_EXPOSURE, data, direction=USB_MSG_DIR_DEV)
+
+    @property
+    def roi(self) -> tuple[int, int]:
+        """First pixel and number of pixels read out, 0 pixels for all"""
+        data = self._ctrl_message(VREQ_ROI, 4, direction=USB_MSG_DIR_HOST)
+        return struct.unpack('<HH', data)
+
+    @roi.setter
+    def roi(self, roi: tuple[int, int]) -> None:
+        data = struct.pack('<HH', *roi)
+        self._ctrl_message(VREQ_ROI, data, direction=USB_MSG_DIR_DEV)
+
+    @property
+    def bin(self) -> tuple[int, bool]:
+        """CCD elements per pixel, and whether they are summed"""
+        data = self._ctrl_message(VREQ_BIN, 2, direction=USB_MSG_DIR_HOST)
+        factor, total = struct.unpack('<BB', data)
+        return factor, bool(total)
+
+    @bin.setter
+    def bin(self, val: tuple[int, bool]) -> None:
+        data = struct.pack('<BB', val[0], val[1])
+        self._ctrl_message(VREQ_BIN, data, direction=USB_MSG_DIR_DEV)
+
+    @property
+    def dual(self) -> bool:
+        """Whether the raw frame is read along with the processed frame"""
+        data = self._ctrl_message(VREQ_DUAL, 1, direction=USB_MSG_DIR_HOST)
+        return bool(data[0])
+
+    @dual.setter
+    def dual(self, val: bool) -> None:
+        data = struct.pack('<B', val)
+        self._ctrl_message(VREQ_DUAL, data, direction=USB_MSG_DIR_DEV)
+
     @property
     def moving_avg_n(self) -> int:
         pass
@@ -112,6 +264,32 @@ class Device:
 
         self._ctrl_message(VREQ_PL_CTRL, data, direction=USB_MSG_DIR_DEV)
 
+    @property
+    def overflow(self) -> int:
+        """Number of frames dropped because the host fell behind"""
+        data = self._ctrl_message(VREQ_OVERFLOW, 4, direction=USB_MSG_DIR_HOST)
+        return struct.unpack('<I', data)[0]
+
+    def phase_stats(self) -> dict[str, PhaseStats]:
+        """Latency statistics of every readout phase"""
+        stats = {}
+        size = struct.calcsize(STATS_FMT)
+
+        for idx, name in enumerate(PHASES):
+            data = self._ctrl_message(VREQ_STATS, size,
+                                      direction=USB_MSG_DIR_HOST, value=idx)
+            count, min_, max_, sum_, *hist = struct.unpack(STATS_FMT, data)
+            stats[name] = PhaseStats(count, min_, max_, sum_, tuple(hist))
+
+        return stats
+
+    def reset_stats(self) -> None:
+        self._ctrl_message(VREQ_STATS)
+
+    def recalibrate(self) -> None:
+        """Force a dark current calibration on the next read"""
+        self._ctrl_message(VREQ_DC_CALIB)
+
     def _begin_read(self) -> None:
         self._ctrl_message(VREQ_BEGIN_READ)
 
@@ -119,12 +297,44 @@ class Device:
         return usb.util.find_descriptor(self.intf,
                                         custom_match=_ep_find_kind(kind))
 
+    def _read(self, ep: usb.core.Endpoint) -> Frame:
+        data = ep.read(READ_SIZE, timeout=self._timeout_ms)
+
+        # The raw frame of a dual readout may span more than one transfer
+        if len(data) >= FRAME_HEADER_SIZE:
+            header = FrameHeader.unpack(data)
+            total = data[3] + (header.pixels + header.raw_pixels) * 2
+
+            while len(data) < total:
+                data += ep.read(READ_SIZE, timeout=self._timeout_ms)
+
+        return Frame.unpack(data)
+
     def read_frame(self, dc: bool = True, movavg: bool = True,
                    totavg: bool = True) -> Frame:
         self._set_pl_ctrl(dc=dc, movavg=movavg, totavg=totavg)
         self._begin_read()
 
-        ep = self._get_ep(usb.util.ENDPOINT_IN)
-        data = ep.read(DATA_SIZE, timeout=self._timeout_ms)
+        return self._read(self._get_ep(usb.util.ENDPOINT_IN))
+
+    def stream(self, n: int = 0, period_us: int = 0, dc: bool = True,
+               movavg: bool = True, totavg: bool = True) -> Iterator[Frame]:
+        """Acquire n frames back to back on the device, 0 until closed
 
-        return Frame(struct.unpack(f'<{len(data)//2}H', data))
+        With a period of 0, frames are acquired as fast as the host reads
+        them. Otherwise, a frame is started every period_us microseconds and
+        frames are dropped if the host falls behind.
+        """
+        self._set_pl_ctrl(dc=dc, movavg=movavg, totavg=totavg)
+        self._ctrl_message(VREQ_STREAM, struct.pack('<II', n, period_us))
+
+        ep = self._get_ep(usb.util.ENDPOINT_IN)
+        received = 0
+
+        try:
+            while n == 0 or received < n:
+                yield self._read(ep)
+                received += 1
+        finally:
+            if n == 0 or received < n:
+                self._ctrl_message(VREQ_STOP)
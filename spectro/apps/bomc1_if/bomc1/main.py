@@ -11,7 +11,9 @@ from bomc1 import Device, Frame
 
 def _do_render(frames: list[Frame]) -> None:
     for idx, x in enumerate(frames):
-        plt.plot(x)
+        offset = x.header.offset if x.header else 0
+        step = x.header.bin if x.header else 1
+        plt.plot(range(offset * step, (offset + len(x)) * step, step), x)
 
     plt.show()
 
@@ -21,13 +23,43 @@ def _do_save(frames: list[Frame], out: Path) -> None:
         json.dump(frames, fp)
 
 
+def _check_seq(frames: list[Frame]) -> None:
+    for prev, cur in zip(frames, frames[1:]):
+        dropped = (cur.header.seq - prev.header.seq - 1) & 0xffffffff
+        if dropped != 0:
+            print(f'warning: {dropped} frame(s) dropped before frame '
+                  f'{cur.header.seq}', file=sys.stderr)
+
+
 def _do_fetch(args: argparse.Namespace) -> None:
     dev = Device.first()
     frames: list[Frame] = []
 
-    for i in range(args.n):
-        frames.append(dev.read_frame(dc=not args.no_dc,
-                      movavg=not args.no_movavg, totavg=not args.no_totavg))
+    if args.recalibrate:
+        dev.recalibrate()
+
+    if args.roi:
+        dev.roi = tuple(args.roi)
+
+    if args.bin:
+        dev.bin = (args.bin, args.bin_sum)
+
+    dev.dual = args.dual
+
+    if args.stream:
+        frames.extend(dev.stream(args.n, period_us=args.period,
+                                 dc=not args.no_dc, movavg=not args.no_movavg,
+                                 totavg=not args.no_totavg))
+    else:
+        for i in range(args.n):
+            frames.append(dev.read_frame(dc=not args.no_dc,
+                          movavg=not args.no_movavg,
+                          totavg=not args.no_totavg))
+
+    _check_seq(frames)
+
+    if args.dual:
+        frames.extend([x.raw for x in frames if x.raw is not None])
 
     if args.with_raw != 0:
         for i in range(args.with_raw):
@@ -52,6 +84,23 @@ def _do_conf(args: argparse.Namespace) -> None:
         print(getattr(dev, args.field))
 
 
+def _do_stats(args: argparse.Namespace) -> None:
+    dev = Device.first()
+
+    print(f'{"phase":<10} {"count":>8} {"min":>10} {"avg":>10} {"max":>10}')
+    for name, stats in dev.phase_stats().items():
+        print(f'{name:<10} {stats.count:>8} {stats.min:>10} '
+              f'{stats.avg:>10.0f} {stats.max:>10}')
+
+        if args.hist:
+            for i, n in enumerate(stats.hist):
+                if n != 0:
+                    print(f'{"":<10} {n:>8} >= {1 << i} us')
+
+    if args.reset:
+        dev.reset_stats()
+
+
 def _create_parser() -> argparse.ArgumentParser:
     parser = argparse.ArgumentParser()
     subs = parser.add_subparsers()
@@ -65,8 +114,29 @@ def _create_parser() -> argparse.ArgumentParser:
     fetch.add_argument('--no-totavg', action='store_true')
     fetch.add_argument('--no-movavg', action='store_true')
     fetch.add_argument('--with-raw', type=int, default=0)
+    fetch.add_argument('--dual', action='store_true',
+                       help='Read the raw frame of every exposure as well')
+    fetch.add_argument('--recalibrate', action='store_true',
+                       help='Recalibrate dark current before fetching')
+    fetch.add_argument('--stream', action='store_true',
+                       help='Acquire all frames in one burst on the device')
+    fetch.add_argument('--period', type=int, default=0,
+                       help='Time between frames in a burst (us)')
+    fetch.add_argument('--roi', type=int, nargs=2, metavar=('START', 'LEN'),
+                       help='Only read out LEN pixels from START (0 for all)')
+    fetch.add_argument('--bin', type=int, choices=(1, 2, 4, 8),
+                       help='CCD elements per pixel')
+    fetch.add_argument('--bin-sum', action='store_true',
+                       help='Sum the elements of a bin instead of averaging')
     fetch.set_defaults(func=_do_fetch)
 
+    stats = subs.add_parser('stats', help='Readout latency per phase (us)')
+    stats.add_argument('--hist', action='store_true',
+                       help='Print the histogram of each phase')
+    stats.add_argument('--reset', action='store_true',
+                       help='Reset the statistics after printing them')
+    stats.set_defaults(func=_do_stats)
+
     inttime = subs.add_parser('conf')
     inttime.add_argument('field', type=str)
     inttime.add_argument('-s', '--set', type=int)
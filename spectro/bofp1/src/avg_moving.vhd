@@ -37,6 +37,11 @@ architecture behaviour of avg_moving is
     signal r_cnt: std_logic_vector(r_n_total'range);
     signal r_cnt_rolled: std_logic;
     signal r_cnt_rst_n: std_logic;
+
+    signal r_div_in_rdy: std_logic;
+    signal r_div_rdy: std_logic;
+    signal r_div_data: std_logic_vector(r_sum'range);
+    signal r_div_busy: std_logic;
 begin
 
     u_fifo: entity work.window_fifo
@@ -126,35 +131,34 @@ begin
         end if;
     end process p_shift;
 
-    -- Calculate next value
-    p_calc: process(i_clk)
-        variable val: unsigned(r_sum'range);
-    begin
-        if rising_edge(i_clk) then
-            if i_rdy = '1' then
-                val := const_div(r_sum, r_n_total, 64);
-                o_data <= std_logic_vector(resize(val, o_data'length));
-            end if;
-        end if;
-    end process p_calc;
+    -- Calculate next value, only when not at the edges of the frame. The
+    -- division is pipelined, so o_rdy follows i_rdy a few cycles later.
+    r_div_in_rdy <= i_rdy when r_state = S_NORMAL else '0';
 
-    -- Signal ready when not at the edges of the frame. In this case,
-    -- o_rdy becomes the value of i_rdy delayed by one cycle.
-    p_rdy: process(i_clk)
-    begin
-        if rising_edge(i_clk) then
-            o_rdy <= '0';
+    u_div: entity work.div_pipe
+        generic map(
+            G_WIDTH => r_sum'length,
+            G_DIV_WIDTH => r_n_total'length
+        )
+        port map(
+            i_clk => i_clk,
+            i_rst_n => i_rst_n,
+            i_divisor => std_logic_vector(r_n_total),
+            i_rdy => r_div_in_rdy,
+            i_data => std_logic_vector(r_sum),
+            o_rdy => r_div_rdy,
+            o_data => r_div_data,
+            o_busy => r_div_busy
+        );
 
-            if r_state = S_NORMAL then
-                o_rdy <= i_rdy;
-            end if;
-        end if;
-    end process p_rdy;
+    o_rdy <= r_div_rdy;
+    o_data <= std_logic_vector(resize(unsigned(r_div_data), o_data'length));
 
+    -- Stay busy until the last division is out
     p_busy: process(i_clk)
     begin
         if rising_edge(i_clk) then
-            o_busy <= i_en;
+            o_busy <= i_en or r_div_busy;
         end if;
     end process p_busy;
 
@@ -1,10 +1,14 @@
-
 library ieee;
 use ieee.std_logic_1164.all;
 use ieee.numeric_std.all;
 
-use work.utils.all;
-
+-- Average N frames pixel by pixel.
+--
+-- The running sums are kept in two RAM banks that swap roles every frame,
+-- one being read while the other is written, so that a pixel can be
+-- accepted every clock cycle. A pixel is read from memory on i_rdy, added
+-- to the sum three cycles later and then either written back or, for the
+-- last frame, divided by N in a pipelined divider.
 entity avg_total is
     port (
         i_clk: in std_logic;
@@ -12,7 +16,7 @@ entity avg_total is
         i_en: in std_logic;
         i_rdy: in std_logic;
         i_data: in std_logic_vector(15 downto 0);
-        i_n: in std_logic_vector(3 downto 0);
+        i_n: in std_logic_vector(7 downto 0);
         o_busy: out std_logic;
         o_rdy: out std_logic;
         o_data: out std_logic_vector(15 downto 0)
@@ -20,75 +24,84 @@ entity avg_total is
 end entity avg_total;
 
 architecture behaviour of avg_total is
-    type t_frame_state is (S_FRAME_IDLE, S_FIRST, S_NORMAL, S_LAST);
-    signal r_frame_state: t_frame_state;
+    -- Large enough for the sum of 255 frames
+    constant c_sum_width: integer := i_data'length + i_n'length;
 
-    type t_pix_state is (S_PIX_IDLE, S_CALC_ADD, S_CALC_DIV, S_STORE, S_LOAD, S_READY);
-    signal r_pix_state: t_pix_state;
+    -- Cycles from i_rdy until the sum is read from memory
+    constant c_rd_delay: integer := 3;
 
-    signal r_en_fall: std_logic;
-    signal r_cnt_rst_n: std_logic;
-    signal r_cnt_roll: std_logic;
+    subtype t_sum is unsigned(c_sum_width-1 downto 0);
+    subtype t_addr is unsigned(11 downto 0);
 
-    signal r_rd_en: std_logic;
-    signal r_wr_en: std_logic;
+    type t_pix is record
+        rdy: std_logic;
+        first: boolean;
+        last: boolean;
+        bank: std_logic;
+        addr: t_addr;
+        data: unsigned(i_data'range);
+    end record t_pix;
 
-    signal r_val_add: unsigned(20 downto 0);
-    signal r_val: unsigned(20 downto 0);
-    signal r_memval: std_logic_vector(20 downto 0);
-    signal r_addr: unsigned(11 downto 0);
-    signal r_single: boolean;
-    signal r_double: boolean;
+    type t_pix_pipe is array(1 to c_rd_delay) of t_pix;
+    signal r_pipe: t_pix_pipe;
 
-    signal r_loaded: boolean;
-begin
-    -- Keep temporary values in memory
-    u_ram: entity work.frame_ram
-        generic map(
-            C_WIDTH => 21
-        )
-        port map(
-            i_clk => i_clk,
-            i_rst_n => i_rst_n,
-            i_addr => std_logic_vector(r_addr),
-            i_wr_en => r_wr_en,
-            i_rd_en => r_rd_en,
-            i_wr_data => std_logic_vector(r_val),
-            o_rd_data => r_memval
-        );
+    constant c_bank_sel: std_logic_vector(0 to 1) := "01";
 
-    -- Don't count when in idle
-    r_cnt_rst_n <= '0' when (i_rst_n = '0' or r_frame_state = S_FRAME_IDLE) else '1';
+    type t_bank_addr is array(0 to 1) of std_logic_vector(11 downto 0);
+    type t_bank_data is array(0 to 1) of std_logic_vector(t_sum'range);
+    signal r_bank_addr: t_bank_addr;
+    signal r_bank_wr_en: std_logic_vector(0 to 1);
+    signal r_bank_rd_en: std_logic_vector(0 to 1);
+    signal r_bank_data: t_bank_data;
 
-    p_n_cases: process(i_clk)
-    begin
-        if rising_edge(i_clk) then
-            r_single <= false;
-            r_double <= false;
+    signal r_en_fall: std_logic;
 
-            if i_rst_n = '0' then
-                r_single <= true;
-            else
-                if unsigned(i_n) = 1 then
-                    r_single <= true;
-                elsif unsigned(i_n) = 2 then
-                    r_double <= true;
-                end if;
-            end if;
-        end if;
-    end process p_n_cases;
+    signal r_n: unsigned(i_n'range);
+    signal r_frame: unsigned(i_n'range);
+    signal r_first: boolean;
+    signal r_last: boolean;
 
-    u_cnt_fall: entity work.counter
-        generic map(
-            G_WIDTH => i_n'length
-        )
-        port map(
-            i_clk => i_clk,
-            i_rst_n => r_cnt_rst_n,
-            i_en => r_en_fall,
-            i_max => std_logic_vector(unsigned(i_n) - 1),
-            o_roll => r_cnt_roll
-        );
+    -- Bank read from during the current frame, the other one is written
+    signal r_bank: std_logic;
+    signal r_addr: t_addr;
+
+    signal r_sum: t_sum;
+    signal r_sum_rdy: std_logic;
+    signal r_sum_last: boolean;
+    signal r_sum_bank: std_logic;
+    signal r_sum_addr: t_addr;
+
+    -- Pixels are still on their way to the output
+    signal r_inflight: std_logic;
+
+    signal r_div_in_rdy: std_logic;
+    signal r_div_rdy: std_logic;
+    signal r_div_busy: std_logic;
+    signal r_div_data: std_logic_vector(t_sum'range);
+begin
+    g_bank: for i in 0 to 1 generate
+        u_ram: entity work.frame_ram
+            generic map(
+                C_WIDTH => c_sum_width
+            )
+            port map(
+                i_clk => i_clk,
+                i_rst_n => i_rst_n,
+                i_addr => r_bank_addr(i),
+                i_wr_en => r_bank_wr_en(i),
+                i_rd_en => r_bank_rd_en(i),
+                i_wr_data => std_logic_vector(r_sum),
+                o_rd_data => r_bank_data(i)
+            );
+
+        r_bank_wr_en(i) <= '1' when r_sum_rdy = '1' and not r_sum_last and
+                                    r_sum_bank /= c_bank_sel(i) else '0';
+        r_bank_rd_en(i) <= '1' when i_rdy = '1' and not r_first and
+                                    r_bank = c_bank_sel(i) else '0';
+        r_bank_addr(i) <= std_logic_vector(r_sum_addr)
+                          when r_bank_wr_en(i) = '1'
+                          else std_logic_vector(r_addr);
+    end generate g_bank;
 
     -- Detect falling edge of enable signal. This is used to detect the end
     -- of a frame.
@@ -104,175 +117,118 @@ begin
             o_edge => r_en_fall
         );
 
-    -- Load from memory whenever going into a non S_FIRST state (for the
-    -- first element) or when i_rdy=1 (for all other elements). This causes
-    -- r_memval to be updated the cycle after the computation has completed,
-    -- so that it is ready for when the next computation is to be done.
-    p_load: process(i_clk)
+    -- Count frames, and swap the banks after every frame. N is only taken
+    -- in between averages so that it can't change halfway through.
+    p_frame: process(i_clk)
     begin
         if rising_edge(i_clk) then
-            r_loaded <= true;
-            r_rd_en <= '0';
-
-            if r_frame_state = S_FRAME_IDLE or i_en = '0' then
-                r_loaded <= false;
-            elsif not r_loaded or r_pix_state = S_LOAD then
-                r_rd_en <= '1';
+            if i_rst_n = '0' then
+                r_frame <= (others => '0');
+                r_bank <= '0';
+            elsif r_en_fall = '1' then
+                r_bank <= not r_bank;
+
+                if r_last then
+                    r_frame <= (others => '0');
+                else
+                    r_frame <= r_frame + 1;
+                end if;
             end if;
-        end if;
-    end process p_load;
 
-    -- Write to memory, unless in the last state
-    p_store: process(i_clk)
-    begin
-        if rising_edge(i_clk) then
-            r_wr_en <= '0';
-
-            if r_pix_state = S_STORE and r_frame_state /= S_LAST and not r_single then
-                r_wr_en <= '1';
+            if r_frame = 0 and i_en = '0' and r_inflight = '0' then
+                if unsigned(i_n) = 0 then
+                    r_n <= to_unsigned(1, r_n'length);
+                else
+                    r_n <= unsigned(i_n);
+                end if;
             end if;
         end if;
-    end process p_store;
+    end process p_frame;
 
-    -- Update read/write address after writing to RAM
-    -- This does not handle overflow checking but resets to 0 when the pipeline
-    -- stage is not active.
+    r_first <= r_frame = 0;
+    r_last <= r_frame = r_n - 1;
+
+    -- Reset the address in between frames
     p_addr: process(i_clk)
     begin
         if rising_edge(i_clk) then
             if i_rst_n = '0' or i_en = '0' then
                 r_addr <= (others => '0');
-            elsif r_pix_state = S_LOAD then
+            elsif i_rdy = '1' then
                 r_addr <= r_addr + 1;
             end if;
         end if;
     end process p_addr;
 
-    -- Add to the sum
-    p_calc_add: process(i_clk)
+    -- Carry each pixel along until its sum has been read from memory
+    p_pipe: process(i_clk)
     begin
         if rising_edge(i_clk) then
-            if r_pix_state = S_CALC_ADD and i_rdy = '1' then
-                case r_frame_state is
-                    when S_FIRST =>
-                        r_val_add <= resize(unsigned(i_data), r_val_add'length);
-
-                    when S_NORMAL | S_LAST =>
-                        r_val_add <= resize(
-                                     unsigned(r_memval) + unsigned(i_data),
-                                     r_val_add'length);
-
-                    when others => null;
-                end case;
-            end if;
-        end if;
-    end process p_calc_add;
+            r_pipe(1).rdy <= i_rdy;
+            r_pipe(1).first <= r_first;
+            r_pipe(1).last <= r_last;
+            r_pipe(1).bank <= r_bank;
+            r_pipe(1).addr <= r_addr;
+            r_pipe(1).data <= unsigned(i_data);
 
-    -- Divide the sum by N, if in the last state
-    p_calc_div: process(i_clk)
-    begin
-        if rising_edge(i_clk) then
-            if r_pix_state = S_CALC_DIV then
-                case r_frame_state is
-                    when S_FIRST | S_NORMAL =>
-                        r_val <= r_val_add;
-
-                    when S_LAST =>
-                        r_val <= const_div(r_val_add, unsigned(i_n), 61);
+            r_pipe(2 to r_pipe'high) <= r_pipe(1 to r_pipe'high-1);
 
-                    when others => null;
-                end case;
+            if i_rst_n = '0' then
+                for i in r_pipe'range loop
+                    r_pipe(i).rdy <= '0';
+                end loop;
             end if;
         end if;
-    end process p_calc_div;
+    end process p_pipe;
 
-    p_pix_state: process(i_clk)
+    -- Add to the sum
+    p_sum: process(i_clk)
+        variable v_pix: t_pix;
     begin
         if rising_edge(i_clk) then
-            if i_rst_n = '0' or i_en = '0' then
-                r_pix_state <= S_PIX_IDLE;
-            else
-                case r_pix_state is
-                    when S_PIX_IDLE =>
-                        r_pix_state <= S_CALC_ADD;
-
-                    when S_CALC_ADD =>
-                        if i_rdy = '1' then
-                            r_pix_state <= S_CALC_DIV;
-                        end if;
-
-                    when S_CALC_DIV =>
-                        r_pix_state <= S_STORE;
-
-                    when S_STORE =>
-                        r_pix_state <= S_LOAD;
+            v_pix := r_pipe(r_pipe'high);
 
-                    when S_LOAD =>
-                        r_pix_state <= S_READY;
-
-                    when S_READY =>
-                        r_pix_state <= S_PIX_IDLE;
-
-                end case;
-            end if;
-        end if;
-    end process p_pix_state;
-
-    -- Handle state changes in between frames
-    p_frame_state: process(i_clk)
-    begin
-        if rising_edge(i_clk) then
-            if i_rst_n = '0' then
-                r_frame_state <= S_FRAME_IDLE;
+            if v_pix.first then
+                r_sum <= resize(v_pix.data, r_sum'length);
+            elsif v_pix.bank = '0' then
+                r_sum <= unsigned(r_bank_data(0)) + v_pix.data;
             else
-                case r_frame_state is
-                    when S_FRAME_IDLE =>
-                        if i_en = '1' then
-                            r_frame_state <= S_FIRST;
-                        end if;
-
-                    when S_FIRST =>
-                        if r_en_fall = '1' then
-                            if r_single then
-                                r_frame_state <= S_FRAME_IDLE;
-                            elsif r_double then
-                                r_frame_state <= S_LAST;
-                            else
-                                r_frame_state <= S_NORMAL;
-                            end if;
-                        end if;
-
-                    when S_NORMAL =>
-                        if r_cnt_roll = '1' then
-                            r_frame_state <= S_LAST;
-                        end if;
-
-                    when S_LAST =>
-                        if r_en_fall = '1' then
-                            r_frame_state <= S_FRAME_IDLE;
-                        end if;
-
-                end case;
+                r_sum <= unsigned(r_bank_data(1)) + v_pix.data;
             end if;
-        end if;
-    end process p_frame_state;
 
-    p_rdy: process(all)
-    begin
-        if r_pix_state = S_READY then
-            if r_frame_state = S_LAST then
-                o_rdy <= '1';
-            elsif r_frame_state = S_FIRST and r_single then
-                o_rdy <= '1';
-            else
-                o_rdy <= '0';
-            end if;
-        else
-            o_rdy <= '0';
+            r_sum_rdy <= v_pix.rdy and i_rst_n;
+            r_sum_last <= v_pix.last;
+            r_sum_bank <= v_pix.bank;
+            r_sum_addr <= v_pix.addr;
         end if;
-    end process p_rdy;
+    end process p_sum;
+
+    -- Divide the sum by N, if in the last frame
+    r_div_in_rdy <= '1' when r_sum_rdy = '1' and r_sum_last else '0';
+
+    u_div: entity work.div_pipe
+        generic map(
+            G_WIDTH => c_sum_width,
+            G_DIV_WIDTH => i_n'length
+        )
+        port map(
+            i_clk => i_clk,
+            i_rst_n => i_rst_n,
+            i_divisor => std_logic_vector(r_n),
+            i_rdy => r_div_in_rdy,
+            i_data => std_logic_vector(r_sum),
+            o_rdy => r_div_rdy,
+            o_data => r_div_data,
+            o_busy => r_div_busy
+        );
+
+    o_rdy <= r_div_rdy;
+    o_data <= r_div_data(o_data'range);
+    r_inflight <= '1' when r_pipe(1).rdy = '1' or r_pipe(2).rdy = '1' or
+                           r_pipe(3).rdy = '1' or r_sum_rdy = '1' or
+                           r_div_busy = '1' else '0';
 
-    o_data <= std_logic_vector(r_val(o_data'range));
-    o_busy <= '1' when r_frame_state /= S_FRAME_IDLE else '0';
+    o_busy <= '1' when i_en = '1' or r_frame /= 0 or r_inflight = '1'
+              else '0';
 
 end architecture behaviour;
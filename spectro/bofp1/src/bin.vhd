@@ -0,0 +1,79 @@
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+-- Combine 2^i_shift adjacent pixels into one, either by summing them or by
+-- averaging them. Sums saturate at the maximum pixel value. Pixels at the
+-- end of the frame that do not fill an entire bin are dropped.
+entity bin is
+    port (
+        i_clk: in std_logic;
+        i_rst_n: in std_logic;
+        i_en: in std_logic;
+        i_rdy: in std_logic;
+        i_shift: in std_logic_vector(1 downto 0);
+        i_sum: in std_logic;
+        i_data: in std_logic_vector(15 downto 0);
+        o_busy: out std_logic;
+        o_rdy: out std_logic;
+        o_data: out std_logic_vector(15 downto 0)
+    );
+end entity bin;
+
+architecture behaviour of bin is
+    constant c_data_max: unsigned(15 downto 0) := (others => '1');
+
+    signal r_acc: unsigned(18 downto 0);
+    signal r_cnt: unsigned(2 downto 0);
+begin
+    p_acc: process(i_clk)
+        variable v_acc: unsigned(r_acc'range);
+        variable v_last: unsigned(r_cnt'range);
+    begin
+        if rising_edge(i_clk) then
+            o_rdy <= '0';
+
+            v_acc := r_acc + unsigned(i_data);
+            v_last := to_unsigned(2**to_integer(unsigned(i_shift)) - 1,
+                                  v_last'length);
+
+            if i_rst_n = '0' then
+                r_acc <= (others => '0');
+                r_cnt <= (others => '0');
+            elsif i_rdy = '1' then
+                if r_cnt = v_last then
+                    o_rdy <= '1';
+                    r_acc <= (others => '0');
+                    r_cnt <= (others => '0');
+
+                    if i_sum = '0' then
+                        o_data <= std_logic_vector(resize(
+                            shift_right(v_acc, to_integer(unsigned(i_shift))),
+                            o_data'length));
+                    elsif v_acc > c_data_max then
+                        o_data <= std_logic_vector(c_data_max);
+                    else
+                        o_data <= std_logic_vector(resize(v_acc,
+                                                          o_data'length));
+                    end if;
+                else
+                    r_acc <= v_acc;
+                    r_cnt <= r_cnt + 1;
+                end if;
+            elsif i_en = '0' then
+                -- Drop a partial bin at the end of the frame
+                r_acc <= (others => '0');
+                r_cnt <= (others => '0');
+            end if;
+        end if;
+    end process p_acc;
+
+    p_busy: process(i_clk)
+    begin
+        if rising_edge(i_clk) then
+            o_busy <= i_en;
+        end if;
+    end process p_busy;
+
+end architecture behaviour;
@@ -23,16 +23,22 @@ entity bofp1 is
         o_adc_stconv: out std_logic;
 
         o_fifo_wmark: out std_logic;
+        -- External capture trigger, only used in trigger mode
+        i_trigger: in std_logic;
 
         i_spi_main_miso: in std_logic;
         o_spi_main_mosi: out std_logic;
         o_spi_main_sclk: out std_logic;
         o_spi_main_cs_n: out std_logic;
 
+        -- MCU link, with the pin mapping of a quad SPI memory. IO0 (MOSI)
+        -- and IO2/IO3 are only driven while streaming on multiple lanes
         i_spi_sub_sclk: in std_logic;
         i_spi_sub_cs_n: in std_logic;
-        i_spi_sub_mosi: in std_logic;
-        o_spi_sub_miso: out std_logic
+        io_spi_sub_mosi: inout std_logic;
+        o_spi_sub_miso: out std_logic;
+        o_spi_sub_io2: out std_logic;
+        o_spi_sub_io3: out std_logic
     );
 end entity bofp1;
 
@@ -51,13 +57,18 @@ architecture structural of bofp1 is
     signal r_fifo_raw_data: std_logic_vector(15 downto 0);
 
     signal r_ccd_flush: std_logic;
+    signal r_fir_coef_wr: std_logic;
 
     -- Generated clocks
     signal r_adc_sclk2: std_logic;
     signal r_clk_main: std_logic;
 
     signal r_regmap: t_regmap;
+
+    signal r_spi_sub_io: std_logic_vector(3 downto 0);
+    signal r_spi_sub_io_oe: std_logic_vector(3 downto 0);
     signal r_errors: t_err_bitmap;
+    signal r_stats: t_frame_stats;
 begin
     r_rst_n <= not r_rst;
     r_rst <= '1' when r_rst_gen = '1' or i_rst_n = '0' else '0';
@@ -88,6 +99,7 @@ begin
             i_clk => r_clk_main,
             i_rst_n => r_rst_n,
             i_start => r_cap_start,
+            i_trigger => i_trigger,
             i_regmap => r_regmap,
 
             i_adc_eoc => i_adc_eoc,
@@ -109,8 +121,10 @@ begin
 
             i_ccd_flush => r_ccd_flush,
             i_dc_calib => r_dc_calib,
+            i_fir_coef_wr => r_fir_coef_wr,
 
             o_fifo_wmark => o_fifo_wmark,
+            o_stats => r_stats,
             o_errors => r_errors
         );
 
@@ -123,8 +137,9 @@ begin
 
             i_sclk => i_spi_sub_sclk,
             i_cs_n => i_spi_sub_cs_n,
-            i_mosi => i_spi_sub_mosi,
-            o_miso => o_spi_sub_miso,
+            i_mosi => io_spi_sub_mosi,
+            o_io => r_spi_sub_io,
+            o_io_oe => r_spi_sub_io_oe,
 
             i_fifo_pl_data => r_fifo_pl_data,
             i_fifo_raw_data => r_fifo_raw_data,
@@ -133,9 +148,17 @@ begin
 
             o_dc_calib => r_dc_calib,
             o_ccd_flush => r_ccd_flush,
+            o_fir_coef_wr => r_fir_coef_wr,
+
+            i_stats => r_stats,
 
             i_errors => r_errors,
             io_regmap => r_regmap
         );
 
+    io_spi_sub_mosi <= r_spi_sub_io(0) when r_spi_sub_io_oe(0) = '1' else 'Z';
+    o_spi_sub_miso <= r_spi_sub_io(1);
+    o_spi_sub_io2 <= r_spi_sub_io(2) when r_spi_sub_io_oe(2) = '1' else 'Z';
+    o_spi_sub_io3 <= r_spi_sub_io(3) when r_spi_sub_io_oe(3) = '1' else 'Z';
+
 end architecture structural;
@@ -13,6 +13,9 @@ entity capture is
         i_clk: in std_logic;
         i_rst_n: in std_logic;
         i_start: in std_logic;
+        -- External trigger, asynchronous. Starts a capture on a rising edge
+        -- in trigger mode
+        i_trigger: in std_logic;
         i_regmap: in t_regmap;
 
         i_adc_eoc: in std_logic;
@@ -33,10 +36,14 @@ entity capture is
 
         i_dc_calib: in std_logic;
         i_ccd_flush: in std_logic;
+        -- Store the FIR coefficient in REG_FIR_COEF1/2 at REG_FIR_ADDR
+        i_fir_coef_wr: in std_logic;
 
         o_busy: out std_logic;
         o_fifo_wmark: out std_logic;
 
+        o_stats: out t_frame_stats;
+
         o_errors: out t_err_bitmap
     );
 end entity capture;
@@ -51,6 +58,9 @@ architecture behaviour of capture is
     signal r_total_avg_rdy_out: std_logic;
     signal r_total_avg_data_out: std_logic_vector(r_ccd_data_out'range);
     signal r_total_avg_en: std_logic;
+    signal r_total_avg_n: std_logic_vector(7 downto 0);
+    -- A calibration averages REG_DC_FRAMES dark frames in the total average
+    signal r_dc_avg: std_logic;
 
     signal r_moving_avg_rdy_in: std_logic;
     signal r_moving_avg_rdy_out: std_logic;
@@ -60,6 +70,15 @@ architecture behaviour of capture is
     signal r_moving_avg_busy_out: std_logic;
     signal r_moving_avg_en: std_logic;
 
+    -- FIR filter in place of the moving average, when it has any taps
+    signal r_fir_ena: std_logic;
+    signal r_fir_rdy_out: std_logic;
+    signal r_fir_data_out: std_logic_vector(r_ccd_data_out'range);
+    signal r_fir_busy_out: std_logic;
+    signal r_boxcar_rdy_out: std_logic;
+    signal r_boxcar_data_out: std_logic_vector(r_ccd_data_out'range);
+    signal r_boxcar_busy_out: std_logic;
+
     signal r_dc_rdy_in: std_logic;
     signal r_dc_rdy_out: std_logic;
     signal r_dc_data_in: std_logic_vector(r_ccd_data_out'range);
@@ -69,16 +88,37 @@ architecture behaviour of capture is
     signal r_dc_calib: std_logic;
     signal r_dc_en: std_logic;
 
+    signal r_bin_rdy_in: std_logic;
+    signal r_bin_rdy_out: std_logic;
+    signal r_bin_data_in: std_logic_vector(r_ccd_data_out'range);
+    signal r_bin_data_out: std_logic_vector(r_ccd_data_out'range);
+    signal r_bin_busy_in: std_logic;
+    signal r_bin_busy_out: std_logic;
+    signal r_bin_en: std_logic;
+
     signal r_pl_rdy: std_logic;
     signal r_pl_busy: std_logic;
     signal r_pl_data: std_logic_vector(r_ccd_data_out'range);
 
     signal r_fifo_pl_wmark: std_logic;
+    signal r_fifo_pl_data: std_logic_vector(15 downto 0);
+    signal r_frame_buf_wmark: std_logic;
+    signal r_frame_buf_data: std_logic_vector(15 downto 0);
+    signal r_frame_buf_en: std_logic;
     signal r_fifo_raw_wmark: std_logic;
+    signal r_fifo_wmark_level: unsigned(11 downto 0);
 
     signal r_fifo_raw_wr: std_logic;
     signal r_fifo_pl_wr: std_logic;
 
+    signal r_stats_rdy: std_logic;
+    signal r_stats_latch: std_logic;
+
+    -- Index of the next pixel leaving the pipeline, and whether it is inside
+    -- the region of interest
+    signal r_pl_idx: unsigned(15 downto 0);
+    signal r_roi: std_logic;
+
     type t_state is (
         S_IDLE, S_STARTING, S_WAITING, S_RUNNING,
         S_STOP_WAIT, S_STOPPING
@@ -87,10 +127,28 @@ architecture behaviour of capture is
 
     signal r_stop_buf: std_logic_vector(5 downto 0);
     signal r_stop: std_logic;
+
+    -- Captures started without the MCU, in continuous or trigger mode
+    signal r_mode: std_logic_vector(1 downto 0);
+    signal r_mode_last: std_logic_vector(1 downto 0);
+    signal r_trig_buf: std_logic;
+    signal r_trig_unsafe: std_logic;
+    signal r_trig_edge: std_logic;
+    signal r_trig_pending: std_logic;
+    signal r_auto_start: std_logic;
+    signal r_start: std_logic;
+
+    attribute ASYNC_REG: boolean;
+    attribute ASYNC_REG of r_trig_unsafe : signal is true;
 begin
     r_ccd_start <= '1' when r_state = S_STARTING else '0';
-    r_fifo_pl_wr <= r_pl_rdy and not r_dc_calib;
+    r_stats_rdy <= r_pl_rdy and not r_dc_calib;
+    r_fifo_pl_wr <= r_stats_rdy and r_roi and
+                    not get_prc(i_regmap, PRC_STATS_ONLY);
     r_fifo_raw_wr <= r_ccd_rdy_out and not r_dc_calib;
+    r_frame_buf_en <= get_prc(i_regmap, PRC_FRAME_BUF);
+    r_fifo_wmark_level <= resize(unsigned(get_reg(i_regmap, REG_FIFO_WMARK)) *
+                                 c_fifo_wmark_unit, 12);
 
     u_ccd: entity work.tcd1304(rtl)
         generic map(
@@ -105,6 +163,7 @@ begin
             i_sh_div => get_reg(i_regmap, REG_SHDIV1) &
                         get_reg(i_regmap, REG_SHDIV2) &
                         get_reg(i_regmap, REG_SHDIV3),
+            i_mclk_div => get_reg(i_regmap, REG_MCLK_DIV),
             
             i_adc_eoc => i_adc_eoc,
             o_adc_stconv => o_adc_stconv,
@@ -122,6 +181,8 @@ begin
             o_data => r_ccd_data_out
         );
 
+    -- The raw FIFO is only read out in a dual readout, so it is cleared for
+    -- every sample to drop the data of frames that were not read.
     u_fifo_raw: entity work.frame_fifo
         generic map(
             C_OVERFLOW => ERR_FIFO_RAW_OVERFLOW,
@@ -130,8 +191,10 @@ begin
         port map(
             i_clk => i_clk,
             i_rst_n => i_rst_n,
+            i_clear => r_start,
             i_wr => r_fifo_raw_wr,
             i_data => r_ccd_data_out,
+            i_wmark_level => r_fifo_wmark_level,
             i_rd => i_fifo_raw_rd,
             o_data => o_fifo_raw_data,
             o_watermark => r_fifo_raw_wmark,
@@ -142,7 +205,7 @@ begin
         port map(
             i_clk => i_clk,
             i_rst_n => i_rst_n,
-            i_n => get_reg(i_regmap, REG_TOTAL_AVG_N)(3 downto 0),
+            i_n => r_total_avg_n,
             i_data => r_ccd_data_out,
             i_en => r_ccd_busy_out and r_total_avg_en,
             i_rdy => r_ccd_rdy_out,
@@ -151,12 +214,19 @@ begin
             o_busy => r_total_avg_busy_out
         );
 
+    r_dc_avg <= '1' when r_dc_calib = '1' and
+                         unsigned(get_reg(i_regmap, REG_DC_FRAMES)) /= 0
+                else '0';
+    r_total_avg_n <= get_reg(i_regmap, REG_DC_FRAMES) when r_dc_avg = '1'
+                     else get_reg(i_regmap, REG_TOTAL_AVG_N);
+
     u_totavg_ctrl: entity work.stage_ctrl
         generic map(
             C_FIELD => PRC_TOTAVG_ENA
         )
         port map(
             i_regmap => i_regmap,
+            i_force => r_dc_avg,
             i_rdy_raw => r_ccd_rdy_out,
             i_busy_raw => r_ccd_busy_out,
             i_data_raw => r_ccd_data_out,
@@ -174,14 +244,42 @@ begin
             i_clk => i_clk,
             i_rst_n => i_rst_n,
             i_n => get_reg(i_regmap, REG_MOVING_AVG_N)(3 downto 0),
-            i_en => r_moving_avg_busy_in and r_moving_avg_en,
+            i_en => r_moving_avg_busy_in and r_moving_avg_en and
+                    not r_fir_ena,
+            i_rdy => r_moving_avg_rdy_in,
+            i_data => r_moving_avg_data_in,
+            o_busy => r_boxcar_busy_out,
+            o_rdy => r_boxcar_rdy_out,
+            o_data => r_boxcar_data_out
+        );
+
+    r_fir_ena <= '1' when unsigned(get_reg(i_regmap, REG_FIR_TAPS)) /= 0
+                 else '0';
+
+    u_fir: entity work.fir
+        port map(
+            i_clk => i_clk,
+            i_rst_n => i_rst_n,
+            i_taps => get_reg(i_regmap, REG_FIR_TAPS)(6 downto 0),
+            i_en => r_moving_avg_busy_in and r_moving_avg_en and r_fir_ena,
             i_rdy => r_moving_avg_rdy_in,
             i_data => r_moving_avg_data_in,
-            o_busy => r_moving_avg_busy_out,
-            o_rdy => r_moving_avg_rdy_out,
-            o_data => r_moving_avg_data_out
+            i_coef_wr => i_fir_coef_wr,
+            i_coef_addr => get_reg(i_regmap, REG_FIR_ADDR)(5 downto 0),
+            i_coef => get_reg(i_regmap, REG_FIR_COEF1) &
+                      get_reg(i_regmap, REG_FIR_COEF2),
+            o_busy => r_fir_busy_out,
+            o_rdy => r_fir_rdy_out,
+            o_data => r_fir_data_out
         );
 
+    r_moving_avg_busy_out <= r_fir_busy_out when r_fir_ena
+                             else r_boxcar_busy_out;
+    r_moving_avg_rdy_out <= r_fir_rdy_out when r_fir_ena
+                            else r_boxcar_rdy_out;
+    r_moving_avg_data_out <= r_fir_data_out when r_fir_ena
+                             else r_boxcar_data_out;
+
     u_movavg_ctrl: entity work.stage_ctrl
         generic map(
             C_FIELD => PRC_MOVAVG_ENA
@@ -205,6 +303,7 @@ begin
             i_clk => i_clk,
             i_rst_n => i_rst_n,
             i_calib => i_dc_calib,
+            i_slot => get_reg(i_regmap, REG_DC_SLOT)(c_dc_slot_bits-1 downto 0),
             i_en => r_dc_busy_in and r_dc_en,
             i_rdy => r_dc_rdy_in,
             i_data => r_dc_data_in,
@@ -226,10 +325,97 @@ begin
             i_rdy_pl => r_dc_rdy_out,
             i_busy_pl => r_dc_busy_out,
             i_data_pl => r_dc_data_out,
+            o_rdy => r_bin_rdy_in,
+            o_busy => r_bin_busy_in,
+            o_data => r_bin_data_in,
+            o_en => r_dc_en
+        );
+
+    u_bin: entity work.bin
+        port map(
+            i_clk => i_clk,
+            i_rst_n => i_rst_n,
+            i_en => r_bin_busy_in and r_bin_en,
+            i_rdy => r_bin_rdy_in,
+            i_shift => get_reg(i_regmap, REG_BIN)(c_bin_shift_hi downto
+                                                 c_bin_shift_lo),
+            i_sum => get_reg(i_regmap, REG_BIN)(c_bin_sum),
+            i_data => r_bin_data_in,
+            o_busy => r_bin_busy_out,
+            o_rdy => r_bin_rdy_out,
+            o_data => r_bin_data_out
+        );
+
+    u_bin_ctrl: entity work.stage_ctrl
+        generic map(
+            C_FIELD => PRC_BIN_ENA
+        )
+        port map(
+            i_regmap => i_regmap,
+            i_rdy_raw => r_bin_rdy_in,
+            i_busy_raw => r_bin_busy_in,
+            i_data_raw => r_bin_data_in,
+            i_rdy_pl => r_bin_rdy_out,
+            i_busy_pl => r_bin_busy_out,
+            i_data_pl => r_bin_data_out,
             o_rdy => r_pl_rdy,
             o_busy => r_pl_busy,
             o_data => r_pl_data,
-            o_en => r_dc_en
+            o_en => r_bin_en
+        );
+
+    -- Latch the statistics when the capture completes, in the same cycle as
+    -- the transition to S_IDLE. The statistics of the last frame are kept
+    -- through a dark current calibration.
+    p_stats_latch: process(all)
+    begin
+        r_stats_latch <= '0';
+
+        if r_state = S_STOPPING and r_dc_calib = '0' and r_pl_busy = '0' and
+           not (r_total_avg_en = '1' and r_total_avg_busy_out = '1') then
+            r_stats_latch <= '1';
+        end if;
+    end process p_stats_latch;
+
+    -- Only the pixels inside the region of interest are written to the
+    -- pipeline FIFO. The statistics still cover the entire frame.
+    p_pl_idx: process(i_clk)
+    begin
+        if rising_edge(i_clk) then
+            if i_rst_n = '0' or r_state = S_STARTING then
+                r_pl_idx <= (others => '0');
+            elsif r_pl_rdy = '1' then
+                r_pl_idx <= r_pl_idx + 1;
+            end if;
+        end if;
+    end process p_pl_idx;
+
+    p_roi: process(all)
+        variable v_start: unsigned(15 downto 0);
+        variable v_len: unsigned(15 downto 0);
+    begin
+        v_start := get_reg16(i_regmap, REG_ROI_START1, REG_ROI_START2);
+        v_len := get_reg16(i_regmap, REG_ROI_LEN1, REG_ROI_LEN2);
+
+        r_roi <= '0';
+
+        if v_len = 0 then
+            r_roi <= '1';
+        elsif r_pl_idx >= v_start and
+              resize(r_pl_idx, 17) < resize(v_start, 17) + v_len then
+            r_roi <= '1';
+        end if;
+    end process p_roi;
+
+    u_stats: entity work.frame_stats
+        port map(
+            i_clk => i_clk,
+            i_rst_n => i_rst_n,
+            i_clear => r_start,
+            i_latch => r_stats_latch,
+            i_data => r_pl_data,
+            i_rdy => r_stats_rdy,
+            o_stats => o_stats
         );
 
     u_fifo_pl: entity work.frame_fifo
@@ -240,18 +426,55 @@ begin
         port map(
             i_clk => i_clk,
             i_rst_n => i_rst_n,
-            i_wr => r_fifo_pl_wr,
+            i_clear => '0',
+            i_wr => r_fifo_pl_wr and not r_frame_buf_en,
             i_data => r_pl_data,
-            i_rd => i_fifo_pl_rd,
-            o_data => o_fifo_pl_data,
+            i_wmark_level => r_fifo_wmark_level,
+            i_rd => i_fifo_pl_rd and not r_frame_buf_en,
+            o_data => r_fifo_pl_data,
             o_watermark => r_fifo_pl_wmark,
             o_errors => o_errors
         );
 
+    -- Alternative to the pipeline FIFO, holding complete frames so that the
+    -- readout can take its time. A frame is committed together with its
+    -- statistics, and frames left over from before a flush are dropped.
+    u_frame_buf: entity work.frame_buffer
+        generic map(
+            C_OVERFLOW => ERR_FRAME_BUF_OVERFLOW,
+            C_UNDERFLOW => ERR_FRAME_BUF_UNDERFLOW,
+            C_SIZE => C_CCD_NUM_ELEMENTS
+        )
+        port map(
+            i_clk => i_clk,
+            i_rst_n => i_rst_n,
+            i_clear => i_ccd_flush,
+            i_commit => r_stats_latch,
+            i_wr => r_fifo_pl_wr and r_frame_buf_en,
+            i_data => r_pl_data,
+            i_rd => i_fifo_pl_rd and r_frame_buf_en,
+            o_data => r_frame_buf_data,
+            o_watermark => r_frame_buf_wmark,
+            o_errors => o_errors
+        );
+
+    p_pl_out: process(all)
+    begin
+        if r_frame_buf_en = '1' then
+            o_fifo_pl_data <= r_frame_buf_data;
+        else
+            o_fifo_pl_data <= r_fifo_pl_data;
+        end if;
+    end process p_pl_out;
+
     p_fifo_wmark: process(all)
     begin
         if get_prc(i_regmap, PRC_WMARK_SRC) = '1' then
-            o_fifo_wmark <= r_fifo_pl_wmark;
+            if r_frame_buf_en = '1' then
+                o_fifo_wmark <= r_frame_buf_wmark;
+            else
+                o_fifo_wmark <= r_fifo_pl_wmark;
+            end if;
         else
             o_fifo_wmark <= r_fifo_raw_wmark;
         end if;
@@ -277,6 +500,62 @@ begin
         end if;
     end process p_calib;
 
+    r_mode <= get_reg(i_regmap, REG_CAPTURE_MODE)(1 downto 0);
+
+    -- Cross clock domain for the external trigger
+    p_trig_cdc: process(i_clk)
+    begin
+        if rising_edge(i_clk) then
+            r_trig_buf <= r_trig_unsafe;
+            r_trig_unsafe <= i_trigger;
+        end if;
+    end process p_trig_cdc;
+
+    u_edge_trig: entity work.edge_detect(rtl)
+        generic map(
+            C_FROM => '0',
+            C_TO => '1'
+        )
+        port map(
+            i_clk => i_clk,
+            i_rst_n => i_rst_n,
+            i_sig => r_trig_buf,
+            o_edge => r_trig_edge
+        );
+
+    -- A trigger that arrives while a capture is running is kept until the
+    -- capture completes, so that no edge is lost. Triggers from before the
+    -- trigger mode was entered are dropped.
+    p_trig: process(i_clk)
+    begin
+        if rising_edge(i_clk) then
+            r_mode_last <= r_mode;
+
+            if i_rst_n = '0' or r_mode /= r_mode_last or r_start = '1' then
+                r_trig_pending <= '0';
+            elsif r_mode = c_capture_trigger and r_trig_edge = '1' then
+                r_trig_pending <= '1';
+            end if;
+        end if;
+    end process p_trig;
+
+    -- In continuous mode a new capture is started as soon as the previous
+    -- one completes. The CCD keeps its SH period running between captures,
+    -- so a frame is produced every integration time.
+    p_auto_start: process(all)
+    begin
+        r_auto_start <= '0';
+
+        if r_state = S_IDLE and i_dc_calib = '0' then
+            if r_mode = c_capture_continuous or
+               (r_mode = c_capture_trigger and r_trig_pending = '1') then
+                r_auto_start <= '1';
+            end if;
+        end if;
+    end process p_auto_start;
+
+    r_start <= i_start or r_auto_start;
+
     -- Wait a number of cycles to allow the pipeline to complete before
     -- checking if the total average stage remains active. If it does, we
     -- need to repeat capturing.
@@ -301,7 +580,7 @@ begin
             else
                 case r_state is
                     when S_IDLE =>
-                        if i_dc_calib = '1' or i_start = '1' then
+                        if i_dc_calib = '1' or r_start = '1' then
                             r_state <= S_STARTING;
                         end if;
 
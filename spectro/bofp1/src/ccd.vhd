@@ -20,6 +20,9 @@ entity tcd1304 is
         i_start: in std_logic;
         i_flush: in std_logic;
         i_sh_div: in std_logic_vector(23 downto 0);
+        -- MCLK period in clock cycles, raised to the shortest period the
+        -- CCD supports
+        i_mclk_div: in std_logic_vector(7 downto 0);
 
         i_adc_eoc: in std_logic;
         o_adc_stconv: out std_logic;
@@ -45,14 +48,15 @@ architecture rtl of tcd1304 is
     constant c_sh_pulse: integer := G_SH_CYC_NS / (1_000_000_000 / G_CLK_FREQ);
     constant c_icg_cyc: integer := G_ICG_HOLD_NS / (1_000_000_000 / G_CLK_FREQ);
 
-    constant c_mclk_count: integer := G_CLK_FREQ / 800_000;
-    constant c_mclk_pulse: integer := c_mclk_count / 2;
+    -- 4 MHz is the highest MCLK frequency of the CCD
+    constant c_mclk_min: integer := G_CLK_FREQ / 4_000_000;
 
     signal r_flush: boolean;
 
     signal r_icg_buf: std_logic;
 
     signal r_mclk_buf: std_logic;
+    signal r_mclk_count: unsigned(G_MCLK_DIV_WIDTH-1 downto 0);
     signal r_mclk_en: std_logic;
 
     signal r_sh_en: std_logic;
@@ -77,6 +81,10 @@ begin
     r_sh_div <= std_logic_vector(resize(
                  unsigned(i_sh_div) + 1, r_sh_div'length));
 
+    r_mclk_count <= to_unsigned(c_mclk_min, G_MCLK_DIV_WIDTH)
+                    when unsigned(i_mclk_div) < c_mclk_min else
+                    resize(unsigned(i_mclk_div), G_MCLK_DIV_WIDTH);
+
     -- Counter for the master clock. This triggers a one-cycle enable
     -- signal continously
     u_counter_mclk: entity work.counter(rtl)
@@ -87,7 +95,7 @@ begin
             i_clk => i_clk,
             i_rst_n => i_rst_n,
             i_en => '1',
-            i_max => std_logic_vector(to_unsigned(c_mclk_count, G_MCLK_DIV_WIDTH)),
+            i_max => std_logic_vector(r_mclk_count),
             o_roll => r_mclk_en
         );
     
@@ -100,7 +108,7 @@ begin
             i_clk => i_clk,
             i_rst_n => i_rst_n,
             i_en => r_mclk_en,
-            i_cyc_cnt => std_logic_vector(to_unsigned(c_mclk_pulse, G_MCLK_DIV_WIDTH)),
+            i_cyc_cnt => std_logic_vector(shift_right(r_mclk_count, 1)),
             o_out => r_mclk_buf
         );
 
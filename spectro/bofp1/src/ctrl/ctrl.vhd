@@ -15,8 +15,10 @@ entity ctrl is
         i_sclk: in std_logic;
         i_cs_n: in std_logic;
 
+        -- SPI data lanes, where IO0 is MOSI and IO1 is MISO
         i_mosi: in std_logic;
-        o_miso: out std_logic;
+        o_io: out std_logic_vector(3 downto 0);
+        o_io_oe: out std_logic_vector(3 downto 0);
 
         i_fifo_raw_data: in std_logic_vector(15 downto 0);
         i_fifo_pl_data: in std_logic_vector(15 downto 0);
@@ -25,6 +27,10 @@ entity ctrl is
 
         o_dc_calib: out std_logic;
         o_ccd_flush: out std_logic;
+        -- REG_FIR_COEF2 written, storing the FIR coefficient
+        o_fir_coef_wr: out std_logic;
+
+        i_stats: in t_frame_stats;
 
         i_errors: in t_err_bitmap;
         io_regmap: inout t_regmap
@@ -39,13 +45,33 @@ architecture behaviour of ctrl is
     signal r_out_shf: std_logic_vector(7 downto 0);
     signal r_out_rd: std_logic_vector(15 downto 0);
     signal r_in_buf: std_logic_vector(7 downto 0);
+    signal r_lanes: std_logic_vector(1 downto 0);
 
     -- Streaming from FIFO
     signal r_streaming: boolean;
 
-    type t_stream is (S_RAW, S_PIPELINE);
+    type t_stream is (S_RAW, S_PIPELINE, S_STATS, S_FRAMED);
     signal r_stream_mode: t_stream;
 
+    -- Framed stream: the payload length is received after the command,
+    -- followed by the header, payload, CRC and status being shifted out
+    type t_frame_phase is (F_LEN, F_HEADER, F_DATA, F_CRC, F_STATUS, F_DONE);
+    signal r_frame_phase: t_frame_phase;
+    signal r_frame_len: unsigned(15 downto 0);
+    -- Word index within the header or payload
+    signal r_frame_idx: unsigned(15 downto 0);
+    signal r_frame_crc: std_logic_vector(15 downto 0);
+    -- Status sampled while the CRC is shifted out, after the payload has
+    -- been drained from the FIFO, so that it covers errors of this chunk
+    signal r_frame_status: std_logic_vector(15 downto 0);
+    -- Number of complete framed streams since reset
+    signal r_frame_seq: unsigned(15 downto 0);
+    -- Word of the framed stream currently shifted out
+    signal r_frame_word: std_logic_vector(15 downto 0);
+
+    -- Word of the statistics currently streamed
+    signal r_stats_idx: unsigned(2 downto 0);
+
     signal r_shift_done: std_logic;
     signal r_sample_done: std_logic;
 
@@ -59,6 +85,18 @@ architecture behaviour of ctrl is
     signal r_reg_raw: std_logic_vector(7 downto 0);
     signal r_reg_rdy: std_logic;
 
+    -- Burst access to consecutive registers
+    signal r_burst: boolean;
+    signal r_burst_len_rdy: boolean;
+    signal r_burst_left: unsigned(7 downto 0);
+    -- Register of the byte currently transferred
+    signal r_burst_addr: unsigned(5 downto 0);
+    signal r_burst_wr: std_logic;
+    signal r_burst_wr_addr: unsigned(5 downto 0);
+    signal r_burst_wr_data: t_reg_vector;
+    signal r_burst_rd: std_logic;
+    signal r_burst_rd_addr: unsigned(5 downto 0);
+
     signal r_err_clear: std_logic;
 
     signal r_fifo_rd: std_logic;
@@ -85,7 +123,15 @@ begin
             o_persisted => io_regmap(t_reg'pos(REG_STATUS))(c_err_len-1 downto 0)
         );
 
-    u_spi: entity work.spi_sub(rtl)
+    -- The command is always sent on a single lane, while the data of the
+    -- stream registers can be shifted out on multiple lanes. The length of a
+    -- framed stream is sent along with the command.
+    r_lanes <= get_reg(io_regmap, REG_SPI_LANES)(1 downto 0)
+               when r_streaming and not (r_stream_mode = S_FRAMED and
+                                         r_frame_phase = F_LEN)
+               else "00";
+
+    u_spi: entity work.spi_sub_quad(rtl)
         generic map(
             G_DATA_WIDTH => 8
         )
@@ -96,7 +142,9 @@ begin
             i_cs_n => i_cs_n,
             i_mosi => i_mosi,
             i_data => r_out_shf,
-            o_miso => o_miso,
+            i_lanes => r_lanes,
+            o_io => o_io,
+            o_io_oe => o_io_oe,
             o_data_shf => r_in_buf,
             o_shift_done => r_shift_done,
             o_sample_done => r_sample_done,
@@ -129,14 +177,40 @@ begin
             o_roll => r_shift_rolled
         );
 
+    p_frame_word: process(all)
+    begin
+        case r_frame_phase is
+            when F_HEADER =>
+                case to_integer(r_frame_idx) is
+                    when 0 =>
+                        r_frame_word <= std_logic_vector(r_frame_seq);
+                    when others =>
+                        r_frame_word <= std_logic_vector(r_frame_len);
+                end case;
+            when F_DATA =>
+                r_frame_word <= i_fifo_pl_data;
+            when F_CRC =>
+                r_frame_word <= r_frame_crc;
+            when F_STATUS =>
+                r_frame_word <= r_frame_status;
+            when others =>
+                r_frame_word <= (others => '0');
+        end case;
+    end process p_frame_word;
+
     p_out: process(all)
     begin
         if r_streaming then
-            if r_stream_mode = S_RAW then
-                r_out <= i_fifo_raw_data;
-            else
-                r_out <= i_fifo_pl_data;
-            end if;
+            case r_stream_mode is
+                when S_RAW =>
+                    r_out <= i_fifo_raw_data;
+                when S_PIPELINE =>
+                    r_out <= i_fifo_pl_data;
+                when S_STATS =>
+                    r_out <= get_stats_word(i_stats, to_integer(r_stats_idx));
+                when S_FRAMED =>
+                    r_out <= r_frame_word;
+            end case;
         else
             r_out <= r_out_rd;
         end if;
@@ -160,7 +234,8 @@ begin
         if rising_edge(i_clk) then
             r_fifo_rd <= '0';
 
-            if r_streaming and r_shift_rolled = '1' then
+            if r_streaming and r_shift_rolled = '1' and
+               (r_stream_mode /= S_FRAMED or r_frame_phase = F_DATA) then
                 r_fifo_rd <= '1';
             end if;
         end if;
@@ -172,27 +247,151 @@ begin
         o_fifo_pl_rd <= '0';
         o_fifo_raw_rd <= '0';
 
-        if r_stream_mode = S_RAW then
-            o_fifo_raw_rd <= r_fifo_rd;
-        else
-            o_fifo_pl_rd <= r_fifo_rd;
-        end if;
+        case r_stream_mode is
+            when S_RAW =>
+                o_fifo_raw_rd <= r_fifo_rd;
+            when S_PIPELINE | S_FRAMED =>
+                o_fifo_pl_rd <= r_fifo_rd;
+            when S_STATS =>
+                null;
+        end case;
     end process p_rd_mux;
 
+    -- Advance to the next word of the statistics, in the same way as the
+    -- FIFO is read when streaming a frame.
+    p_stats_idx: process(i_clk)
+    begin
+        if rising_edge(i_clk) then
+            if r_rst_n_mux = '0' or not r_streaming then
+                r_stats_idx <= (others => '0');
+            elsif r_stream_mode = S_STATS and r_fifo_rd = '1' then
+                r_stats_idx <= r_stats_idx + 1;
+            end if;
+        end if;
+    end process p_stats_idx;
+
+    -- Advance through the framed stream a word at a time, computing the CRC
+    -- over the header and payload as they are shifted out.
+    p_frame: process(i_clk)
+    begin
+        if rising_edge(i_clk) then
+            if r_rst_n_mux = '0' or not r_streaming then
+                r_frame_phase <= F_LEN;
+                r_frame_idx <= (others => '0');
+                r_frame_crc <= c_frame_crc_init;
+            elsif r_stream_mode = S_FRAMED then
+                -- Length, MSB first, in the two bytes following the command
+                if r_frame_phase = F_LEN and r_sample_done = '1' then
+                    r_frame_len <= r_frame_len(7 downto 0) & unsigned(r_in_buf);
+                end if;
+
+                if r_frame_phase = F_CRC then
+                    r_frame_status <= x"00" & get_reg(io_regmap, REG_STATUS);
+                end if;
+
+                if r_shift_rolled = '1' then
+                    case r_frame_phase is
+                        when F_LEN =>
+                            r_frame_phase <= F_HEADER;
+
+                        when F_HEADER =>
+                            r_frame_crc <= crc16_update(r_frame_crc, r_out);
+                            r_frame_idx <= r_frame_idx + 1;
+
+                            if r_frame_idx = c_frame_header_words - 1 then
+                                r_frame_idx <= (others => '0');
+                                r_frame_phase <= F_DATA;
+
+                                if r_frame_len = 0 then
+                                    r_frame_phase <= F_CRC;
+                                end if;
+                            end if;
+
+                        when F_DATA =>
+                            r_frame_crc <= crc16_update(r_frame_crc, r_out);
+                            r_frame_idx <= r_frame_idx + 1;
+
+                            if r_frame_idx = r_frame_len - 1 then
+                                r_frame_phase <= F_CRC;
+                            end if;
+
+                        when F_CRC =>
+                            r_frame_phase <= F_STATUS;
+
+                        when F_STATUS =>
+                            r_frame_seq <= r_frame_seq + 1;
+                            r_frame_phase <= F_DONE;
+
+                        when F_DONE => null;
+                    end case;
+                end if;
+            end if;
+
+            if i_rst_n = '0' then
+                r_frame_seq <= (others => '0');
+            end if;
+        end if;
+    end process p_frame;
+
     -- Load the first 8 bits into a register to contain the register address
-    -- and write bit.
+    -- and write bit. Anything sent while streaming is data, such as the
+    -- length of a framed stream.
     p_reg: process(i_clk)
     begin
         if rising_edge(i_clk) then
             r_reg_rdy <= '0';
 
-            if r_sample_done = '1' and unsigned(r_sample_count) = 0 then
+            if r_sample_done = '1' and unsigned(r_sample_count) = 0 and
+               not r_streaming and not r_burst then
                 r_reg_rdy <= '1';
                 r_reg_raw <= r_in_buf;
             end if;
         end if;
     end process p_reg;
 
+    -- Access one register per byte following the length of a burst. Reads
+    -- are fetched one byte ahead, like the single register reads, and are
+    -- zero past the length or for registers that are not configuration.
+    p_burst: process(i_clk)
+    begin
+        if rising_edge(i_clk) then
+            r_burst_wr <= '0';
+            r_burst_rd <= '0';
+
+            if r_rst_n_mux = '0' then
+                r_burst <= false;
+                r_burst_len_rdy <= false;
+            elsif r_reg_rdy = '1' and is_burst(r_reg_raw) then
+                r_burst <= true;
+                r_burst_len_rdy <= false;
+                r_burst_addr <= get_reg_addr(r_reg_raw);
+            elsif r_burst and r_sample_done = '1' then
+                r_burst_rd <= '1';
+                r_burst_rd_addr <= (others => '1');
+
+                if not r_burst_len_rdy then
+                    r_burst_len_rdy <= true;
+                    r_burst_left <= unsigned(r_in_buf);
+
+                    if unsigned(r_in_buf) /= 0 then
+                        r_burst_rd_addr <= r_burst_addr;
+                    end if;
+                elsif r_burst_left /= 0 then
+                    r_burst_wr <= '1' when is_write(r_reg_raw) else '0';
+                    r_burst_wr_addr <= r_burst_addr;
+                    r_burst_wr_data <= r_in_buf;
+
+                    r_burst_addr <= r_burst_addr + 1;
+                    r_burst_left <= r_burst_left - 1;
+
+                    if r_burst_left > 1 then
+                        r_burst_rd_addr <= r_burst_addr + 1;
+                    end if;
+                end if;
+            end if;
+        end if;
+    end process p_burst;
+
     -- Enter streaming mode. This is only done after shifting has completed,
     -- to ensure that we don't read from fifo before the second word. The
     -- first word is the previously read value, or the value from 
@@ -206,7 +405,8 @@ begin
             if r_rst_n_mux = '0' then
                 r_streaming <= false;
                 r_stream_mode <= S_RAW;
-            elsif not r_streaming and r_shift_rolled = '1' and is_read then
+            elsif not r_streaming and not r_burst and r_shift_rolled = '1' and
+                  is_read then
                 case parse_reg(r_reg_raw) is
                     when REG_STREAM_RAW =>
                         r_streaming <= true;
@@ -216,6 +416,14 @@ begin
                         r_streaming <= true;
                         r_stream_mode <= S_PIPELINE;
 
+                    when REG_STREAM_STATS =>
+                        r_streaming <= true;
+                        r_stream_mode <= S_STATS;
+
+                    when REG_STREAM_FRAMED =>
+                        r_streaming <= true;
+                        r_stream_mode <= S_FRAMED;
+
                     when others => null;
                 end case;
             end if;
@@ -230,13 +438,31 @@ begin
         if rising_edge(i_clk) then
             is_read := not is_write(r_reg_raw);
 
-            if i_rst_n /= '0' and r_reg_rdy = '1' and is_read then
+            if i_rst_n /= '0' and r_burst_rd = '1' then
+                -- Either half of the word is shifted out, depending on the
+                -- position in the transfer
+                r_out_rd <= (others => '0');
+
+                if is_config_reg(r_burst_rd_addr) then
+                    reg := t_reg'val(to_integer(r_burst_rd_addr));
+                    r_out_rd <= get_reg(io_regmap, reg) &
+                                get_reg(io_regmap, reg);
+                end if;
+            elsif i_rst_n /= '0' and r_reg_rdy = '1' and is_read and
+                  not is_burst(r_reg_raw) then
                 reg := parse_reg(r_reg_raw);
 
                 case reg is
                     when REG_SHDIV1 | REG_SHDIV2 | REG_SHDIV3
                          | REG_PRC_CONTROL | REG_TOTAL_AVG_N
                          | REG_MOVING_AVG_N
+                         | REG_ROI_START1 | REG_ROI_START2
+                         | REG_ROI_LEN1 | REG_ROI_LEN2
+                         | REG_BIN | REG_SPI_LANES
+                         | REG_CAPTURE_MODE | REG_MCLK_DIV
+                         | REG_FIFO_WMARK | REG_FIR_TAPS | REG_FIR_ADDR
+                         | REG_FIR_COEF1 | REG_FIR_COEF2
+                         | REG_DC_SLOT | REG_DC_FRAMES
                          | REG_STATUS =>
                         r_out_rd(7 downto 0) <= get_reg(io_regmap, reg);
 
@@ -255,11 +481,22 @@ begin
             o_rst <= '0';
             o_ccd_flush <= '0';
             o_dc_calib <= '0';
+            o_fir_coef_wr <= '0';
             r_err_clear <= '0';
 
             if i_rst_n = '0' then
                 load_defaults(io_regmap);
-            elsif r_sample_rolled = '1' and is_write(r_reg_raw) then
+            elsif r_burst_wr = '1' then
+                if is_config_reg(r_burst_wr_addr) then
+                    reg := t_reg'val(to_integer(r_burst_wr_addr));
+                    set_reg(io_regmap, reg, r_burst_wr_data);
+
+                    if reg = REG_FIR_COEF2 then
+                        o_fir_coef_wr <= '1';
+                    end if;
+                end if;
+            elsif r_sample_rolled = '1' and is_write(r_reg_raw) and
+                  not r_burst then
                 reg := parse_reg(r_reg_raw);
 
                 case reg is
@@ -280,8 +517,18 @@ begin
 
                     when REG_SHDIV1 | REG_SHDIV2 | REG_SHDIV3
                          | REG_PRC_CONTROL | REG_TOTAL_AVG_N
-                         | REG_MOVING_AVG_N =>
+                         | REG_MOVING_AVG_N
+                         | REG_ROI_START1 | REG_ROI_START2
+                         | REG_ROI_LEN1 | REG_ROI_LEN2
+                         | REG_BIN | REG_SPI_LANES
+                         | REG_CAPTURE_MODE | REG_MCLK_DIV
+                         | REG_FIFO_WMARK | REG_FIR_TAPS | REG_FIR_ADDR
+                         | REG_FIR_COEF1 | REG_DC_SLOT | REG_DC_FRAMES =>
+                        set_reg(io_regmap, reg, r_in_buf);
+
+                    when REG_FIR_COEF2 =>
                         set_reg(io_regmap, reg, r_in_buf);
+                        o_fir_coef_wr <= '1';
 
                     when others => null;
                 end case;
@@ -17,7 +17,24 @@ package ctrl_common is
         REG_TOTAL_AVG_N,
         REG_STATUS,
         REG_DC_CALIB,
-        REG_FLUSH
+        REG_FLUSH,
+        REG_STREAM_STATS, -- Stream statistics of the last frame
+        REG_ROI_START1, -- 16 bit index of the first pixel in the ROI, MSB
+        REG_ROI_START2, -- 16 bit index of the first pixel in the ROI, LSB
+        REG_ROI_LEN1, -- 16 bit number of pixels in the ROI, MSB. 0 = all
+        REG_ROI_LEN2, -- 16 bit number of pixels in the ROI, LSB
+        REG_BIN, -- Pixel binning, see c_bin_*
+        REG_SPI_LANES, -- log2 of the data lanes used by the stream registers
+        REG_STREAM_FRAMED, -- Stream pipeline data with a header and CRC
+        REG_CAPTURE_MODE, -- Start of captures, see c_capture_*
+        REG_MCLK_DIV, -- CCD master clock period in clock cycles
+        REG_FIFO_WMARK, -- FIFO watermark, in units of c_fifo_wmark_unit words
+        REG_FIR_TAPS, -- FIR taps in place of the moving average. 0 = boxcar
+        REG_DC_SLOT, -- Dark current map calibrated and subtracted
+        REG_DC_FRAMES, -- Dark frames averaged by a calibration. 0 = TOTAL_AVG
+        REG_FIR_ADDR, -- Index of the FIR coefficient written by REG_FIR_COEF2
+        REG_FIR_COEF1, -- 16 bit signed 2.14 FIR coefficient, MSB
+        REG_FIR_COEF2 -- 16 bit FIR coefficient, LSB. Writing it stores it
     );
     constant t_reg_len: integer := t_reg'pos(t_reg'high) + 1;
 
@@ -26,12 +43,72 @@ package ctrl_common is
         PRC_BUSY_SRC,
         PRC_TOTAVG_ENA,
         PRC_MOVAVG_ENA,
-        PRC_DC_ENA
+        PRC_DC_ENA,
+        PRC_STATS_ONLY, -- Only compute statistics, skip the pipeline FIFO
+        PRC_BIN_ENA,
+        PRC_FRAME_BUF -- Buffer full frames instead of the pipeline FIFO
     );
 
+    -- Fields of REG_BIN
+    constant c_bin_shift_hi: integer := 1; -- log2 of pixels per bin
+    constant c_bin_shift_lo: integer := 0;
+    constant c_bin_sum: integer := 2; -- Sum instead of average
+
+    -- Values of REG_CAPTURE_MODE
+    -- Capture a frame on REG_SAMPLE
+    constant c_capture_single: std_logic_vector(1 downto 0) := "00";
+    -- Capture a frame every SH period, without being started
+    constant c_capture_continuous: std_logic_vector(1 downto 0) := "01";
+    -- Capture a frame at the next SH period after an external trigger
+    constant c_capture_trigger: std_logic_vector(1 downto 0) := "10";
+
+    -- Default of REG_MCLK_DIV, 800 kHz with a 100 MHz clock
+    constant c_mclk_div_default: integer := 125;
+
+    -- Dark current maps selected by REG_DC_SLOT
+    constant c_dc_slot_bits: integer := 2;
+    constant c_dc_slots: integer := 2**c_dc_slot_bits;
+
+    -- Granularity of REG_FIFO_WMARK, and its default of 256 words
+    constant c_fifo_wmark_unit: integer := 16;
+    constant c_fifo_wmark_default: integer := 16;
+
     subtype t_reg_vector is std_logic_vector(7 downto 0);
     type t_regmap is array(t_reg_len-1 downto 0) of t_reg_vector;
 
+    -- Statistics of a frame, see frame_stats
+    type t_frame_stats is record
+        min: unsigned(15 downto 0);
+        max: unsigned(15 downto 0);
+        argmax: unsigned(15 downto 0);
+        sum: unsigned(31 downto 0);
+        saturated: unsigned(15 downto 0);
+    end record t_frame_stats;
+
+    -- Number of 16 bit words streamed by REG_STREAM_STATS
+    constant c_frame_stats_words: integer := 6;
+
+    -- brief Get the 16 bit word at index `idx` of the streamed statistics
+    -- param stats Statistics to read from
+    -- param idx Word index, 0 to c_frame_stats_words-1
+    -- return std_logic_vector Word at `idx`, or zero if out of range
+    function get_stats_word(stats: t_frame_stats; idx: natural)
+    return std_logic_vector;
+
+    -- Number of 16 bit words in the header of REG_STREAM_FRAMED: sequence
+    -- and payload length. The trailer is the CRC followed by the status.
+    constant c_frame_header_words: integer := 2;
+    -- Initial value of the CRC-16/CCITT-FALSE ending a framed stream
+    constant c_frame_crc_init: std_logic_vector(15 downto 0) := x"FFFF";
+
+    -- brief Update CRC-16/CCITT-FALSE (polynomial 0x1021) with a word
+    -- param crc Current CRC
+    -- param data 16 bit word, processed MSB first
+    -- return std_logic_vector Updated CRC
+    function crc16_update(crc: std_logic_vector(15 downto 0);
+                          data: std_logic_vector(15 downto 0))
+    return std_logic_vector;
+
     -- brief Load regmap defaults (unless they are driven from a dedicated process)
     -- param regmap Regmap to load values into
     procedure load_defaults(signal regmap: out t_regmap);
@@ -42,6 +119,14 @@ package ctrl_common is
     -- return t_reg_vector Read register value
     function get_reg(regmap: t_regmap; reg: t_reg) return t_reg_vector;
 
+    -- brief Get the 16 bit value of the register pair `msb` and `lsb`
+    -- param regmap Regmap to read value from
+    -- param msb Register holding the upper 8 bits
+    -- param lsb Register holding the lower 8 bits
+    -- return unsigned Combined register value
+    function get_reg16(regmap: t_regmap; msb: t_reg; lsb: t_reg)
+    return unsigned;
+
     -- brief Set register
     -- param regmap Register map to write to
     -- param reg Register to write to
@@ -71,12 +156,34 @@ package ctrl_common is
     -- retval false Read operation
     function is_write(code: t_reg_vector) return boolean;
 
+    -- brief Check if code is a burst access
+    --
+    -- A burst is indicated by bit 6. The command is followed by a length
+    -- byte, and then accesses that many consecutive registers, one byte each.
+    --
+    -- param code Command code
+    -- return bool
+    function is_burst(code: t_reg_vector) return boolean;
+
+    -- brief Get the register address in `code`
+    -- param code Command code
+    -- return unsigned Address, which may not be a valid register
+    function get_reg_addr(code: t_reg_vector) return unsigned;
+
+    -- brief Check if `addr` is a configuration register, which holds its
+    -- value and can be accessed in a burst
+    -- param addr Register address
+    -- return bool
+    function is_config_reg(addr: unsigned) return boolean;
+
     type t_err is (
         ERR_FIFO_RAW_OVERFLOW,
         ERR_FIFO_RAW_UNDERFLOW,
         ERR_FIFO_PL_OVERFLOW,
         ERR_FIFO_PL_UNDERFLOW,
-        ERR_DC_UNDERFLOW
+        ERR_DC_UNDERFLOW,
+        ERR_FRAME_BUF_OVERFLOW,
+        ERR_FRAME_BUF_UNDERFLOW
     );
     constant c_err_len: integer := t_err'pos(t_err'high) + 1;
     subtype t_err_bitmap is std_logic_vector(c_err_len-1 downto 0);
@@ -99,6 +206,23 @@ package body ctrl_common is
         regmap(t_reg'pos(REG_SHDIV3)) <= std_logic_vector(to_unsigned(80, 8));
         regmap(t_reg'pos(REG_MOVING_AVG_N)) <= std_logic_vector(to_unsigned(1, 8));
         regmap(t_reg'pos(REG_TOTAL_AVG_N)) <= std_logic_vector(to_unsigned(2, 8));
+        regmap(t_reg'pos(REG_ROI_START1)) <= std_logic_vector(to_unsigned(0, 8));
+        regmap(t_reg'pos(REG_ROI_START2)) <= std_logic_vector(to_unsigned(0, 8));
+        regmap(t_reg'pos(REG_ROI_LEN1)) <= std_logic_vector(to_unsigned(0, 8));
+        regmap(t_reg'pos(REG_ROI_LEN2)) <= std_logic_vector(to_unsigned(0, 8));
+        regmap(t_reg'pos(REG_BIN)) <= std_logic_vector(to_unsigned(0, 8));
+        regmap(t_reg'pos(REG_SPI_LANES)) <= std_logic_vector(to_unsigned(0, 8));
+        regmap(t_reg'pos(REG_CAPTURE_MODE)) <= std_logic_vector(to_unsigned(0, 8));
+        regmap(t_reg'pos(REG_MCLK_DIV)) <= std_logic_vector(
+            to_unsigned(c_mclk_div_default, 8));
+        regmap(t_reg'pos(REG_FIFO_WMARK)) <= std_logic_vector(
+            to_unsigned(c_fifo_wmark_default, 8));
+        regmap(t_reg'pos(REG_FIR_TAPS)) <= std_logic_vector(to_unsigned(0, 8));
+        regmap(t_reg'pos(REG_DC_SLOT)) <= std_logic_vector(to_unsigned(0, 8));
+        regmap(t_reg'pos(REG_DC_FRAMES)) <= std_logic_vector(to_unsigned(0, 8));
+        regmap(t_reg'pos(REG_FIR_ADDR)) <= std_logic_vector(to_unsigned(0, 8));
+        regmap(t_reg'pos(REG_FIR_COEF1)) <= std_logic_vector(to_unsigned(0, 8));
+        regmap(t_reg'pos(REG_FIR_COEF2)) <= std_logic_vector(to_unsigned(0, 8));
         regmap(t_reg'pos(REG_PRC_CONTROL)) <= (
             t_prc_ctrl'pos(PRC_WMARK_SRC) => '1',
             t_prc_ctrl'pos(PRC_BUSY_SRC) => '1',
@@ -114,6 +238,12 @@ package body ctrl_common is
         return regmap(t_reg'pos(reg));
     end function get_reg;
 
+    function get_reg16(regmap: t_regmap; msb: t_reg; lsb: t_reg)
+    return unsigned is
+    begin
+        return unsigned(get_reg(regmap, msb) & get_reg(regmap, lsb));
+    end function get_reg16;
+
     procedure set_reg(signal regmap: out t_regmap;
                       constant reg: in t_reg;
                       constant val: in t_reg_vector) is
@@ -126,13 +256,44 @@ package body ctrl_common is
         return get_reg(regmap, REG_PRC_CONTROL)(t_prc_ctrl'pos(idx));
     end function get_prc;
 
+    function get_stats_word(stats: t_frame_stats; idx: natural)
+    return std_logic_vector is
+    begin
+        case idx is
+            when 0 => return std_logic_vector(stats.min);
+            when 1 => return std_logic_vector(stats.max);
+            when 2 => return std_logic_vector(stats.argmax);
+            when 3 => return std_logic_vector(stats.sum(31 downto 16));
+            when 4 => return std_logic_vector(stats.sum(15 downto 0));
+            when 5 => return std_logic_vector(stats.saturated);
+            when others => return std_logic_vector(to_unsigned(0, 16));
+        end case;
+    end function get_stats_word;
+
+    function crc16_update(crc: std_logic_vector(15 downto 0);
+                          data: std_logic_vector(15 downto 0))
+    return std_logic_vector is
+        variable v_crc: std_logic_vector(15 downto 0);
+        variable v_fb: std_logic;
+    begin
+        v_crc := crc;
+
+        for i in data'high downto data'low loop
+            v_fb := v_crc(15) xor data(i);
+            v_crc := v_crc(14 downto 0) & '0';
+
+            if v_fb = '1' then
+                v_crc := v_crc xor x"1021";
+            end if;
+        end loop;
+
+        return v_crc;
+    end function crc16_update;
+
     function parse_reg(code: t_reg_vector)
     return t_reg is
-        variable v_uval: unsigned(code'high-1 downto 0);
     begin
-        v_uval := unsigned(code(v_uval'high downto 0));
-
-        return t_reg'val(to_integer(v_uval)); 
+        return t_reg'val(to_integer(get_reg_addr(code)));
     end function parse_reg;
 
     function is_write(code: t_reg_vector) return boolean is
@@ -140,6 +301,40 @@ package body ctrl_common is
         return code(code'high) = '1';
     end function is_write;
 
+    function is_burst(code: t_reg_vector) return boolean is
+    begin
+        return code(code'high-1) = '1';
+    end function is_burst;
+
+    function get_reg_addr(code: t_reg_vector) return unsigned is
+    begin
+        return unsigned(code(code'high-2 downto 0));
+    end function get_reg_addr;
+
+    function is_config_reg(addr: unsigned) return boolean is
+    begin
+        if to_integer(addr) >= t_reg_len then
+            return false;
+        end if;
+
+        case t_reg'val(to_integer(addr)) is
+            when REG_SHDIV1 | REG_SHDIV2 | REG_SHDIV3
+                 | REG_PRC_CONTROL | REG_TOTAL_AVG_N
+                 | REG_MOVING_AVG_N
+                 | REG_ROI_START1 | REG_ROI_START2
+                 | REG_ROI_LEN1 | REG_ROI_LEN2
+                 | REG_BIN | REG_SPI_LANES
+                 | REG_CAPTURE_MODE | REG_MCLK_DIV
+                 | REG_FIFO_WMARK | REG_FIR_TAPS | REG_FIR_ADDR
+                 | REG_FIR_COEF1 | REG_FIR_COEF2
+                 | REG_DC_SLOT | REG_DC_FRAMES =>
+                return true;
+
+            when others =>
+                return false;
+        end case;
+    end function is_config_reg;
+
     function get_err_slot(bitmap: t_reg_vector; err: t_err) return std_logic is
     begin
         return bitmap(t_err'pos(err));
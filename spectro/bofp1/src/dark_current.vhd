@@ -13,6 +13,8 @@ entity dark_current is
         i_clk: in std_logic;
         i_rst_n: in std_logic;
         i_calib: in std_logic;
+        -- Map to calibrate or subtract, taken in between frames
+        i_slot: in std_logic_vector(c_dc_slot_bits-1 downto 0);
 
         i_data: in std_logic_vector(15 downto 0);
         i_rdy: in std_logic;
@@ -38,17 +40,42 @@ architecture behaviour of dark_current is
 
     signal r_loaded: std_logic_vector(15 downto 0);
     signal r_calced: unsigned(15 downto 0);
+
+    -- One map per slot, so that switching between calibrated settings
+    -- doesn't need a new calibration
+    type t_slot_data is array(0 to c_dc_slots-1) of
+        std_logic_vector(r_loaded'range);
+    signal r_slot_data: t_slot_data;
+    signal r_slot_wr_en: std_logic_vector(0 to c_dc_slots-1);
+    signal r_slot: unsigned(i_slot'range);
 begin
-    u_ram: entity work.frame_ram
-        port map(
-            i_clk => i_clk,
-            i_rst_n => i_rst_n,
-            i_addr => std_logic_vector(r_addr),
-            i_wr_en => r_wr_en,
-            i_rd_en => r_rd_en,
-            i_wr_data => i_data,
-            o_rd_data => r_loaded
-        );
+    g_slot: for i in 0 to c_dc_slots-1 generate
+        u_ram: entity work.frame_ram
+            port map(
+                i_clk => i_clk,
+                i_rst_n => i_rst_n,
+                i_addr => std_logic_vector(r_addr),
+                i_wr_en => r_slot_wr_en(i),
+                i_rd_en => r_rd_en,
+                i_wr_data => i_data,
+                o_rd_data => r_slot_data(i)
+            );
+
+        r_slot_wr_en(i) <= r_wr_en when r_slot = i else '0';
+    end generate g_slot;
+
+    r_loaded <= r_slot_data(to_integer(r_slot));
+
+    p_slot: process(i_clk)
+    begin
+        if rising_edge(i_clk) then
+            if i_rst_n = '0' then
+                r_slot <= (others => '0');
+            elsif i_en = '0' then
+                r_slot <= unsigned(i_slot);
+            end if;
+        end if;
+    end process p_slot;
 
     p_calib_hold: process(i_clk)
     begin
@@ -62,7 +89,8 @@ begin
     end process p_calib_hold;
 
     -- Calibration is simply performed by writing a frame into memory with
-    -- the light source disabled.
+    -- the light source disabled. Averaging several dark frames is left to
+    -- the total average stage in front of this one.
     p_calib: process(i_clk)
     begin
         if rising_edge(i_clk) then
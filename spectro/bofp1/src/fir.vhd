@@ -0,0 +1,219 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+-- Smooth a frame with a FIR filter of up to 64 taps, e.g. a Savitzky-Golay
+-- or Gaussian kernel.
+--
+-- Coefficients are signed 2.14 fixed point, where coefficient 0 weights the
+-- oldest pixel of the window, and are written one at a time through
+-- i_coef_wr. The output is rounded and saturated to 16 bits, and only
+-- starts once the window is full, so a frame loses i_taps - 1 pixels.
+--
+-- The taps are computed one per cycle on a single pipelined multiplier and
+-- accumulator, which map onto a DSP slice. A pixel therefore takes
+-- i_taps + 4 cycles, and pixels have to arrive at least that far apart.
+-- One pixel arriving early is held until the previous one is done.
+entity fir is
+    port (
+        i_clk: in std_logic;
+        i_rst_n: in std_logic;
+        i_en: in std_logic;
+        i_rdy: in std_logic;
+        i_taps: in std_logic_vector(6 downto 0);
+        i_data: in std_logic_vector(15 downto 0);
+
+        i_coef_wr: in std_logic;
+        i_coef_addr: in std_logic_vector(5 downto 0);
+        i_coef: in std_logic_vector(15 downto 0);
+
+        o_busy: out std_logic;
+        o_rdy: out std_logic;
+        o_data: out std_logic_vector(15 downto 0)
+    );
+end entity fir;
+
+architecture behaviour of fir is
+    constant c_taps_max: integer := 64;
+    constant c_coef_frac: integer := 14;
+
+    -- Twice the window, so that a pixel arriving early doesn't overwrite
+    -- the window being computed
+    type t_window is array(0 to 2*c_taps_max-1) of
+        std_logic_vector(i_data'range);
+    signal r_window: t_window;
+    signal r_wr_ptr: unsigned(6 downto 0);
+
+    type t_coefs is array(0 to c_taps_max-1) of
+        std_logic_vector(i_coef'range);
+    signal r_coefs: t_coefs;
+
+    signal r_taps: unsigned(i_taps'range);
+    signal r_filled: unsigned(i_taps'range);
+
+    signal r_pending: boolean;
+    signal r_pending_ptr: unsigned(r_wr_ptr'range);
+
+    -- Tap currently fed to the multiplier
+    signal r_running: boolean;
+    signal r_tap: unsigned(5 downto 0);
+    signal r_rd_ptr: unsigned(r_wr_ptr'range);
+
+    -- Pipeline of the multiply and accumulate: read, multiply, accumulate
+    signal r_rd_valid: std_logic;
+    signal r_rd_first: boolean;
+    signal r_rd_last: boolean;
+    signal r_sample: std_logic_vector(i_data'range);
+    signal r_coef: std_logic_vector(i_coef'range);
+
+    signal r_mul_valid: std_logic;
+    signal r_mul_first: boolean;
+    signal r_mul_last: boolean;
+    signal r_mul: signed(i_data'length + i_coef'length downto 0);
+
+    signal r_acc_last: std_logic;
+    signal r_acc: signed(r_mul'length + 6 - 1 downto 0);
+
+    signal r_busy: std_logic;
+begin
+    p_coef: process(i_clk)
+    begin
+        if rising_edge(i_clk) then
+            if i_coef_wr = '1' then
+                r_coefs(to_integer(unsigned(i_coef_addr))) <= i_coef;
+            end if;
+        end if;
+    end process p_coef;
+
+    -- Only take the number of taps in between frames
+    p_taps: process(i_clk)
+    begin
+        if rising_edge(i_clk) then
+            if i_en = '0' and not r_running then
+                if unsigned(i_taps) = 0 then
+                    r_taps <= to_unsigned(1, r_taps'length);
+                elsif unsigned(i_taps) > c_taps_max then
+                    r_taps <= to_unsigned(c_taps_max, r_taps'length);
+                else
+                    r_taps <= unsigned(i_taps);
+                end if;
+            end if;
+        end if;
+    end process p_taps;
+
+    -- Store incoming pixels, and queue the window ending at each of them
+    -- once enough pixels have been seen
+    p_window: process(i_clk)
+    begin
+        if rising_edge(i_clk) then
+            if i_rst_n = '0' or i_en = '0' then
+                r_wr_ptr <= (others => '0');
+                r_filled <= (others => '0');
+            elsif i_rdy = '1' then
+                r_window(to_integer(r_wr_ptr)) <= i_data;
+                r_wr_ptr <= r_wr_ptr + 1;
+
+                if r_filled /= r_taps then
+                    r_filled <= r_filled + 1;
+                end if;
+            end if;
+        end if;
+    end process p_window;
+
+    p_queue: process(i_clk)
+    begin
+        if rising_edge(i_clk) then
+            if i_rst_n = '0' then
+                r_pending <= false;
+            elsif i_en = '1' and i_rdy = '1' and r_filled + 1 >= r_taps then
+                r_pending <= true;
+                r_pending_ptr <= r_wr_ptr;
+            elsif r_pending and not r_running then
+                r_pending <= false;
+            end if;
+        end if;
+    end process p_queue;
+
+    -- Step through the window, oldest pixel first
+    p_run: process(i_clk)
+    begin
+        if rising_edge(i_clk) then
+            r_rd_valid <= '0';
+
+            if i_rst_n = '0' then
+                r_running <= false;
+            elsif r_running then
+                r_rd_valid <= '1';
+                r_rd_first <= r_tap = 0;
+                r_rd_last <= r_tap = r_taps - 1;
+                r_sample <= r_window(to_integer(r_rd_ptr));
+                r_coef <= r_coefs(to_integer(r_tap));
+
+                r_tap <= r_tap + 1;
+                r_rd_ptr <= r_rd_ptr + 1;
+
+                if r_tap = r_taps - 1 then
+                    r_running <= false;
+                end if;
+            elsif r_pending then
+                r_running <= true;
+                r_tap <= (others => '0');
+                r_rd_ptr <= r_pending_ptr - r_taps + 1;
+            end if;
+        end if;
+    end process p_run;
+
+    p_mac: process(i_clk)
+    begin
+        if rising_edge(i_clk) then
+            r_mul_valid <= r_rd_valid and i_rst_n;
+            r_mul_first <= r_rd_first;
+            r_mul_last <= r_rd_last;
+            r_mul <= signed('0' & r_sample) * signed(r_coef);
+
+            r_acc_last <= '0';
+
+            if r_mul_valid = '1' then
+                if r_mul_first then
+                    r_acc <= resize(r_mul, r_acc'length);
+                else
+                    r_acc <= r_acc + r_mul;
+                end if;
+
+                r_acc_last <= '1' when r_mul_last else '0';
+            end if;
+        end if;
+    end process p_mac;
+
+    -- Round and saturate the sum of the window
+    p_out: process(i_clk)
+        variable v_val: signed(r_acc'range);
+    begin
+        if rising_edge(i_clk) then
+            o_rdy <= r_acc_last and i_rst_n;
+
+            if r_acc_last = '1' then
+                v_val := shift_right(r_acc + 2**(c_coef_frac-1), c_coef_frac);
+
+                if v_val < 0 then
+                    o_data <= (others => '0');
+                elsif v_val > 2**o_data'length - 1 then
+                    o_data <= (others => '1');
+                else
+                    o_data <= std_logic_vector(v_val(o_data'range));
+                end if;
+            end if;
+        end if;
+    end process p_out;
+
+    r_busy <= '1' when r_pending or r_running or r_rd_valid = '1' or
+                       r_mul_valid = '1' or r_acc_last = '1' else '0';
+
+    p_busy: process(i_clk)
+    begin
+        if rising_edge(i_clk) then
+            o_busy <= i_en or r_busy;
+        end if;
+    end process p_busy;
+
+end architecture behaviour;
@@ -0,0 +1,193 @@
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+use work.ctrl_common.all;
+
+-- Double buffered frame store, with the same read interface as frame_fifo.
+--
+-- Frames are written to one BRAM bank while the other is read out, so that
+-- the capture of frame N+1 is independent of how fast frame N is read. A
+-- frame is committed at the end of the capture, and becomes readable once
+-- all previous frames have been read. A frame that is captured while both
+-- banks are occupied is dropped entirely, and flagged as an overflow.
+entity frame_buffer is
+    generic (
+        C_OVERFLOW: t_err;
+        C_UNDERFLOW: t_err;
+        C_SIZE: integer := 3694
+    );
+    port (
+        i_clk: in std_logic;
+        i_rst_n: in std_logic;
+        -- Discard all frames, e.g. left over from a previous capture
+        i_clear: in std_logic;
+        -- End of the frame being written
+        i_commit: in std_logic;
+        i_wr: in std_logic;
+        i_rd: in std_logic;
+        i_data: in std_logic_vector(15 downto 0);
+        o_data: out std_logic_vector(15 downto 0);
+        o_empty: out std_logic;
+        -- A complete frame is ready to be read
+        o_watermark: out std_logic;
+        o_errors: out t_err_bitmap
+    );
+end entity frame_buffer;
+
+architecture behaviour of frame_buffer is
+    subtype t_bank is integer range 0 to 1;
+    subtype t_addr is unsigned(11 downto 0);
+    type t_bank_addr is array(t_bank) of t_addr;
+    type t_bank_data is array(t_bank) of std_logic_vector(15 downto 0);
+
+    signal r_wr_bank: t_bank;
+    signal r_wr_addr: t_addr;
+    signal r_wr_ok: std_logic;
+    -- Drop the rest of a frame that did not fit
+    signal r_drop: std_logic;
+
+    signal r_rd_bank: t_bank;
+    signal r_rd_addr: t_addr;
+    signal r_rd_en: std_logic;
+    -- First word of the bank being read has been fetched
+    signal r_fetched: std_logic;
+
+    -- Bank holds a committed frame that is not fully read
+    signal r_full: std_logic_vector(0 to 1);
+    signal r_len: t_bank_addr;
+
+    signal r_ram_addr: t_bank_addr;
+    signal r_ram_data: t_bank_data;
+    signal r_ram_wr_en: std_logic_vector(0 to 1);
+    signal r_ram_rd_en: std_logic_vector(0 to 1);
+begin
+
+    g_banks: for i in t_bank generate
+        u_ram: entity work.frame_ram
+            generic map(
+                C_WIDTH => 16
+            )
+            port map(
+                i_clk => i_clk,
+                i_rst_n => i_rst_n,
+                i_wr_en => r_ram_wr_en(i),
+                i_rd_en => r_ram_rd_en(i),
+                i_addr => std_logic_vector(r_ram_addr(i)),
+                i_wr_data => i_data,
+                o_rd_data => r_ram_data(i)
+            );
+    end generate g_banks;
+
+    r_wr_ok <= '1' when r_full(r_wr_bank) = '0' and r_drop = '0' and
+                        r_wr_addr < C_SIZE else '0';
+
+    -- The BRAM blocks are single port, so a bank is addressed by the writer
+    -- until it is committed, and by the reader after that.
+    p_ram: process(all)
+    begin
+        for i in t_bank loop
+            r_ram_wr_en(i) <= '0';
+            r_ram_rd_en(i) <= '0';
+            r_ram_addr(i) <= r_rd_addr;
+
+            if i = r_wr_bank and r_full(i) = '0' then
+                r_ram_addr(i) <= r_wr_addr;
+                r_ram_wr_en(i) <= i_wr and r_wr_ok;
+            end if;
+
+            if i = r_rd_bank then
+                r_ram_rd_en(i) <= r_rd_en;
+            end if;
+        end loop;
+    end process p_ram;
+
+    p_ctrl: process(i_clk)
+        variable v_full: std_logic_vector(r_full'range);
+    begin
+        if rising_edge(i_clk) then
+            if i_rst_n = '0' or i_clear = '1' then
+                r_wr_bank <= 0;
+                r_wr_addr <= (others => '0');
+                r_drop <= '0';
+                r_rd_bank <= 0;
+                r_rd_addr <= (others => '0');
+                r_rd_en <= '0';
+                r_fetched <= '0';
+                r_full <= (others => '0');
+            else
+                v_full := r_full;
+                r_rd_en <= '0';
+
+                if i_wr = '1' then
+                    if r_wr_ok = '1' then
+                        r_wr_addr <= r_wr_addr + 1;
+                    else
+                        r_drop <= '1';
+                    end if;
+                end if;
+
+                -- Fetch ahead, so that the next word is ready when it is read
+                if r_full(r_rd_bank) = '1' then
+                    if r_fetched = '0' then
+                        r_rd_en <= '1';
+                        r_fetched <= '1';
+                    elsif i_rd = '1' then
+                        if r_rd_addr + 1 = r_len(r_rd_bank) then
+                            v_full(r_rd_bank) := '0';
+                            r_rd_bank <= 1 - r_rd_bank;
+                            r_rd_addr <= (others => '0');
+                            r_fetched <= '0';
+                        else
+                            r_rd_addr <= r_rd_addr + 1;
+                            r_rd_en <= '1';
+                        end if;
+                    end if;
+                end if;
+
+                -- An empty or partial frame is not committed
+                if i_commit = '1' then
+                    if r_drop = '0' and r_wr_addr /= 0 then
+                        v_full(r_wr_bank) := '1';
+                        r_len(r_wr_bank) <= r_wr_addr;
+                    end if;
+
+                    r_wr_addr <= (others => '0');
+                    r_drop <= '0';
+                end if;
+
+                -- Write to the other bank once it has been read out
+                if v_full(r_wr_bank) = '1' and v_full(1 - r_wr_bank) = '0' then
+                    r_wr_bank <= 1 - r_wr_bank;
+                end if;
+
+                r_full <= v_full;
+            end if;
+        end if;
+    end process p_ctrl;
+
+    -- Detect overflow/underflow errors
+    p_err_detect: process(i_clk)
+    begin
+        if rising_edge(i_clk) then
+            if i_rst_n /= '0' then
+                set_err(o_errors, C_OVERFLOW, '0');
+                set_err(o_errors, C_UNDERFLOW, '0');
+
+                if i_wr = '1' and r_wr_ok = '0' then
+                    set_err(o_errors, C_OVERFLOW, '1');
+                end if;
+
+                if i_rd = '1' and r_full(r_rd_bank) = '0' then
+                    set_err(o_errors, C_UNDERFLOW, '1');
+                end if;
+            end if;
+        end if;
+    end process p_err_detect;
+
+    o_data <= r_ram_data(r_rd_bank);
+    o_empty <= not r_full(r_rd_bank);
+    o_watermark <= r_full(r_rd_bank);
+
+end architecture behaviour;
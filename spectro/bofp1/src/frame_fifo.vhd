@@ -14,9 +14,13 @@ entity frame_fifo is
     port (
         i_clk: in std_logic;
         i_rst_n: in std_logic;
+        -- Discard the contents, e.g. left over from a previous frame
+        i_clear: in std_logic;
         i_wr: in std_logic;
         i_rd: in std_logic;
         i_data: in std_logic_vector(15 downto 0);
+        -- Number of words that raises the watermark
+        i_wmark_level: in unsigned(11 downto 0);
         o_data: out std_logic_vector(15 downto 0);
         o_full: out std_logic;
         o_empty: out std_logic;
@@ -31,6 +35,9 @@ architecture behaviour of frame_fifo is
     signal r_wr_en: std_logic;
     signal r_rd_en: std_logic;
     signal r_rst: std_logic;
+    -- Words in the FIFO. The programmable full flag of the core has a
+    -- fixed threshold, so the watermark is derived from this instead.
+    signal r_count: unsigned(10 downto 0);
 begin
 
     -- Vivado component
@@ -43,10 +50,26 @@ begin
             rd_en => r_rd_en,
             dout => o_data,
             empty => r_empty,
-            prog_full => o_watermark,
+            prog_full => open,
             full => r_full
         );
 
+    p_count: process(i_clk)
+    begin
+        if rising_edge(i_clk) then
+            if r_rst = '1' then
+                r_count <= (others => '0');
+            elsif r_wr_en = '1' and r_rd_en = '0' then
+                r_count <= r_count + 1;
+            elsif r_wr_en = '0' and r_rd_en = '1' then
+                r_count <= r_count - 1;
+            end if;
+        end if;
+    end process p_count;
+
+    o_watermark <= '1' when r_count /= 0 and
+                            resize(r_count, 12) >= i_wmark_level else '0';
+
     -- Detect overflow/underflow errors
     p_err_detect: process(i_clk)
     begin
@@ -66,7 +89,7 @@ begin
         end if;
     end process p_err_detect;
 
-    r_rst <= not i_rst_n;
+    r_rst <= not i_rst_n or i_clear;
     r_wr_en <= i_wr when not r_full else '0';
     r_rd_en <= i_rd when not r_empty else '0';
     o_full <= r_full;
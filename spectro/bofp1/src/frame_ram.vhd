@@ -26,6 +26,8 @@ architecture behaviour of frame_ram is
 
     signal r_rd_en_tmp: std_logic;
     signal r_rd_en: std_logic;
+
+    type t_arr is array(0 to 4095) of std_logic_vector(C_WIDTH-1 downto 0);
 begin
     r_rst <= not i_rst_n;
 
@@ -49,6 +51,23 @@ begin
                 dina => i_wr_data,
                 douta => r_rd_data
             );
+    else generate
+        -- Widths without a generated IP are inferred with the same two
+        -- cycle read delay, i.e. registered address and output.
+        signal r_arr: t_arr;
+        signal r_addr: std_logic_vector(i_addr'range);
+    begin
+        p_ram: process(i_clk)
+        begin
+            if rising_edge(i_clk) then
+                if i_wr_en = '1' then
+                    r_arr(to_integer(unsigned(i_addr))) <= i_wr_data;
+                end if;
+
+                r_addr <= i_addr;
+                r_rd_data <= r_arr(to_integer(unsigned(r_addr)));
+            end if;
+        end process p_ram;
     end generate g_ram;
 
     -- Vivado BRAM block updates douta whenever addra is changed, but we
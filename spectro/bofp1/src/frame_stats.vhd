@@ -0,0 +1,81 @@
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+use work.ctrl_common.all;
+
+-- Summary statistics of a frame, computed on the fly from the pixels leaving
+-- the pipeline. The accumulators are cleared when a capture starts, and the
+-- result is latched at the end of the frame so that it stays stable while it
+-- is read out.
+entity frame_stats is
+    generic (
+        C_SATURATION: integer := 65000
+    );
+    port (
+        i_clk: in std_logic;
+        i_rst_n: in std_logic;
+        i_clear: in std_logic;
+        i_latch: in std_logic;
+
+        i_data: in std_logic_vector(15 downto 0);
+        i_rdy: in std_logic;
+
+        o_stats: out t_frame_stats
+    );
+end entity frame_stats;
+
+architecture behaviour of frame_stats is
+    constant c_stats_init: t_frame_stats := (
+        min => (others => '1'),
+        max => (others => '0'),
+        argmax => (others => '0'),
+        sum => (others => '0'),
+        saturated => (others => '0')
+    );
+
+    signal r_acc: t_frame_stats;
+    signal r_idx: unsigned(15 downto 0);
+begin
+    p_acc: process(i_clk)
+        variable v_data: unsigned(15 downto 0);
+    begin
+        if rising_edge(i_clk) then
+            v_data := unsigned(i_data);
+
+            if i_rst_n = '0' or i_clear = '1' then
+                r_acc <= c_stats_init;
+                r_idx <= (others => '0');
+            elsif i_rdy = '1' then
+                r_idx <= r_idx + 1;
+                r_acc.sum <= r_acc.sum + v_data;
+
+                if v_data < r_acc.min then
+                    r_acc.min <= v_data;
+                end if;
+
+                if v_data > r_acc.max then
+                    r_acc.max <= v_data;
+                    r_acc.argmax <= r_idx;
+                end if;
+
+                if v_data >= C_SATURATION then
+                    r_acc.saturated <= r_acc.saturated + 1;
+                end if;
+            end if;
+        end if;
+    end process p_acc;
+
+    p_latch: process(i_clk)
+    begin
+        if rising_edge(i_clk) then
+            if i_rst_n = '0' then
+                o_stats <= c_stats_init;
+            elsif i_latch = '1' then
+                o_stats <= r_acc;
+            end if;
+        end if;
+    end process p_latch;
+
+end architecture behaviour;
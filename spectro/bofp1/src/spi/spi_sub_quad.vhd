@@ -0,0 +1,189 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+-- SPI sub that can shift data out on one, two or four lanes, with the pin
+-- mapping of a dual/quad SPI memory (IO0 = MOSI, IO1 = MISO). Data is always
+-- sampled from IO0 on a single lane, so a command is sent the same way in
+-- every mode, and sampling stops while more than one lane is driven.
+--
+-- With multiple lanes, the MSB of each group is on the highest lane, e.g.
+-- bits 7 to 4 of a byte are shifted out on IO3 to IO0 in quad mode.
+entity spi_sub_quad is
+    generic (
+        G_DATA_WIDTH: integer := 8
+    );
+    port (
+        i_clk: in std_logic;
+        i_rst_n: in std_logic;
+
+        i_sclk: in std_logic;
+        i_data: in std_logic_vector(G_DATA_WIDTH-1 downto 0);
+        -- log2 of the number of lanes to shift out on: 0, 1 or 2
+        i_lanes: in std_logic_vector(1 downto 0);
+
+        i_mosi: in std_logic;
+        i_cs_n: in std_logic;
+        o_io: out std_logic_vector(3 downto 0);
+        o_io_oe: out std_logic_vector(3 downto 0);
+
+        o_active: out std_logic;
+
+        o_data_shf: out std_logic_vector(G_DATA_WIDTH-1 downto 0);
+        o_sample_done: out std_logic;
+        o_shift_done: out std_logic
+    );
+end entity spi_sub_quad;
+
+architecture rtl of spi_sub_quad is
+    signal r_shift_en: std_logic;
+    signal r_sample_en: std_logic;
+    signal r_single: std_logic;
+
+    signal r_single_out: std_logic;
+    signal r_single_done: std_logic;
+    signal r_multi_out: std_logic_vector(3 downto 0);
+    signal r_multi_done: std_logic;
+
+    signal r_sclk_buf: std_logic;
+    signal r_sclk_unsafe: std_logic;
+    signal r_mosi_buf: std_logic;
+    signal r_mosi_unsafe: std_logic;
+    signal r_cs_n_buf: std_logic;
+    signal r_cs_n_unsafe: std_logic;
+
+    attribute ASYNC_REG: boolean;
+    attribute ASYNC_REG of r_sclk_unsafe : signal is true;
+    attribute ASYNC_REG of r_mosi_unsafe : signal is true;
+    attribute ASYNC_REG of r_cs_n_unsafe : signal is true;
+
+    -- Number of lanes for the log2 value `lanes`, anything else is single
+    function lane_count(lanes: std_logic_vector(1 downto 0)) return natural is
+    begin
+        case lanes is
+            when "01" => return 2;
+            when "10" => return 4;
+            when others => return 1;
+        end case;
+    end function lane_count;
+begin
+    r_single <= '1' when lane_count(i_lanes) = 1 else '0';
+
+    -- Single lane shifting, and sampling in all modes
+    u_spi_common: entity work.spi_common
+        generic map(
+            G_DATA_WIDTH => G_DATA_WIDTH
+        )
+        port map(
+            i_clk => i_clk,
+            i_rst_n => i_rst_n,
+
+            i_sample_en => r_sample_en and r_single,
+            i_shift_en => r_shift_en and r_single,
+
+            i_in => r_mosi_buf,
+            i_cs_n => r_cs_n_buf,
+            o_out => r_single_out,
+
+            i_data => i_data,
+            o_data => o_data_shf,
+
+            o_sample_done => o_sample_done,
+            o_shift_done => r_single_done
+        );
+
+    -- Shift out a group of bits on multiple lanes per SCLK edge
+    b_multi: block
+        signal r_cnt: natural range 0 to G_DATA_WIDTH-1;
+    begin
+        p_multi: process(i_clk)
+            variable v_lanes: natural range 1 to 4;
+            variable v_head: integer;
+        begin
+            if rising_edge(i_clk) then
+                v_lanes := lane_count(i_lanes);
+                r_multi_done <= '0';
+
+                if i_rst_n = '0' or r_cs_n_buf /= '0' or r_single = '1' then
+                    r_cnt <= 0;
+                elsif r_shift_en = '1' then
+                    v_head := i_data'high - r_cnt * v_lanes;
+
+                    for i in 0 to 3 loop
+                        if i < v_lanes then
+                            r_multi_out(i) <= i_data(v_head - (v_lanes-1-i));
+                        end if;
+                    end loop;
+
+                    if r_cnt >= G_DATA_WIDTH / v_lanes - 1 then
+                        r_cnt <= 0;
+                        r_multi_done <= '1';
+                    else
+                        r_cnt <= r_cnt + 1;
+                    end if;
+                end if;
+            end if;
+        end process p_multi;
+    end block b_multi;
+
+    p_io: process(all)
+    begin
+        case lane_count(i_lanes) is
+            when 2 =>
+                o_io <= "00" & r_multi_out(1 downto 0);
+                o_io_oe <= "0011";
+            when 4 =>
+                o_io <= r_multi_out;
+                o_io_oe <= "1111";
+            when others =>
+                o_io <= "00" & r_single_out & '0';
+                o_io_oe <= "0010";
+        end case;
+    end process p_io;
+
+    o_shift_done <= r_single_done when r_single = '1' else r_multi_done;
+
+    -- Cross clock domain. Ensures that the SPI signals are stable before
+    -- being processed by the SPI entity
+    p_cdc: process(i_clk)
+    begin
+        if rising_edge(i_clk) then
+            r_sclk_buf <= r_sclk_unsafe;
+            r_mosi_buf <= r_mosi_unsafe;
+            r_cs_n_buf <= r_cs_n_unsafe;
+
+            r_sclk_unsafe <= i_sclk;
+            r_mosi_unsafe <= i_mosi;
+            r_cs_n_unsafe <= i_cs_n;
+        end if;
+    end process p_cdc;
+
+    -- Detect rising edge, which will be used for shifting
+    u_edge_shift: entity work.edge_detect(rtl)
+        generic map(
+            C_FROM => '0',
+            C_TO => '1'
+        )
+        port map(
+            i_clk => i_clk,
+            i_rst_n => i_rst_n,
+            i_sig => r_sclk_buf,
+            o_edge => r_shift_en
+        );
+
+    -- Detect falling edge, which will be used for sampling
+    u_edge_sample: entity work.edge_detect(rtl)
+        generic map(
+            C_FROM => '1',
+            C_TO => '0'
+        )
+        port map(
+            i_clk => i_clk,
+            i_rst_n => i_rst_n,
+            i_sig => r_sclk_buf,
+            o_edge => r_sample_en
+        );
+
+    o_active <= not r_cs_n_buf;
+
+end architecture rtl;
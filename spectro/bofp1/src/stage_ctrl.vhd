@@ -7,13 +7,15 @@ use work.ctrl_common.all;
 
 -- Mux pipeline stage signals, depending on its respective field in the PRC
 -- register. If enabled, this uses the _pl signals to output, otherwise
--- the pipeline stage is skipped and _raw signals are used.
+-- the pipeline stage is skipped and _raw signals are used. i_force enables
+-- the stage regardless of the PRC register.
 entity stage_ctrl is
     generic (
         C_FIELD: t_prc_ctrl
     );
     port (
         i_regmap: in t_regmap;
+        i_force: in std_logic := '0';
 
         i_data_raw: in std_logic_vector(15 downto 0);
         i_data_pl: in std_logic_vector(15 downto 0);
@@ -32,7 +34,7 @@ end entity stage_ctrl;
 architecture behaviour of stage_ctrl is
     signal r_ena: std_logic;
 begin
-    r_ena <= get_prc(i_regmap, C_FIELD);
+    r_ena <= get_prc(i_regmap, C_FIELD) or i_force;
 
     o_en <= r_ena;
     o_data <= i_data_pl when r_ena else i_data_raw;
@@ -0,0 +1,145 @@
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+-- Pipelined division by a divisor that rarely changes, e.g. a register.
+--
+-- The quotient is computed as (dividend * m) >> k with the reciprocal
+-- m = floor(2^k / divisor) + 1 and k = G_WIDTH + G_DIV_WIDTH, which is exact
+-- for every dividend below 2^G_WIDTH. The reciprocal is computed bit by bit
+-- whenever the divisor changes, which takes k + 3 cycles, and the divisor
+-- must be stable for that long before the first division. A power of two
+-- divisor is a plain shift, and is ready right away.
+--
+-- A dividend is accepted every cycle, and the quotient follows three cycles
+-- later. A divisor of 0 divides by 1.
+entity div_pipe is
+    generic (
+        G_WIDTH: integer;
+        G_DIV_WIDTH: integer
+    );
+    port (
+        i_clk: in std_logic;
+        i_rst_n: in std_logic;
+        i_divisor: in std_logic_vector(G_DIV_WIDTH-1 downto 0);
+        i_rdy: in std_logic;
+        i_data: in std_logic_vector(G_WIDTH-1 downto 0);
+        o_rdy: out std_logic;
+        o_data: out std_logic_vector(G_WIDTH-1 downto 0);
+        -- A division is in flight
+        o_busy: out std_logic
+    );
+end entity div_pipe;
+
+architecture rtl of div_pipe is
+    constant c_k: integer := G_WIDTH + G_DIV_WIDTH;
+    constant c_latency: integer := 3;
+
+    subtype t_divisor is unsigned(G_DIV_WIDTH-1 downto 0);
+
+    signal r_divisor: t_divisor;
+    signal r_divisor_last: t_divisor;
+
+    -- Reciprocal of a divisor that is not a power of two
+    signal r_recip: unsigned(c_k downto 0);
+    signal r_rem: unsigned(G_DIV_WIDTH downto 0);
+    signal r_bit: integer range -1 to c_k;
+    signal r_calc: std_logic;
+
+    -- Shift of a power of two divisor
+    signal r_pow2: boolean;
+    signal r_shift: integer range 0 to G_DIV_WIDTH-1;
+
+    signal r_in: unsigned(G_WIDTH-1 downto 0);
+    signal r_prod: unsigned(2*G_WIDTH+G_DIV_WIDTH downto 0);
+    signal r_rdy: std_logic_vector(c_latency-1 downto 0);
+
+    function is_pow2(val: t_divisor) return boolean is
+    begin
+        return (val and (val - 1)) = 0;
+    end function is_pow2;
+
+    function log2(val: t_divisor) return integer is
+    begin
+        for i in val'high downto 0 loop
+            if val(i) = '1' then
+                return i;
+            end if;
+        end loop;
+
+        return 0;
+    end function log2;
+begin
+    r_divisor <= to_unsigned(1, G_DIV_WIDTH) when unsigned(i_divisor) = 0
+                 else unsigned(i_divisor);
+
+    p_pow2: process(i_clk)
+    begin
+        if rising_edge(i_clk) then
+            r_pow2 <= is_pow2(r_divisor);
+            r_shift <= log2(r_divisor);
+        end if;
+    end process p_pow2;
+
+    -- Restoring division of 2^k by the divisor, one quotient bit per cycle
+    p_recip: process(i_clk)
+        variable v_rem: unsigned(r_rem'high+1 downto 0);
+    begin
+        if rising_edge(i_clk) then
+            r_divisor_last <= r_divisor;
+
+            if i_rst_n = '0' or r_divisor /= r_divisor_last then
+                r_recip <= (others => '0');
+                r_rem <= (others => '0');
+                r_bit <= c_k;
+                r_calc <= '1';
+            elsif r_bit >= 0 then
+                v_rem := r_rem & '0';
+                if r_bit = c_k then
+                    v_rem(0) := '1';
+                end if;
+
+                if v_rem >= r_divisor then
+                    v_rem := v_rem - r_divisor;
+                    r_recip(r_bit) <= '1';
+                end if;
+
+                r_rem <= resize(v_rem, r_rem'length);
+                r_bit <= r_bit - 1;
+            elsif r_calc = '1' then
+                r_recip <= r_recip + 1;
+                r_calc <= '0';
+            end if;
+        end if;
+    end process p_recip;
+
+    -- Register the dividend, multiply, and scale the product back. Each
+    -- step is registered so that the multiplier maps onto DSP slices.
+    p_div: process(i_clk)
+    begin
+        if rising_edge(i_clk) then
+            if i_rst_n = '0' then
+                r_rdy <= (others => '0');
+            else
+                r_rdy <= r_rdy(r_rdy'high-1 downto 0) & i_rdy;
+            end if;
+
+            r_in <= unsigned(i_data);
+
+            if r_pow2 then
+                r_prod <= shift_left(resize(r_in, r_prod'length),
+                                     c_k - r_shift);
+            else
+                r_prod <= resize(r_in * r_recip, r_prod'length);
+            end if;
+
+            o_data <= std_logic_vector(resize(r_prod(r_prod'high downto c_k),
+                                              G_WIDTH));
+        end if;
+    end process p_div;
+
+    o_rdy <= r_rdy(r_rdy'high);
+    o_busy <= '1' when unsigned(r_rdy) /= 0 else '0';
+
+end architecture rtl;
@@ -0,0 +1,193 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use ieee.math_real.all;
+use std.env.stop;
+
+library uvvm_util;
+context uvvm_util.uvvm_util_context;
+
+entity tb_spi_sub_quad is
+    generic (
+        G_CLK_FREQ: integer := 100_000_000;
+        G_SCLK_FREQ: integer := 5_000_000
+    );
+end entity tb_spi_sub_quad;
+
+architecture bhv of tb_spi_sub_quad is
+    type t_bytes is array(natural range <>) of std_logic_vector(7 downto 0);
+
+    -- Bytes shifted out by the sub, advanced on every shift done like ctrl
+    constant c_bytes: t_bytes := (x"C3", x"A5", x"1E", x"96", x"7B");
+
+    signal r_clk: std_logic;
+    signal r_clkena: boolean;
+    signal r_rst_n: std_logic := '0';
+
+    signal r_sclk: std_logic := '0';
+    signal r_cs_n: std_logic := '1';
+    signal r_mosi: std_logic := '0';
+    signal r_io: std_logic_vector(3 downto 0);
+    signal r_io_oe: std_logic_vector(3 downto 0);
+
+    signal r_lanes: std_logic_vector(1 downto 0) := "00";
+    signal r_data: std_logic_vector(7 downto 0);
+    signal r_data_shf: std_logic_vector(7 downto 0);
+    signal r_sample_done: std_logic;
+    signal r_shift_done: std_logic;
+
+    signal r_idx: natural := 0;
+    signal r_samples: natural := 0;
+
+    constant c_scope: string := C_TB_SCOPE_DEFAULT;
+
+    constant c_clk_period: time := (1.0 / real(G_CLK_FREQ)) * (1 sec);
+    constant c_sclk_half: time := (0.5 / real(G_SCLK_FREQ)) * (1 sec);
+begin
+    clock_generator(r_clk, r_clkena, c_clk_period, "Main");
+
+    u_spi: entity work.spi_sub_quad(rtl)
+        generic map(
+            G_DATA_WIDTH => 8
+        )
+        port map(
+            i_clk => r_clk,
+            i_rst_n => r_rst_n,
+            i_sclk => r_sclk,
+            i_data => r_data,
+            i_lanes => r_lanes,
+            i_mosi => r_mosi,
+            i_cs_n => r_cs_n,
+            o_io => r_io,
+            o_io_oe => r_io_oe,
+            o_data_shf => r_data_shf,
+            o_sample_done => r_sample_done,
+            o_shift_done => r_shift_done
+        );
+
+    p_data: process(r_clk)
+    begin
+        if rising_edge(r_clk) then
+            if r_cs_n = '1' then
+                r_idx <= 0;
+            elsif r_shift_done = '1' and r_idx < c_bytes'high then
+                r_idx <= r_idx + 1;
+            end if;
+
+            if r_sample_done = '1' then
+                r_samples <= r_samples + 1;
+            end if;
+        end if;
+    end process p_data;
+
+    r_data <= c_bytes(r_idx);
+
+    p_main: process
+        -- Transfer a byte in mode 1, sending `tx` on MOSI for a single lane
+        -- and receiving on as many lanes as the sub is set up for
+        procedure transfer(constant tx: in std_logic_vector(7 downto 0);
+                           constant lanes: in natural;
+                           variable rx: out std_logic_vector(7 downto 0)) is
+            variable v_head: natural;
+        begin
+            for i in 0 to 8 / lanes - 1 loop
+                r_sclk <= '1';
+                r_mosi <= tx(7 - i);
+                wait for c_sclk_half;
+
+                r_sclk <= '0';
+                v_head := 7 - i * lanes;
+                if lanes = 1 then
+                    rx(v_head) := r_io(1);
+                else
+                    for l in 0 to lanes - 1 loop
+                        rx(v_head - (lanes-1-l)) := r_io(l);
+                    end loop;
+                end if;
+                wait for c_sclk_half;
+            end loop;
+        end procedure transfer;
+
+        variable v_rx: std_logic_vector(7 downto 0);
+        variable v_samples: natural;
+    begin
+        report_global_ctrl(VOID);
+        report_msg_id_panel(VOID);
+        enable_log_msg(ALL_MESSAGES);
+
+        log(ID_LOG_HDR, "Simulation setup", c_scope);
+        r_clkena <= true;
+        wait for 10 * c_clk_period;
+        r_rst_n <= '1';
+        wait for 10 * c_clk_period;
+
+        log(ID_LOG_HDR, "Start simulation SPI sub quad", c_scope);
+        ------------------------------------------------------------------------
+        r_cs_n <= '0';
+        wait for c_sclk_half;
+
+        check_value(r_io_oe, "0010", ERROR, "Only MISO driven on one lane",
+                    c_scope);
+
+        -- Command on a single lane
+        transfer(x"5A", 1, v_rx);
+        wait for 10 * c_clk_period;
+        check_value(r_data_shf, x"5A", ERROR, "Command sampled", c_scope);
+        check_value(v_rx, c_bytes(0), ERROR, "Single lane byte", c_scope);
+
+        -- Switch to four lanes after the command, like ctrl when streaming
+        r_lanes <= "10";
+        v_samples := r_samples;
+        wait for c_clk_period;
+
+        check_value(r_io_oe, "1111", ERROR, "All lanes driven", c_scope);
+
+        transfer(x"00", 4, v_rx);
+        check_value(v_rx, c_bytes(1), ERROR, "First quad lane byte", c_scope);
+
+        transfer(x"00", 4, v_rx);
+        check_value(v_rx, c_bytes(2), ERROR, "Second quad lane byte",
+                    c_scope);
+
+        check_value(r_samples, v_samples, ERROR,
+                    "No sampling while driving IO0", c_scope);
+
+        -- Two lanes
+        r_lanes <= "01";
+        wait for c_clk_period;
+
+        check_value(r_io_oe, "0011", ERROR, "Two lanes driven", c_scope);
+
+        transfer(x"00", 2, v_rx);
+        check_value(v_rx, c_bytes(3), ERROR, "Dual lane byte", c_scope);
+
+        r_lanes <= "00";
+        r_cs_n <= '1';
+        wait for 10 * c_clk_period;
+
+        check_value(r_io_oe, "0010", ERROR, "IO0, IO2 and IO3 released",
+                    c_scope);
+
+        -- A new transaction starts over on a single lane
+        r_cs_n <= '0';
+        wait for c_sclk_half;
+
+        transfer(x"A5", 1, v_rx);
+        wait for 10 * c_clk_period;
+        check_value(r_data_shf, x"A5", ERROR, "Command sampled again",
+                    c_scope);
+        check_value(v_rx, c_bytes(0), ERROR, "Single lane byte again",
+                    c_scope);
+
+        r_cs_n <= '1';
+
+        -- End simulation
+        ------------------------------------------------------------------------
+        log(ID_LOG_HDR, "End simulation SPI sub quad", c_scope);
+        wait for 1 us;
+        report_alert_counters(FINAL);
+
+        wait for 1000 ns;
+        stop;
+    end process p_main;
+end architecture bhv;
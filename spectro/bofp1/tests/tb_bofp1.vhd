@@ -54,6 +54,10 @@ architecture bhv of tb_bofp1 is
     constant c_reg_status: std_logic_vector(7 downto 0) := x"8a";
     constant c_reg_dc_calib: std_logic_vector(15 downto 0) := x"8b00";
     constant c_reg_flush: std_logic_Vector(15 downto 0) := x"8c00";
+    constant c_reg_roi_start1: integer := 16#0e#;
+    constant c_reg_fir_taps: std_logic_vector(7 downto 0) := x"98";
+    constant c_burst_rd: std_logic_vector(7 downto 0) := x"40";
+    constant c_burst_wr: std_logic_vector(7 downto 0) := x"C0";
 
     constant c_clk_period: time := (1.0 / real(G_CLK_FREQ)) * (1 sec);
     constant c_sclk_period: time := c_clk_period * G_SCLK_DIV;
@@ -171,6 +175,7 @@ begin
             o_adc_stconv => r_adc_stconv,
 
             o_fifo_wmark => r_fifo_wmark,
+            i_trigger => '0',
 
             i_spi_main_miso => r_spi_main_if.miso,
             o_spi_main_mosi => r_spi_main_if.mosi,
@@ -179,8 +184,10 @@ begin
 
             i_spi_sub_sclk => r_spi_sub_if.sclk,
             i_spi_sub_cs_n => r_spi_sub_if.ss_n,
-            i_spi_sub_mosi => r_spi_sub_if.mosi,
-            o_spi_sub_miso => r_spi_sub_if.miso
+            io_spi_sub_mosi => r_spi_sub_if.mosi,
+            o_spi_sub_miso => r_spi_sub_if.miso,
+            o_spi_sub_io2 => open,
+            o_spi_sub_io3 => open
         );
 
     -- ADC and CCD emulation
@@ -511,6 +518,17 @@ begin
             );
         end procedure set_moving_avg_n;
 
+        procedure set_fir_taps(constant n: integer) is
+        begin
+            spi_master_transmit(
+                std_logic_vector'(
+                    c_reg_fir_taps & std_logic_vector(to_unsigned(n, 8))),
+                "Set FIR taps",
+                r_spi_sub_if,
+                config => r_spi_conf
+            );
+        end procedure set_fir_taps;
+
         procedure set_total_avg_n(constant n: integer) is
         begin
             spi_master_transmit(
@@ -571,6 +589,78 @@ begin
             end loop;
         end procedure check_frame;
 
+        -- Burst access of len registers from addr. Any bytes clocked past
+        -- the length are ignored on writes and read back as 0.
+        procedure burst_write(constant addr: integer;
+                              constant data: std_logic_vector;
+                              constant len: integer := -1) is
+            variable v_len: integer := len;
+        begin
+            if v_len < 0 then
+                v_len := data'length / 8;
+            end if;
+
+            spi_master_transmit(
+                std_logic_vector'(
+                    (c_burst_wr or std_logic_vector(to_unsigned(addr, 8))) &
+                    std_logic_vector(to_unsigned(v_len, 8)) & data),
+                "Burst write",
+                r_spi_sub_if,
+                config => r_spi_conf
+            );
+        end procedure burst_write;
+
+        procedure check_burst_read(constant addr: integer;
+                                   constant len: integer;
+                                   constant expected: std_logic_vector;
+                                   constant msg: string) is
+            variable tx_data: std_logic_vector(expected'length + 15 downto 0) :=
+                (others => '0');
+            variable rx_data: std_logic_vector(tx_data'range);
+        begin
+            tx_data(tx_data'high downto tx_data'high-15) :=
+                (c_burst_rd or std_logic_vector(to_unsigned(addr, 8))) &
+                std_logic_vector(to_unsigned(len, 8));
+
+            spi_master_transmit_and_receive(
+                tx_data,
+                rx_data,
+                msg,
+                r_spi_sub_if,
+                config => r_spi_conf
+            );
+
+            check_value(rx_data(expected'length-1 downto 0), expected, msg);
+        end procedure check_burst_read;
+
+        procedure check_burst is
+            constant c_roi: std_logic_vector(31 downto 0) := x"01234567";
+        begin
+            check_burst_read(c_reg_roi_start1, 4, x"00000000",
+                             "Burst read of defaults");
+
+            burst_write(c_reg_roi_start1, c_roi);
+            check_burst_read(c_reg_roi_start1, 4, c_roi,
+                             "Burst readback");
+
+            -- Registers that are not configuration read as 0, and so does
+            -- everything past the length
+            check_burst_read(c_reg_roi_start1 - 2, 4,
+                             x"0000" & c_roi(31 downto 16) & x"0000",
+                             "Burst read of other registers");
+
+            -- Only as many registers as the length are written
+            burst_write(c_reg_roi_start1, x"89ABCDEF", 2);
+            check_burst_read(c_reg_roi_start1, 4, x"89AB" & c_roi(15 downto 0),
+                             "Burst write length");
+
+            -- Writes to registers that are not configuration are ignored,
+            -- such as the flush command here
+            burst_write(c_reg_roi_start1 - 2, x"FFFF00000000");
+            check_burst_read(c_reg_roi_start1, 4, x"00000000",
+                             "Burst write of other registers");
+        end procedure check_burst;
+
         procedure do_dc_calib is
         begin
             r_dc_calib <= true;
@@ -633,6 +723,13 @@ begin
             config => r_spi_conf
         );
 
+        check_burst;
+
+        -- The boxcar moving average takes over again once the FIR taps are
+        -- cleared, which the moving average checks below rely on
+        set_fir_taps(5);
+        set_fir_taps(0);
+
         set_moving_avg_n(c_moving_avg_n);
         set_total_avg_n(c_total_avg_n);
 
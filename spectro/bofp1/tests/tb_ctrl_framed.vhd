@@ -0,0 +1,265 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use ieee.math_real.all;
+use std.env.stop;
+
+library uvvm_util;
+context uvvm_util.uvvm_util_context;
+
+library bitvis_vip_spi;
+use bitvis_vip_spi.spi_bfm_pkg.all;
+
+use work.ctrl_common.all;
+
+-- Framed streams of the pipeline FIFO through REG_STREAM_FRAMED: the length
+-- sent with the command, the header, payload, CRC and trailing status, and
+-- the sequence number across transactions.
+entity tb_ctrl_framed is
+    generic (
+        G_CLK_FREQ: integer := 100_000_000;
+        G_SCLK_DIV: integer := 13
+    );
+end entity tb_ctrl_framed;
+
+architecture bhv of tb_ctrl_framed is
+    signal r_clk: std_logic;
+    signal r_clkena: boolean;
+    signal r_rst_n: std_logic := '0';
+
+    signal r_spi_if: t_spi_if;
+    signal r_spi_conf: t_spi_bfm_config := C_SPI_BFM_CONFIG_DEFAULT;
+    signal r_io: std_logic_vector(3 downto 0);
+
+    signal r_regmap: t_regmap;
+    signal r_stats: t_frame_stats;
+    signal r_errors: t_err_bitmap := (others => '0');
+
+    -- Pipeline FIFO with first-word write-through, counting up on reads
+    signal r_fifo_val: unsigned(15 downto 0) := x"1000";
+    signal r_fifo_rd: std_logic;
+
+    -- Raise an underflow along with the read of this word
+    signal r_err_arm: boolean := false;
+    signal r_err_val: unsigned(15 downto 0);
+
+    constant c_reg_framed: std_logic_vector(7 downto 0) := x"14";
+    constant c_reg_status_clear: std_logic_vector(15 downto 0) := x"8a00";
+
+    constant c_max_len: integer := 64;
+    -- Command, length and dummy byte, then the header, payload and trailer
+    constant c_max_bits: integer := 32 + (c_max_len + 4) * 16;
+
+    constant c_scope: string := C_TB_SCOPE_DEFAULT;
+
+    constant c_clk_period: time := (1.0 / real(G_CLK_FREQ)) * (1 sec);
+    constant c_sclk_period: time := c_clk_period * G_SCLK_DIV;
+begin
+    clock_generator(r_clk, r_clkena, c_clk_period, "Main");
+
+    u_ctrl: entity work.ctrl(behaviour)
+        port map(
+            i_clk => r_clk,
+            i_rst_n => r_rst_n,
+            o_ccd_sample => open,
+            o_rst => open,
+
+            i_sclk => r_spi_if.sclk,
+            i_cs_n => r_spi_if.ss_n,
+            i_mosi => r_spi_if.mosi,
+            o_io => r_io,
+            o_io_oe => open,
+
+            i_fifo_raw_data => (others => '0'),
+            i_fifo_pl_data => std_logic_vector(r_fifo_val),
+            o_fifo_raw_rd => open,
+            o_fifo_pl_rd => r_fifo_rd,
+
+            o_dc_calib => open,
+            o_ccd_flush => open,
+            o_fir_coef_wr => open,
+
+            i_stats => r_stats,
+
+            i_errors => r_errors,
+            io_regmap => r_regmap
+        );
+
+    r_spi_if.miso <= r_io(1);
+
+    p_fifo: process(r_clk)
+    begin
+        if rising_edge(r_clk) then
+            r_errors <= (others => '0');
+
+            if r_fifo_rd = '1' then
+                r_fifo_val <= r_fifo_val + 1;
+
+                if r_err_arm and r_fifo_val = r_err_val then
+                    r_errors(t_err'pos(ERR_FIFO_PL_UNDERFLOW)) <= '1';
+                end if;
+            end if;
+        end if;
+    end process p_fifo;
+
+    p_main: process
+        variable v_seq: natural := 0;
+
+        -- Read a framed stream of len words, and check every part of it.
+        -- With abort_at, the transaction ends after that many payload words.
+        procedure framed_read(constant len: in natural;
+                              constant status: in std_logic_vector(7 downto 0);
+                              constant abort_at: in integer := -1) is
+            variable tx: std_logic_vector(c_max_bits-1 downto 0) :=
+                (others => '0');
+            variable rx: std_logic_vector(tx'range);
+            variable bits: natural;
+            variable head: natural;
+            variable word: std_logic_vector(15 downto 0);
+            variable crc: std_logic_vector(15 downto 0);
+            variable first: unsigned(15 downto 0);
+        begin
+            first := r_fifo_val;
+
+            if abort_at >= 0 then
+                bits := 32 + (2 + abort_at) * 16;
+            else
+                bits := 32 + (len + 4) * 16;
+            end if;
+
+            tx(tx'high downto tx'high-31) :=
+                c_reg_framed & std_logic_vector(to_unsigned(len, 16)) & x"00";
+
+            spi_master_transmit_and_receive(
+                tx(tx'high downto tx'length - bits),
+                rx(rx'high downto rx'length - bits),
+                "Framed read of " & integer'image(len) & " words",
+                r_spi_if,
+                config => r_spi_conf
+            );
+
+            crc := c_frame_crc_init;
+            head := rx'high - 32;
+
+            -- Header
+            word := rx(head downto head-15);
+            check_value(unsigned(word), to_unsigned(v_seq, 16), ERROR,
+                        "Header sequence", c_scope);
+            crc := crc16_update(crc, word);
+            head := head - 16;
+
+            word := rx(head downto head-15);
+            check_value(unsigned(word), to_unsigned(len, 16), ERROR,
+                        "Header length", c_scope);
+            crc := crc16_update(crc, word);
+            head := head - 16;
+
+            -- Payload
+            for i in 0 to len-1 loop
+                if i = abort_at then
+                    return;
+                end if;
+
+                word := rx(head downto head-15);
+                check_value(unsigned(word), first + i, ERROR,
+                            "Payload word " & integer'image(i), c_scope);
+                crc := crc16_update(crc, word);
+                head := head - 16;
+            end loop;
+
+            -- Trailer
+            check_value(rx(head downto head-15), crc, ERROR, "CRC", c_scope);
+            head := head - 16;
+            check_value(rx(head downto head-15), x"00" & status, ERROR,
+                        "Trailer status", c_scope);
+
+            check_value(r_fifo_val, first + len, ERROR,
+                        "Payload drained from the FIFO", c_scope);
+
+            v_seq := v_seq + 1;
+        end procedure framed_read;
+
+        variable v_status: std_logic_vector(7 downto 0);
+    begin
+        report_global_ctrl(VOID);
+        report_msg_id_panel(VOID);
+        enable_log_msg(ALL_MESSAGES);
+
+        log(ID_LOG_HDR, "Simulation setup", c_scope);
+        ------------------------------------------------------------------------
+        r_spi_conf.CPOL <= '0';
+        r_spi_conf.CPHA <= '1';
+        r_spi_conf.spi_bit_time <= c_sclk_period;
+        r_spi_conf.ss_n_to_sclk <= 4 * c_clk_period;
+        r_spi_conf.sclk_to_ss_n <= 4 * c_clk_period;
+        r_spi_conf.inter_word_delay <= c_clk_period;
+
+        r_spi_if <= init_spi_if_signals(
+            config => r_spi_conf,
+            master_mode => true
+        );
+        r_clkena <= true;
+
+        wait for 10 * c_clk_period;
+        r_rst_n <= '1';
+        wait for 10 * c_clk_period;
+
+        log(ID_LOG_HDR, "Start simulation framed stream", c_scope);
+        ------------------------------------------------------------------------
+        -- The length is latched from each command
+        framed_read(5, x"00");
+        framed_read(16, x"00");
+        framed_read(1, x"00");
+        framed_read(c_max_len, x"00");
+
+        -- Header directly followed by the trailer
+        framed_read(0, x"00");
+
+        -- An aborted stream doesn't complete, so the sequence carries on
+        -- from the last complete one
+        framed_read(8, x"00", 3);
+        framed_read(4, x"00");
+
+        -- An underflow on the last word of the payload is in the status of
+        -- the same chunk
+        v_status := (others => '0');
+        v_status(t_err'pos(ERR_FIFO_PL_UNDERFLOW)) := '1';
+
+        r_err_val <= r_fifo_val + 5;
+        r_err_arm <= true;
+        wait for 1 ps;
+        framed_read(6, v_status);
+        r_err_arm <= false;
+
+        -- Errors persist until cleared
+        framed_read(2, v_status);
+
+        spi_master_transmit(
+            c_reg_status_clear,
+            "Clear status",
+            r_spi_if,
+            config => r_spi_conf
+        );
+
+        framed_read(2, x"00");
+
+        -- A reset restarts the sequence
+        r_rst_n <= '0';
+        wait for 10 * c_clk_period;
+        r_rst_n <= '1';
+        wait for 10 * c_clk_period;
+        v_seq := 0;
+
+        framed_read(3, x"00");
+
+        -- End simulation
+        ------------------------------------------------------------------------
+        log(ID_LOG_HDR, "End simulation framed stream", c_scope);
+        wait for 1 us;
+        report_alert_counters(FINAL);
+
+        wait for 1000 ns;
+        stop;
+    end process p_main;
+
+end architecture bhv;
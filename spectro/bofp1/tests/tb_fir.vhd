@@ -0,0 +1,271 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use ieee.math_real.all;
+use std.env.stop;
+
+library uvvm_util;
+context uvvm_util.uvvm_util_context;
+
+-- FIR filter: the impulse response against the written coefficients, the
+-- 2.14 scaling with rounding and saturation, and the number of taps,
+-- including 0, which runs as a single tap.
+entity tb_fir is
+    generic (
+        G_CLK_FREQ: integer := 100_000_000
+    );
+end entity tb_fir;
+
+architecture bhv of tb_fir is
+    signal r_clk: std_logic;
+    signal r_clkena: boolean;
+    signal r_rst_n: std_logic := '0';
+
+    signal r_en: std_logic := '0';
+    signal r_rdy: std_logic := '0';
+    signal r_taps: std_logic_vector(6 downto 0) := (others => '0');
+    signal r_data: std_logic_vector(15 downto 0) := (others => '0');
+
+    signal r_coef_wr: std_logic := '0';
+    signal r_coef_addr: std_logic_vector(5 downto 0) := (others => '0');
+    signal r_coef: std_logic_vector(15 downto 0) := (others => '0');
+
+    signal r_busy: std_logic;
+    signal r_rdy_out: std_logic;
+    signal r_data_out: std_logic_vector(15 downto 0);
+
+    constant c_pix_count: integer := 80;
+    -- Cycles in between pixels, enough for the maximum number of taps
+    constant c_pix_gap: integer := 80;
+    -- 1.0 in 2.14 fixed point
+    constant c_one: integer := 2**14;
+
+    type t_pixels is array(0 to c_pix_count-1) of natural;
+
+    -- Output of the last frame
+    signal r_out: t_pixels;
+    signal r_out_count: natural;
+    signal r_out_clear: boolean := false;
+
+    constant c_scope: string := C_TB_SCOPE_DEFAULT;
+
+    constant c_clk_period: time := (1.0 / real(G_CLK_FREQ)) * (1 sec);
+begin
+    clock_generator(r_clk, r_clkena, c_clk_period, "Main");
+
+    u_fir: entity work.fir(behaviour)
+        port map(
+            i_clk => r_clk,
+            i_rst_n => r_rst_n,
+            i_en => r_en,
+            i_rdy => r_rdy,
+            i_taps => r_taps,
+            i_data => r_data,
+            i_coef_wr => r_coef_wr,
+            i_coef_addr => r_coef_addr,
+            i_coef => r_coef,
+            o_busy => r_busy,
+            o_rdy => r_rdy_out,
+            o_data => r_data_out
+        );
+
+    p_out: process(r_clk)
+    begin
+        if rising_edge(r_clk) then
+            if r_out_clear then
+                r_out_count <= 0;
+            elsif r_rdy_out = '1' and r_out_count < c_pix_count then
+                r_out(r_out_count) <= to_integer(unsigned(r_data_out));
+                r_out_count <= r_out_count + 1;
+            end if;
+        end if;
+    end process p_out;
+
+    p_main: process
+        variable v_pixels: t_pixels;
+        variable v_expected: integer;
+
+        procedure wait_clk(constant n: in positive) is
+        begin
+            for i in 1 to n loop
+                wait until rising_edge(r_clk);
+            end loop;
+        end procedure wait_clk;
+
+        -- Write a 2.14 coefficient, given as a signed integer
+        procedure write_coef(constant addr: in natural;
+                             constant coef: in integer) is
+        begin
+            r_coef_addr <= std_logic_vector(to_unsigned(addr, 6));
+            r_coef <= std_logic_vector(to_signed(coef, 16));
+            r_coef_wr <= '1';
+            wait_clk(1);
+            r_coef_wr <= '0';
+        end procedure write_coef;
+
+        -- Filter one frame, with the number of taps set in between frames
+        procedure run_frame(constant taps: in natural;
+                            constant pixels: in t_pixels) is
+        begin
+            r_taps <= std_logic_vector(to_unsigned(taps, r_taps'length));
+            r_out_clear <= true;
+            wait_clk(4);
+            r_out_clear <= false;
+
+            r_en <= '1';
+            wait_clk(2);
+
+            for i in pixels'range loop
+                r_data <= std_logic_vector(to_unsigned(pixels(i), 16));
+                r_rdy <= '1';
+                wait_clk(1);
+                r_rdy <= '0';
+                wait_clk(c_pix_gap);
+            end loop;
+
+            r_en <= '0';
+            wait_clk(4);
+            check_value(r_busy, '0', ERROR, "Idle after the frame", c_scope);
+        end procedure run_frame;
+
+        procedure check_count(constant expected: in natural;
+                              constant msg: in string) is
+        begin
+            check_value(r_out_count, expected, ERROR, msg & ": pixel count",
+                        c_scope);
+        end procedure check_count;
+
+        procedure check_pixel(constant idx: in natural;
+                              constant expected: in natural;
+                              constant msg: in string) is
+        begin
+            check_value(r_out(idx), expected, ERROR,
+                        msg & ": pixel " & integer'image(idx), c_scope);
+        end procedure check_pixel;
+
+        -- Impulse on a baseline, so that negative coefficients show too
+        constant c_base: integer := 8000;
+        constant c_impulse: integer := 4000;
+        constant c_impulse_pos: integer := 40;
+
+        type t_coefs is array(natural range <>) of integer;
+        constant c_coefs: t_coefs := (
+            c_one / 4, c_one / 2, c_one, -c_one / 2, c_one / 8
+        );
+        variable v_coef_sum: integer;
+        variable v_tap: integer;
+    begin
+        report_global_ctrl(VOID);
+        report_msg_id_panel(VOID);
+        enable_log_msg(ALL_MESSAGES);
+
+        log(ID_LOG_HDR, "Simulation setup", c_scope);
+        ------------------------------------------------------------------------
+        r_clkena <= true;
+
+        wait for 10 * c_clk_period;
+        r_rst_n <= '1';
+        wait_clk(10);
+
+        log(ID_LOG_HDR, "Start simulation FIR", c_scope);
+        ------------------------------------------------------------------------
+        -- Impulse response. Coefficient 0 weights the oldest pixel, so the
+        -- coefficients come out in reverse, ending on the window that
+        -- starts at the impulse.
+        v_coef_sum := 0;
+        for i in c_coefs'range loop
+            write_coef(i, c_coefs(i));
+            v_coef_sum := v_coef_sum + c_coefs(i);
+        end loop;
+
+        v_pixels := (others => c_base);
+        v_pixels(c_impulse_pos) := c_base + c_impulse;
+        run_frame(c_coefs'length, v_pixels);
+
+        check_count(c_pix_count - c_coefs'length + 1, "Impulse");
+        for i in 0 to c_pix_count - c_coefs'length loop
+            v_expected := c_base * v_coef_sum;
+            v_tap := c_impulse_pos - i;
+
+            if v_tap >= 0 and v_tap < c_coefs'length then
+                v_expected := v_expected + c_impulse * c_coefs(v_tap);
+            end if;
+
+            check_pixel(i, (v_expected + c_one / 2) / c_one, "Impulse");
+        end loop;
+
+        -- Literal values around the impulse
+        check_pixel(c_impulse_pos - 4, 11500, "Impulse");
+        check_pixel(c_impulse_pos - 3, 9000, "Impulse");
+        check_pixel(c_impulse_pos - 2, 15000, "Impulse");
+        check_pixel(c_impulse_pos - 1, 13000, "Impulse");
+        check_pixel(c_impulse_pos, 12000, "Impulse");
+        check_pixel(c_impulse_pos + 1, 11000, "Impulse");
+
+        -- Halves are rounded up
+        write_coef(0, c_one / 2);
+        for i in v_pixels'range loop
+            v_pixels(i) := i;
+        end loop;
+        run_frame(1, v_pixels);
+
+        check_count(c_pix_count, "Rounding");
+        for i in v_pixels'range loop
+            check_pixel(i, (i + 1) / 2, "Rounding");
+        end loop;
+
+        -- Saturated to the 16 bit range
+        write_coef(0, c_one * 2 - 1);
+        for i in v_pixels'range loop
+            v_pixels(i) := 65535 when i mod 2 = 0 else 1;
+        end loop;
+        run_frame(1, v_pixels);
+
+        check_count(c_pix_count, "Saturate high");
+        check_pixel(0, 65535, "Saturate high");
+        check_pixel(1, 2, "Saturate high");
+
+        write_coef(0, -c_one);
+        v_pixels := (others => 100);
+        run_frame(1, v_pixels);
+
+        check_count(c_pix_count, "Saturate low");
+        check_pixel(0, 0, "Saturate low");
+
+        -- No taps run as a single tap, which passes pixels through with a
+        -- unit coefficient. In capture, the boxcar moving average is
+        -- selected instead.
+        write_coef(0, c_one);
+        for i in v_pixels'range loop
+            v_pixels(i) := i * 100;
+        end loop;
+        run_frame(0, v_pixels);
+
+        check_count(c_pix_count, "No taps");
+        for i in v_pixels'range loop
+            check_pixel(i, i * 100, "No taps");
+        end loop;
+
+        -- Taps are limited to 64, a flat kernel keeps a flat frame
+        for i in 0 to 63 loop
+            write_coef(i, c_one / 64);
+        end loop;
+        v_pixels := (others => 6400);
+        run_frame(100, v_pixels);
+
+        check_count(c_pix_count - 63, "Max taps");
+        for i in 0 to c_pix_count - 64 loop
+            check_pixel(i, 6400, "Max taps");
+        end loop;
+
+        -- End simulation
+        ------------------------------------------------------------------------
+        log(ID_LOG_HDR, "End simulation FIR", c_scope);
+        wait for 1 us;
+        report_alert_counters(FINAL);
+
+        wait for 1000 ns;
+        stop;
+    end process p_main;
+
+end architecture bhv;
@@ -0,0 +1,275 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use ieee.math_real.all;
+use std.env.stop;
+
+library uvvm_util;
+context uvvm_util.uvvm_util_context;
+
+use work.ctrl_common.all;
+
+-- Double buffered frame store: capture into one bank while the other is
+-- read, frames dropped when both banks are full, and the error flags.
+entity tb_frame_buffer is
+    generic (
+        G_CLK_FREQ: integer := 100_000_000;
+        G_SIZE: integer := 16
+    );
+end entity tb_frame_buffer;
+
+architecture bhv of tb_frame_buffer is
+    signal r_clk: std_logic;
+    signal r_clkena: boolean;
+    signal r_rst_n: std_logic := '0';
+
+    signal r_clear: std_logic := '0';
+    signal r_commit: std_logic := '0';
+    signal r_wr: std_logic := '0';
+    signal r_rd: std_logic := '0';
+    signal r_wr_data: std_logic_vector(15 downto 0) := (others => '0');
+    signal r_rd_data: std_logic_vector(15 downto 0);
+    signal r_empty: std_logic;
+    signal r_watermark: std_logic;
+    signal r_errors: t_err_bitmap;
+
+    -- Errors seen since last checked
+    signal r_overflow: boolean := false;
+    signal r_underflow: boolean := false;
+    signal r_err_clear: boolean := false;
+
+    constant c_len: integer := 8;
+
+    constant c_scope: string := C_TB_SCOPE_DEFAULT;
+
+    constant c_clk_period: time := (1.0 / real(G_CLK_FREQ)) * (1 sec);
+begin
+    clock_generator(r_clk, r_clkena, c_clk_period, "Main");
+
+    u_buf: entity work.frame_buffer(behaviour)
+        generic map(
+            C_OVERFLOW => ERR_FRAME_BUF_OVERFLOW,
+            C_UNDERFLOW => ERR_FRAME_BUF_UNDERFLOW,
+            C_SIZE => G_SIZE
+        )
+        port map(
+            i_clk => r_clk,
+            i_rst_n => r_rst_n,
+            i_clear => r_clear,
+            i_commit => r_commit,
+            i_wr => r_wr,
+            i_rd => r_rd,
+            i_data => r_wr_data,
+            o_data => r_rd_data,
+            o_empty => r_empty,
+            o_watermark => r_watermark,
+            o_errors => r_errors
+        );
+
+    p_err: process(r_clk)
+    begin
+        if rising_edge(r_clk) then
+            if r_err_clear then
+                r_overflow <= false;
+                r_underflow <= false;
+            else
+                if r_errors(t_err'pos(ERR_FRAME_BUF_OVERFLOW)) = '1' then
+                    r_overflow <= true;
+                end if;
+
+                if r_errors(t_err'pos(ERR_FRAME_BUF_UNDERFLOW)) = '1' then
+                    r_underflow <= true;
+                end if;
+            end if;
+        end if;
+    end process p_err;
+
+    p_main: process
+        -- Word i of frame n
+        function frame_word(n: natural; i: natural)
+            return std_logic_vector is
+        begin
+            return std_logic_vector(to_unsigned(n * 256 + i, 16));
+        end function frame_word;
+
+        procedure wait_clk(constant n: in positive) is
+        begin
+            for i in 1 to n loop
+                wait until rising_edge(r_clk);
+            end loop;
+        end procedure wait_clk;
+
+        -- Write, read or both in the same cycle. A read first checks the
+        -- current word, and then leaves time for the next one to be fetched
+        -- from the BRAM.
+        procedure access_word(constant wr_frame: in integer;
+                              constant wr_idx: in integer;
+                              constant rd_frame: in integer;
+                              constant rd_idx: in integer) is
+        begin
+            if wr_frame >= 0 then
+                r_wr <= '1';
+                r_wr_data <= frame_word(wr_frame, wr_idx);
+            end if;
+
+            if rd_frame >= 0 then
+                check_value(r_empty, '0', ERROR, "Not empty when reading",
+                            c_scope);
+                check_value(r_rd_data, frame_word(rd_frame, rd_idx), ERROR,
+                            "Frame " & integer'image(rd_frame) & " word " &
+                            integer'image(rd_idx), c_scope);
+                r_rd <= '1';
+            end if;
+
+            wait_clk(1);
+            r_wr <= '0';
+            r_rd <= '0';
+            wait_clk(6);
+        end procedure access_word;
+
+        procedure write_frame(constant n: in natural;
+                              constant len: in natural := c_len) is
+        begin
+            for i in 0 to len-1 loop
+                access_word(n, i, -1, 0);
+            end loop;
+        end procedure write_frame;
+
+        procedure read_frame(constant n: in natural) is
+        begin
+            check_value(r_watermark, '1', ERROR,
+                        "Frame " & integer'image(n) & " ready", c_scope);
+
+            for i in 0 to c_len-1 loop
+                access_word(-1, 0, n, i);
+            end loop;
+        end procedure read_frame;
+
+        procedure commit is
+        begin
+            r_commit <= '1';
+            wait_clk(1);
+            r_commit <= '0';
+            wait_clk(6);
+        end procedure commit;
+
+        procedure check_empty(constant msg: in string) is
+        begin
+            check_value(r_empty, '1', ERROR, msg, c_scope);
+            check_value(r_watermark, '0', ERROR, msg, c_scope);
+        end procedure check_empty;
+
+        procedure check_errors(constant overflow: in boolean;
+                               constant underflow: in boolean;
+                               constant msg: in string) is
+        begin
+            check_value(r_overflow, overflow, ERROR, msg & ": overflow",
+                        c_scope);
+            check_value(r_underflow, underflow, ERROR, msg & ": underflow",
+                        c_scope);
+
+            r_err_clear <= true;
+            wait_clk(1);
+            r_err_clear <= false;
+            wait_clk(1);
+        end procedure check_errors;
+    begin
+        report_global_ctrl(VOID);
+        report_msg_id_panel(VOID);
+        enable_log_msg(ALL_MESSAGES);
+
+        log(ID_LOG_HDR, "Simulation setup", c_scope);
+        ------------------------------------------------------------------------
+        r_clkena <= true;
+
+        wait for 10 * c_clk_period;
+        r_rst_n <= '1';
+        wait_clk(10);
+
+        log(ID_LOG_HDR, "Start simulation frame buffer", c_scope);
+        ------------------------------------------------------------------------
+        check_empty("Empty after reset");
+
+        -- A frame is only readable once committed
+        write_frame(0);
+        check_empty("Empty before commit");
+        commit;
+
+        -- Capture frame 1 into the other bank while frame 0 is read, with
+        -- a write and a read in the same cycle
+        for i in 0 to c_len-1 loop
+            access_word(1, i, 0, i);
+        end loop;
+
+        check_empty("Empty before the second commit");
+        commit;
+        read_frame(1);
+        check_empty("Empty after reading both");
+        check_errors(false, false, "Capture while reading");
+
+        -- Both banks full, the next frame is dropped entirely, also when a
+        -- bank is freed halfway through its capture
+        write_frame(2);
+        commit;
+        write_frame(3);
+        commit;
+        check_errors(false, false, "Both banks full");
+
+        for i in 0 to c_len-1 loop
+            access_word(4, i, 2, i);
+        end loop;
+
+        commit;
+        check_errors(true, false, "Overrun");
+
+        read_frame(3);
+        check_empty("Overrun frame dropped");
+
+        -- Capture carries on once a bank is free
+        write_frame(5);
+        commit;
+        read_frame(5);
+        check_empty("Empty after overrun");
+        check_errors(false, false, "After overrun");
+
+        -- A frame larger than a bank is dropped
+        write_frame(6, G_SIZE + 1);
+        commit;
+        check_empty("Oversized frame dropped");
+        check_errors(true, false, "Oversized frame");
+
+        -- Reading an empty buffer
+        r_rd <= '1';
+        wait_clk(1);
+        r_rd <= '0';
+        wait_clk(2);
+        check_errors(false, true, "Underflow");
+
+        -- Clear discards the committed frames and the one being captured
+        write_frame(7);
+        commit;
+        write_frame(8, c_len / 2);
+
+        r_clear <= '1';
+        wait_clk(1);
+        r_clear <= '0';
+        wait_clk(6);
+        check_empty("Empty after clear");
+
+        write_frame(9);
+        commit;
+        read_frame(9);
+        check_empty("Empty after clear and read");
+        check_errors(false, false, "Clear");
+
+        -- End simulation
+        ------------------------------------------------------------------------
+        log(ID_LOG_HDR, "End simulation frame buffer", c_scope);
+        wait for 1 us;
+        report_alert_counters(FINAL);
+
+        wait for 1000 ns;
+        stop;
+    end process p_main;
+
+end architecture bhv;
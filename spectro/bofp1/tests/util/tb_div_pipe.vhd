@@ -0,0 +1,188 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use ieee.math_real.all;
+use std.env.stop;
+
+library uvvm_util;
+context uvvm_util.uvvm_util_context;
+
+entity tb_div_pipe is
+    generic (
+        G_WIDTH: integer := 24;
+        G_DIV_WIDTH: integer := 8
+    );
+end entity tb_div_pipe;
+
+architecture bhv of tb_div_pipe is
+    constant c_latency: integer := 3;
+    -- Cycles to compute the reciprocal of a new divisor
+    constant c_recip_cycles: integer := G_WIDTH + G_DIV_WIDTH + 3;
+
+    type t_divisors is array(natural range <>) of natural;
+    constant c_divisors: t_divisors := (1, 2, 3, 7, 10, 31, 64, 129, 255);
+
+    signal r_clk: std_logic;
+    signal r_clkena: boolean;
+    signal r_rst_n: std_logic := '0';
+
+    signal r_divisor: std_logic_vector(G_DIV_WIDTH-1 downto 0) :=
+        (others => '0');
+    signal r_rdy: std_logic := '0';
+    signal r_data: std_logic_vector(G_WIDTH-1 downto 0) := (others => '0');
+    signal r_out_rdy: std_logic;
+    signal r_out_data: std_logic_vector(G_WIDTH-1 downto 0);
+    signal r_busy: std_logic;
+
+    -- Dividends in flight, checked in order as the quotients come out
+    type t_queue is array(0 to 255) of natural;
+    signal r_queue: t_queue;
+    signal r_head: natural := 0;
+    signal r_tail: natural := 0;
+    signal r_checked: natural := 0;
+    signal r_divisor_int: natural := 1;
+
+    constant c_scope: string := C_TB_SCOPE_DEFAULT;
+    constant c_clk_period: time := 10 ns;
+begin
+    clock_generator(r_clk, r_clkena, c_clk_period, "Main");
+
+    u_div: entity work.div_pipe(rtl)
+        generic map(
+            G_WIDTH => G_WIDTH,
+            G_DIV_WIDTH => G_DIV_WIDTH
+        )
+        port map(
+            i_clk => r_clk,
+            i_rst_n => r_rst_n,
+            i_divisor => r_divisor,
+            i_rdy => r_rdy,
+            i_data => r_data,
+            o_rdy => r_out_rdy,
+            o_data => r_out_data,
+            o_busy => r_busy
+        );
+
+    -- Compare every quotient against the dividend it was computed from
+    p_check: process(r_clk)
+    begin
+        if rising_edge(r_clk) then
+            if r_rdy = '1' then
+                r_queue(r_tail mod r_queue'length) <=
+                    to_integer(unsigned(r_data));
+                r_tail <= r_tail + 1;
+            end if;
+
+            if r_out_rdy = '1' then
+                check_value(r_head < r_tail, ERROR, "Quotient was expected",
+                            c_scope);
+                check_value(to_integer(unsigned(r_out_data)),
+                            r_queue(r_head mod r_queue'length) /
+                            r_divisor_int, ERROR, "Quotient", c_scope);
+                r_head <= r_head + 1;
+                r_checked <= r_checked + 1;
+            end if;
+        end if;
+    end process p_check;
+
+    p_main: process
+        variable v_seed1: positive := 7;
+        variable v_seed2: positive := 11;
+        variable v_rand: real;
+        variable v_max: natural;
+        variable v_sent: natural;
+
+        procedure set_divisor(constant divisor: in natural) is
+        begin
+            r_divisor <= std_logic_vector(to_unsigned(divisor, G_DIV_WIDTH));
+            r_divisor_int <= maximum(divisor, 1);
+            wait for c_recip_cycles * c_clk_period;
+        end procedure set_divisor;
+
+        procedure send(constant dividend: in natural) is
+        begin
+            r_rdy <= '1';
+            r_data <= std_logic_vector(to_unsigned(dividend, G_WIDTH));
+            wait until rising_edge(r_clk);
+            r_rdy <= '0';
+        end procedure send;
+    begin
+        report_global_ctrl(VOID);
+        report_msg_id_panel(VOID);
+        enable_log_msg(ALL_MESSAGES);
+
+        log(ID_LOG_HDR, "Simulation setup", c_scope);
+        r_clkena <= true;
+        wait for 10 * c_clk_period;
+        r_rst_n <= '1';
+        wait until rising_edge(r_clk);
+
+        log(ID_LOG_HDR, "Start simulation pipelined divider", c_scope);
+        ------------------------------------------------------------------------
+        v_max := 2**G_WIDTH - 1;
+
+        -- Latency of a single division
+        set_divisor(3);
+        wait until rising_edge(r_clk);
+        send(300);
+        wait for 1 ps;
+        for i in 1 to c_latency - 1 loop
+            check_value(r_out_rdy, '0', ERROR, "Not ready before latency",
+                        c_scope);
+            check_value(r_busy, '1', ERROR, "Busy while in flight", c_scope);
+            wait for c_clk_period;
+        end loop;
+        check_value(r_out_rdy, '1', ERROR, "Ready after latency", c_scope);
+        check_value(to_integer(unsigned(r_out_data)), 100, ERROR,
+                    "Single quotient", c_scope);
+        wait for c_clk_period;
+        check_value(r_out_rdy, '0', ERROR, "Ready for one cycle", c_scope);
+        check_value(r_busy, '0', ERROR, "Idle when drained", c_scope);
+
+        -- A dividend every cycle, including the edges of the range
+        for d in c_divisors'range loop
+            wait until rising_edge(r_clk);
+            set_divisor(c_divisors(d));
+            wait until rising_edge(r_clk);
+
+            send(0);
+            send(1);
+            send(c_divisors(d) - 1);
+            send(c_divisors(d));
+            send(c_divisors(d) + 1);
+            send(v_max);
+            send(v_max - 1);
+
+            for i in 0 to 63 loop
+                uniform(v_seed1, v_seed2, v_rand);
+                send(integer(v_rand * real(v_max)));
+            end loop;
+
+            wait for (c_latency + 1) * c_clk_period;
+            check_value(r_head, r_tail, ERROR,
+                        "All quotients out for divisor " &
+                        to_string(c_divisors(d)), c_scope);
+        end loop;
+
+        -- Zero divides by one
+        wait until rising_edge(r_clk);
+        set_divisor(0);
+        wait until rising_edge(r_clk);
+        send(v_max);
+        send(12345);
+        wait for (c_latency + 1) * c_clk_period;
+
+        v_sent := r_tail;
+        check_value(r_checked, v_sent, ERROR, "Every quotient checked",
+                    c_scope);
+
+        -- End simulation
+        ------------------------------------------------------------------------
+        log(ID_LOG_HDR, "End simulation pipelined divider", c_scope);
+        wait for 1 us;
+        report_alert_counters(FINAL);
+
+        wait for 1000 ns;
+        stop;
+    end process p_main;
+end architecture bhv;
@@ -13,100 +13,271 @@
 
 LOG_MODULE_REGISTER(spectro, LOG_LEVEL_DBG);
 
-static uint16_t spectro_buf[3694];
+/* Room for the driver header and a full frame, and the raw frame of a dual
+ * readout */
+#define SPECTRO_BUF_SIZE                                                       \
+        ((3694 + (IS_ENABLED(CONFIG_SPECTRO_DUAL_READOUT) ? 3648 : 0)) *       \
+         sizeof(uint16_t))
+
+/* The RTIO memory pool takes power of two blocks, and a frame spans as many
+ * as it needs */
+#define SPECTRO_BLK_SIZE  (512)
+#define SPECTRO_BLK_COUNT                                                      \
+        (DIV_ROUND_UP(SPECTRO_BUF_SIZE, SPECTRO_BLK_SIZE) *                    \
+         CONFIG_SPECTRO_FRAME_POOL_SIZE)
+
+/* Poll period of the completion queue */
+#define SPECTRO_CQE_POLL_MS (1)
+/* Time for the frame in progress to complete a stopped stream */
+#define SPECTRO_STOP_TIMEOUT_MS (10000)
 
 static const struct device *dev = DEVICE_DT_GET(SPECTRO_DEV);
 
 SENSOR_DT_READ_IODEV(iodev, SPECTRO_DEV);
-RTIO_DEFINE(rtio_ctx, 1, 1);
+SENSOR_DT_STREAM_IODEV(stream_iodev, SPECTRO_DEV,
+                       {SENSOR_TRIG_DATA_READY, SENSOR_STREAM_DATA_INCLUDE});
+
+/* The frames are read into the memory pool, which is also the frame pool */
+RTIO_DEFINE_WITH_MEMPOOL(rtio_ctx, 2, 2, SPECTRO_BLK_COUNT, SPECTRO_BLK_SIZE,
+                         sizeof(uint32_t));
 
 struct spectro_q_entry {
         spectro_data_rdy_cb cb;
         void *user_arg;
+        /* Number of samples to acquire, 0 until stopped */
+        uint32_t count;
+        uint32_t period_us;
+        /* Stream generation the entry belongs to */
+        atomic_val_t gen;
+};
+
+struct spectro_frame {
+        /* Buffer from the memory pool, released once the frame is read */
+        uint8_t *buf;
+        uint32_t buf_len;
+        struct sensor_decode_context ctx;
+        uint32_t seq;
+        /* Stream generation the frame was acquired for */
+        atomic_val_t gen;
 };
 
 static const enum sensor_channel channel =
         (enum sensor_channel)SENSOR_CHAN_BOFP1_INTENSITY;
-static struct sensor_decode_context decode_ctx =
-        SENSOR_DECODE_CONTEXT_INIT(NULL, (uint8_t *)spectro_buf, channel, 0);
+static const enum sensor_channel stream_channel =
+        (enum sensor_channel)SENSOR_CHAN_BOFP1_INTENSITY_U16;
+static const struct sensor_chan_spec raw_channel = {
+        .chan_type = (enum sensor_channel)SENSOR_CHAN_BOFP1_INTENSITY_U16,
+        .chan_idx = 1,
+};
+static const struct sensor_chan_spec meta_channel = {
+        .chan_type = (enum sensor_channel)SENSOR_CHAN_BOFP1_META,
+        .chan_idx = 0,
+};
 
+/* Frames shared between the acquisition thread, which is the only producer,
+ * and the stream reader, which is the only consumer. The indices are
+ * free-running, and each is only written by its owner. Every frame holds a
+ * buffer of the memory pool, which is sized for as many frames. */
+static struct spectro_frame frames[CONFIG_SPECTRO_FRAME_POOL_SIZE];
+static atomic_t frames_head;
+static atomic_t frames_tail;
+static atomic_t frames_overflow;
+static uint32_t frames_seq;
+
+/* Incremented to stop the current burst and discard queued requests */
+static atomic_t stream_gen;
+
+/* Tags the reads of an acquisition request, to tell their completions from
+ * those of an earlier request */
+static uintptr_t aq_tag;
+
+/* Wakes the acquisition thread when a frame is released or the stream is
+ * stopped */
+K_SEM_DEFINE(aq_wake, 0, 1);
+
+/* Serializes single reads with changes to the sensor settings. A stream
+ * takes changed settings from the next frame. */
 K_MUTEX_DEFINE(lock);
 
-K_MSGQ_DEFINE(msgq, sizeof(struct spectro_q_entry), 2, 1);
+K_MSGQ_DEFINE(msgq, sizeof(struct spectro_q_entry),
+              CONFIG_SPECTRO_FRAME_POOL_SIZE, 1);
 
-/** @brief Converts the scale from Q format */
-static uint16_t convert_scale(q31_t q, uint8_t shift)
+/* Pixels are decoded in CPU byte order, directly into the USB buffer */
+BUILD_ASSERT(!IS_ENABLED(CONFIG_BIG_ENDIAN), "host expects little endian");
+
+static uint32_t frames_ready(void)
 {
-        return (uint16_t)(((int64_t)q << shift) / (1ULL << 31));
+        return (uint32_t)atomic_get(&frames_head) -
+               (uint32_t)atomic_get(&frames_tail);
 }
 
-int spectro_stream_read(void *buf_arg, size_t size_arg, size_t *real_size)
+static int spectro_frame_header(struct spectro_frame *frame,
+                                struct spectro_frame_header *hdr)
 {
         int status;
-        uint8_t *buf;
-        uint16_t frames;
-        size_t size;
-        size_t base_size;
-        size_t frame_size;
-        uint16_t value;
-        struct sensor_q31_data data;
+        uint32_t fit = 0;
+        uint16_t raw_count;
+        struct bofp1_frame_meta meta;
 
-        buf = buf_arg;
-        size = size_arg;
+        status = frame->ctx.decoder->decode(frame->buf, meta_channel, &fit, 1,
+                                            &meta);
+        if (status < 0) {
+                return status;
+        }
 
-        (void)k_mutex_lock(&lock, K_FOREVER);
+        status = frame->ctx.decoder->get_frame_count(frame->buf, raw_channel,
+                                                     &raw_count);
+        if (status != 0) {
+                return status;
+        }
 
-        __ASSERT_NO_MSG(decode_ctx.decoder != NULL);
+        hdr->magic = sys_cpu_to_le16(SPECTRO_FRAME_MAGIC);
+        hdr->version = SPECTRO_FRAME_VERSION;
+        hdr->size = sizeof(*hdr);
+        hdr->seq = sys_cpu_to_le32(frame->seq);
+        hdr->timestamp = sys_cpu_to_le64(meta.timestamp);
+        hdr->int_time = sys_cpu_to_le32(meta.integration_time / 1000);
+        hdr->pixels = sys_cpu_to_le16(meta.pixels);
+        hdr->offset = sys_cpu_to_le16(meta.offset);
+        hdr->bin = sys_cpu_to_le16(meta.bin);
+        hdr->raw_pixels = sys_cpu_to_le16(raw_count);
+        hdr->status = meta.status;
+        hdr->flags = 0;
+
+        if (meta.flags & BOFP1_META_DC) {
+                hdr->flags |= SPECTRO_FRAME_FLAG_DC;
+        }
+        if (meta.flags & BOFP1_META_MOVAVG) {
+                hdr->flags |= SPECTRO_FRAME_FLAG_MOVAVG;
+        }
+        if (meta.flags & BOFP1_META_TOTAVG) {
+                hdr->flags |= SPECTRO_FRAME_FLAG_TOTAVG;
+        }
+        if (meta.flags & BOFP1_META_BIN_SUM) {
+                hdr->flags |= SPECTRO_FRAME_FLAG_BIN_SUM;
+        }
 
-        status = decode_ctx.decoder->get_frame_count(
-                decode_ctx.buffer, decode_ctx.channel, &frames);
-        if (status != 0) {
-                goto exit;
+        return 0;
+}
+
+/**
+ * @brief Drop the frames acquired before the stream was stopped
+ *
+ * Done by the stream reader, as it owns the tail of the pool. This includes
+ * a frame that is partially read.
+ */
+static void spectro_drop_stopped(void)
+{
+        struct spectro_frame *frame;
+
+        while (frames_ready() > 0) {
+                frame = &frames[atomic_get(&frames_tail) %
+                                CONFIG_SPECTRO_FRAME_POOL_SIZE];
+                if (frame->gen == atomic_get(&stream_gen)) {
+                        break;
+                }
+
+                LOG_DBG("dropped frame %" PRIu32 " of a stopped stream",
+                        frame->seq);
+
+                rtio_release_buffer(&rtio_ctx, frame->buf, frame->buf_len);
+                (void)atomic_inc(&frames_tail);
+                k_sem_give(&aq_wake);
+        }
+}
+
+int spectro_stream_read(void *buf, size_t size, size_t *real_size)
+{
+        int status;
+        uint16_t count;
+        size_t offset = 0;
+        struct spectro_frame *frame;
+
+        spectro_drop_stopped();
+
+        if (frames_ready() == 0) {
+                return -ENODATA;
         }
 
-        status = decode_ctx.decoder->get_size_info(decode_ctx.channel,
-                                                   &base_size, &frame_size);
+        frame = &frames[atomic_get(&frames_tail) %
+                        CONFIG_SPECTRO_FRAME_POOL_SIZE];
+
+        __ASSERT_NO_MSG(frame->ctx.decoder != NULL);
+
+        status = frame->ctx.decoder->get_frame_count(
+                frame->ctx.buffer, frame->ctx.channel, &count);
         if (status != 0) {
                 goto exit;
         }
 
-        while (size >= sizeof(uint16_t) && decode_ctx.fit < frames) {
-                status = sensor_decode(&decode_ctx, &data, 1);
-                if (status <= 0) {
-                        /* Checking if empty in the loop condition, so this
-                         * should not return 0. */
-                        if (status == 0) {
-                                status = -ENODATA;
-                        }
+        /* Prefix the first chunk of a sample with the header */
+        if (frame->ctx.channel.chan_idx == 0 && frame->ctx.fit == 0) {
+                if (size < sizeof(struct spectro_frame_header) +
+                                   sizeof(uint16_t)) {
+                        return -ENOBUFS;
+                }
+
+                status = spectro_frame_header(frame, buf);
+                if (status != 0) {
                         goto exit;
                 }
 
-                value = convert_scale(data.readings[0].value, data.shift);
-                sys_put_le16(value, buf);
+                offset = sizeof(struct spectro_frame_header);
+        }
 
-                size -= sizeof(uint16_t);
-                buf += sizeof(uint16_t);
+        status = sensor_decode(
+                &frame->ctx, (uint8_t *)buf + offset,
+                MIN((size - offset) / sizeof(uint16_t), UINT16_MAX));
+        if (status < 0) {
+                goto exit;
         }
 
-        *real_size = size_arg - size;
+        *real_size = offset + status * sizeof(uint16_t);
 
 exit:
-        (void)k_mutex_unlock(&lock);
-
         if (status < 0) {
                 LOG_WRN("TODO: decode");
                 status = 0;
                 return status;
         }
 
-        return decode_ctx.fit < frames;
+        if (frame->ctx.fit < count) {
+                return 1;
+        }
+
+        /* The raw frame of a dual readout follows the processed frame */
+        if (frame->ctx.channel.chan_idx == 0) {
+                status = frame->ctx.decoder->get_frame_count(
+                        frame->ctx.buffer, raw_channel, &count);
+                if (status == 0 && count > 0) {
+                        frame->ctx.channel = raw_channel;
+                        frame->ctx.fit = 0;
+                        return 1;
+                }
+        }
+
+        /* Frame is fully read, hand it back to the acquisition thread */
+        rtio_release_buffer(&rtio_ctx, frame->buf, frame->buf_len);
+        (void)atomic_inc(&frames_tail);
+        k_sem_give(&aq_wake);
+
+        return frames_ready() > 0 ? 2 : 0;
 }
 
 int spectro_sample(spectro_data_rdy_cb cb, void *user_arg)
+{
+        return spectro_stream_start(1, 0, cb, user_arg);
+}
+
+int spectro_stream_start(uint32_t count, uint32_t period_us,
+                         spectro_data_rdy_cb cb, void *user_arg)
 {
         struct spectro_q_entry entry = {
                 .cb = cb,
                 .user_arg = user_arg,
+                .count = count,
+                .period_us = period_us,
+                .gen = atomic_get(&stream_gen),
         };
 
         if (!device_is_ready(dev)) {
@@ -117,6 +288,14 @@ int spectro_sample(spectro_data_rdy_cb cb, void *user_arg)
         return k_msgq_put(&msgq, &entry, K_NO_WAIT);
 }
 
+int spectro_stream_stop(void)
+{
+        (void)atomic_inc(&stream_gen);
+        k_sem_give(&aq_wake);
+
+        return 0;
+}
+
 uint32_t spectro_get_int_time(void)
 {
         struct sensor_value val;
@@ -145,6 +324,126 @@ int spectro_set_int_time(uint32_t int_us)
         return status;
 }
 
+uint16_t spectro_get_auto_exposure(void)
+{
+        struct sensor_value val;
+
+        (void)sensor_attr_get(
+                dev, channel,
+                (enum sensor_attribute)SENSOR_ATTR_BOFP1_AUTO_EXPOSURE, &val);
+
+        return val.val1;
+}
+
+int spectro_set_auto_exposure(uint16_t target)
+{
+        int status;
+        struct sensor_value val;
+
+        (void)k_mutex_lock(&lock, K_FOREVER);
+
+        val.val1 = target;
+        status = sensor_attr_set(
+                dev, channel,
+                (enum sensor_attribute)SENSOR_ATTR_BOFP1_AUTO_EXPOSURE, &val);
+
+        (void)k_mutex_unlock(&lock);
+
+        return status;
+}
+
+void spectro_get_roi(uint16_t *start, uint16_t *len)
+{
+        struct sensor_value val;
+
+        (void)sensor_attr_get(dev, channel,
+                              (enum sensor_attribute)SENSOR_ATTR_BOFP1_ROI,
+                              &val);
+
+        *start = val.val1;
+        *len = val.val2;
+}
+
+int spectro_set_roi(uint16_t start, uint16_t len)
+{
+        int status;
+        struct sensor_value val;
+
+        (void)k_mutex_lock(&lock, K_FOREVER);
+
+        val.val1 = start;
+        val.val2 = len;
+        status = sensor_attr_set(dev, channel,
+                                 (enum sensor_attribute)SENSOR_ATTR_BOFP1_ROI,
+                                 &val);
+
+        (void)k_mutex_unlock(&lock);
+
+        return status;
+}
+
+void spectro_get_bin(uint8_t *factor, bool *sum)
+{
+        struct sensor_value val;
+
+        (void)sensor_attr_get(dev, channel,
+                              (enum sensor_attribute)SENSOR_ATTR_BOFP1_BIN,
+                              &val);
+
+        *factor = val.val1;
+        *sum = val.val2 != 0;
+}
+
+int spectro_set_bin(uint8_t factor, bool sum)
+{
+        int status;
+        struct sensor_value val;
+
+        (void)k_mutex_lock(&lock, K_FOREVER);
+
+        val.val1 = factor;
+        val.val2 = sum;
+        status = sensor_attr_set(dev, channel,
+                                 (enum sensor_attribute)SENSOR_ATTR_BOFP1_BIN,
+                                 &val);
+
+        (void)k_mutex_unlock(&lock);
+
+        return status;
+}
+
+bool spectro_get_dual_readout(void)
+{
+        struct sensor_value val;
+
+        (void)sensor_attr_get(
+                dev, channel,
+                (enum sensor_attribute)SENSOR_ATTR_BOFP1_DUAL_READOUT, &val);
+
+        return val.val1 != 0;
+}
+
+int spectro_set_dual_readout(bool dual)
+{
+        int status;
+        struct sensor_value val;
+
+        if (dual && !IS_ENABLED(CONFIG_SPECTRO_DUAL_READOUT)) {
+                return -ENOTSUP;
+        }
+
+        (void)k_mutex_lock(&lock, K_FOREVER);
+
+        val.val1 = dual;
+        status = sensor_attr_set(
+                dev, channel,
+                (enum sensor_attribute)SENSOR_ATTR_BOFP1_DUAL_READOUT, &val);
+
+        (void)k_mutex_unlock(&lock);
+
+        return status;
+}
+
 int spectro_set_pipeline_ctrl(uint8_t dc, uint8_t totavg, uint8_t movavg)
 {
         int status;
@@ -210,34 +509,274 @@ int spectro_set_total_avg_n(uint8_t n)
         return status;
 }
 
+int spectro_dc_invalidate(void)
+{
+        struct sensor_value val = {0};
+
+        return sensor_attr_set(
+                dev, channel,
+                (enum sensor_attribute)SENSOR_ATTR_BOFP1_DC_INVALIDATE, &val);
+}
+
+uint32_t spectro_get_overflow(void)
+{
+        return atomic_get(&frames_overflow);
+}
+
+int spectro_get_phase_stats(enum bofp1_phase phase,
+                            struct bofp1_phase_stats *stats)
+{
+        return bofp1_get_phase_stats(dev, phase, stats);
+}
+
+int spectro_reset_phase_stats(void)
+{
+        return bofp1_reset_phase_stats(dev);
+}
+
+static bool spectro_stream_active(const struct spectro_q_entry *entry)
+{
+        return entry->gen == atomic_get(&stream_gen);
+}
+
+/** @brief Wait until @p next, or until the stream is stopped */
+static void spectro_wait_until(const struct spectro_q_entry *entry,
+                               k_timepoint_t next)
+{
+        while (spectro_stream_active(entry) && !sys_timepoint_expired(next)) {
+                (void)k_sem_take(&aq_wake, sys_timepoint_timeout(next));
+        }
+}
+
+/**
+ * @brief Take a completion of the current acquisition request
+ *
+ * Waits for up to a poll period, or until the acquisition thread is woken.
+ * Completions of an earlier request, such as the last frame of a stream
+ * that was given up on, are dropped along with their buffer.
+ *
+ * @param buf Buffer of the frame, NULL if none
+ * @param buf_len
+ * @return int
+ * @retval >=0 Result of the read
+ * @retval -EAGAIN No completion of this request yet
+ * @retval <0 Read failed
+ */
+static int spectro_cqe_poll(uint8_t **buf, uint32_t *buf_len)
+{
+        int result;
+        struct rtio_cqe *cqe;
+
+        *buf = NULL;
+        *buf_len = 0;
+
+        cqe = rtio_cqe_consume(&rtio_ctx);
+        if (cqe == NULL) {
+                (void)k_sem_take(&aq_wake, K_MSEC(SPECTRO_CQE_POLL_MS));
+                return -EAGAIN;
+        }
+
+        result = cqe->result;
+        (void)rtio_cqe_get_mempool_buffer(&rtio_ctx, cqe, buf, buf_len);
+
+        if (cqe->userdata != (void *)aq_tag) {
+                LOG_DBG("dropped completion of an earlier request");
+
+                if (*buf != NULL) {
+                        rtio_release_buffer(&rtio_ctx, *buf, *buf_len);
+                        *buf = NULL;
+                }
+
+                result = -EAGAIN;
+        }
+
+        rtio_cqe_release(&rtio_ctx, cqe);
+
+        return result;
+}
+
+/** @brief Hand a frame read into @p buf to the stream reader */
+static void spectro_publish(const struct spectro_q_entry *entry, uint32_t seq,
+                            uint8_t *buf, uint32_t buf_len)
+{
+        struct spectro_frame *frame;
+
+        /* Every frame holds a buffer of the pool, so there is always room */
+        __ASSERT_NO_MSG(frames_ready() < CONFIG_SPECTRO_FRAME_POOL_SIZE);
+
+        frame = &frames[atomic_get(&frames_head) %
+                        CONFIG_SPECTRO_FRAME_POOL_SIZE];
+        frame->buf = buf;
+        frame->buf_len = buf_len;
+        /* Reset frame iterator */
+        frame->ctx.buffer = buf;
+        frame->ctx.channel.chan_idx = 0;
+        frame->ctx.fit = 0;
+        frame->seq = seq;
+        frame->gen = entry->gen;
+
+        /* Publish the frame to the stream reader */
+        (void)atomic_inc(&frames_head);
+
+        entry->cb(entry->user_arg);
+}
+
+/** @brief Acquire a single sample into the next free frame of the pool */
+static int spectro_acquire(const struct spectro_q_entry *entry)
+{
+        int status;
+        uint32_t seq;
+        uint8_t *buf = NULL;
+        uint32_t buf_len = 0;
+
+        /* Every sample gets a sequence number, so that the host can detect
+         * dropped samples. */
+        seq = frames_seq++;
+
+        if (frames_ready() >= CONFIG_SPECTRO_FRAME_POOL_SIZE) {
+                LOG_WRN("frame pool full; sample dropped");
+                (void)atomic_inc(&frames_overflow);
+                return -ENOBUFS;
+        }
+
+        (void)k_mutex_lock(&lock, K_FOREVER);
+
+        status = sensor_read_async_mempool(&iodev, &rtio_ctx, (void *)aq_tag);
+        if (status == 0) {
+                do {
+                        status = spectro_cqe_poll(&buf, &buf_len);
+                } while (status == -EAGAIN);
+        }
+
+        (void)k_mutex_unlock(&lock);
+
+        if (status < 0) {
+                LOG_ERR("read failed: %i", status);
+
+                if (buf != NULL) {
+                        rtio_release_buffer(&rtio_ctx, buf, buf_len);
+                }
+
+                return status;
+        }
+
+        spectro_publish(entry, seq, buf, buf_len);
+
+        LOG_DBG("sample completed");
+
+        return 0;
+}
+
+/**
+ * @brief Acquire a free-running burst as a sensor stream
+ *
+ * The sensor starts every frame as soon as the previous one is read out,
+ * without flushing in between, and keeps the light on for the whole burst.
+ * When the stream reader holds all the frames, the sensor waits for one to
+ * be released, so samples are throttled by the host rather than dropped.
+ */
+static void spectro_stream(const struct spectro_q_entry *entry)
+{
+        int status;
+        struct rtio_sqe *handle;
+        k_timepoint_t end = sys_timepoint_calc(K_FOREVER);
+        bool stopping = false;
+        uint32_t count = 0;
+        uint8_t *buf;
+        uint32_t buf_len;
+
+        status = sensor_stream(&stream_iodev, &rtio_ctx, (void *)aq_tag,
+                               &handle);
+        if (status != 0) {
+                LOG_ERR("stream failed: %i", status);
+                return;
+        }
+
+        for (;;) {
+                if (!stopping &&
+                    (!spectro_stream_active(entry) ||
+                     (entry->count != 0 && count >= entry->count))) {
+                        /* Ends with the frame in progress */
+                        (void)rtio_sqe_cancel(handle);
+
+                        stopping = true;
+                        end = sys_timepoint_calc(
+                                K_MSEC(SPECTRO_STOP_TIMEOUT_MS));
+                }
+
+                status = spectro_cqe_poll(&buf, &buf_len);
+                if (status == -EAGAIN) {
+                        if (sys_timepoint_expired(end)) {
+                                LOG_WRN("stream did not complete");
+                                return;
+                        }
+
+                        continue;
+                }
+
+                if (status < 0 || stopping) {
+                        if (buf != NULL) {
+                                rtio_release_buffer(&rtio_ctx, buf, buf_len);
+                        }
+
+                        if (status < 0) {
+                                LOG_ERR("stream read failed: %i", status);
+                                (void)rtio_sqe_cancel(handle);
+                        }
+
+                        return;
+                }
+
+                spectro_publish(entry, frames_seq++, buf, buf_len);
+                count++;
+        }
+}
+
 static void aq_thread(void *p1, void *p2, void *p3)
 {
         int status;
         struct spectro_q_entry entry;
+        const struct sensor_decoder_api *decoder;
+        k_timepoint_t next;
 
-        for (;;) {
-                (void)k_msgq_get(&msgq, &entry, K_FOREVER);
-                LOG_DBG("acquiring sample");
+        status = sensor_get_decoder(dev, &decoder);
+        __ASSERT_NO_MSG(status == 0);
 
-                (void)k_mutex_lock(&lock, K_FOREVER);
+        for (size_t i = 0; i < ARRAY_SIZE(frames); i++) {
+                frames[i].ctx = (struct sensor_decode_context)
+                        SENSOR_DECODE_CONTEXT_INIT(decoder, NULL,
+                                                   stream_channel, 0);
+        }
 
-                status = sensor_get_decoder(dev, &decode_ctx.decoder);
-                __ASSERT_NO_MSG(status == 0);
+        for (;;) {
+                (void)k_msgq_get(&msgq, &entry, K_FOREVER);
+                LOG_DBG("acquiring %" PRIu32 " sample(s)", entry.count);
 
-                /* Reset frame iterator */
-                decode_ctx.fit = 0;
+                aq_tag++;
 
-                status = sensor_read(&iodev, &rtio_ctx, (uint8_t *)spectro_buf,
-                                     sizeof(spectro_buf));
-                (void)k_mutex_unlock(&lock);
+                /* A free-running burst is streamed, with the frames back to
+                 * back */
+                if (entry.count != 1 && entry.period_us == 0) {
+                        if (spectro_stream_active(&entry)) {
+                                spectro_stream(&entry);
+                        }
 
-                if (status != 0) {
-                        LOG_ERR("read failed: %i", status);
                         continue;
                 }
 
-                LOG_DBG("sample completed");
-                entry.cb(entry.user_arg);
+                for (uint32_t i = 0; entry.count == 0 || i < entry.count;
+                     i++) {
+                        if (!spectro_stream_active(&entry)) {
+                                LOG_DBG("stream stopped");
+                                break;
+                        }
+
+                        next = sys_timepoint_calc(K_USEC(entry.period_us));
+
+                        (void)spectro_acquire(&entry);
+
+                        spectro_wait_until(&entry, next);
+                }
         }
 }
 
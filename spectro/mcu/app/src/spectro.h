@@ -4,8 +4,54 @@
 
 #include <zephyr/kernel.h>
 
+#include <drivers/sensor/bofp1.h>
+
 typedef void (*spectro_data_rdy_cb)(void *user_arg);
 
+#define SPECTRO_FRAME_MAGIC   (0xb0f1)
+#define SPECTRO_FRAME_VERSION (4)
+
+/* Pipeline stages enabled for a frame, same layout as the pipeline control
+ * request */
+#define SPECTRO_FRAME_FLAG_DC      BIT(0)
+#define SPECTRO_FRAME_FLAG_MOVAVG  BIT(1)
+#define SPECTRO_FRAME_FLAG_TOTAVG  BIT(2)
+/* Pixels of a bin are summed rather than averaged */
+#define SPECTRO_FRAME_FLAG_BIN_SUM BIT(3)
+
+/**
+ * @brief Header preceding every sample in the stream
+ *
+ * All fields are little endian.
+ */
+struct spectro_frame_header {
+        /* SPECTRO_FRAME_MAGIC */
+        uint16_t magic;
+        /* SPECTRO_FRAME_VERSION */
+        uint8_t version;
+        /* Size of this header in bytes */
+        uint8_t size;
+        /* Incremented for every sample, including dropped ones */
+        uint32_t seq;
+        /* Time the sample was started (ns since boot, in system ticks) */
+        uint64_t timestamp;
+        /* Integration time (us) */
+        uint32_t int_time;
+        /* Number of 16 bit pixels following the header */
+        uint16_t pixels;
+        /* SPECTRO_FRAME_FLAG_* */
+        uint8_t flags;
+        /* Error bits of the FPGA status register */
+        uint8_t status;
+        /* Index of the first pixel, non-zero with a region of interest */
+        uint16_t offset;
+        /* Number of CCD elements per pixel */
+        uint16_t bin;
+        /* Number of 16 bit raw pixels following the processed pixels, with
+         * a dual readout */
+        uint16_t raw_pixels;
+} __packed;
+
 /**
  * @brief Sample from the spectrometer
  *
@@ -16,18 +62,87 @@ typedef void (*spectro_data_rdy_cb)(void *user_arg);
 int spectro_sample(spectro_data_rdy_cb cb, void *user_arg);
 
 /**
- * @brief Read a chunk of the most recent sample into @p buf
+ * @brief Acquire a burst of samples from the spectrometer
+ *
+ * @p cb is invoked for every sample that is ready. With a @p period_us of 0,
+ * the samples are streamed back to back by the sensor, and acquisition waits
+ * for the stream reader to release a frame instead of dropping samples.
+ * Otherwise, every sample is a single read, dropped when no frame is free.
+ * A @p count of 1 is a single read.
+ *
+ * @param count Number of samples, or 0 to acquire until stopped
+ * @param period_us Time between the start of two samples, or 0 to acquire
+ *                  as fast as possible
+ * @param cb Callback to be invoked when data is ready
+ * @param user_arg Argument passed to callback
+ * @return int
+ * @retval 0 Success
+ * @retval <0 Negative errno code
+ */
+int spectro_stream_start(uint32_t count, uint32_t period_us,
+                         spectro_data_rdy_cb cb, void *user_arg);
+
+/**
+ * @brief Stop the burst in progress and discard queued samples
+ *
+ * Samples already acquired, but not yet read, are dropped by the stream
+ * reader, so that the next sample read is one requested after the stop.
+ *
+ * @return int
+ * @retval 0 Success
+ * @retval <0 Negative errno code
+ */
+int spectro_stream_stop(void);
+
+/**
+ * @brief Read a chunk of the oldest unread sample into @p buf
+ *
+ * The first chunk of a sample starts with a struct spectro_frame_header,
+ * followed by the pixels. A chunk never spans two samples. Once a sample is
+ * fully read, its buffer is released for a new acquisition.
  *
  * @param buf
  * @param size
  * @param real_size Actual size read into @p buf
  * @return int
  * @retval 0 Readout complete
- * @retval 1 More data available
+ * @retval 1 More data available in this sample
+ * @retval 2 Sample complete, more samples available
+ * @retval -ENODATA No sample available
+ * @retval -ENOBUFS @p buf too small for the header
  * @retval <0 Error occured
  */
 int spectro_stream_read(void *buf, size_t size, size_t *real_size);
 
+/**
+ * @brief Get number of samples dropped because the frame pool was full
+ *
+ * @return uint32_t
+ */
+uint32_t spectro_get_overflow(void);
+
+/**
+ * @brief Get latency statistics of a readout phase of the sensor
+ *
+ * @param phase
+ * @param stats
+ * @return int
+ * @retval 0 Success
+ * @retval -ENOTSUP Statistics not enabled
+ * @retval <0 Negative errno code
+ */
+int spectro_get_phase_stats(enum bofp1_phase phase,
+                            struct bofp1_phase_stats *stats);
+
+/**
+ * @brief Reset latency statistics of the sensor
+ *
+ * @return int
+ * @retval 0 Success
+ * @retval -ENOTSUP Statistics not enabled
+ */
+int spectro_reset_phase_stats(void);
+
 /**
  * @brief Get current integration time
  *
@@ -45,6 +160,91 @@ uint32_t spectro_get_int_time(void);
  */
 int spectro_set_int_time(uint32_t int_us);
 
+/**
+ * @brief Get target peak of the auto exposure
+ *
+ * @return uint16_t Target peak, 0 when disabled
+ */
+uint16_t spectro_get_auto_exposure(void);
+
+/**
+ * @brief Set target peak of the auto exposure
+ *
+ * The integration time is adjusted after every frame until the peak of the
+ * frame is close to @p target. The chosen integration time is reported in
+ * the frame header.
+ *
+ * @param target Target peak, 0 to disable and keep the integration time
+ * @return int
+ * @retval 0 Success
+ * @retval <0 Negative errno code
+ */
+int spectro_set_auto_exposure(uint16_t target);
+
+/**
+ * @brief Get region of interest
+ *
+ * @param start Index of the first pixel
+ * @param len Number of pixels, 0 for the entire frame
+ */
+void spectro_get_roi(uint16_t *start, uint16_t *len);
+
+/**
+ * @brief Set region of interest
+ *
+ * Only the pixels in the region of interest are read out and streamed.
+ *
+ * @param start Index of the first pixel
+ * @param len Number of pixels, 0 for the entire frame
+ * @return int
+ * @retval 0 Success
+ * @retval -EINVAL Region outside of the frame
+ * @retval <0 Negative errno code
+ */
+int spectro_set_roi(uint16_t start, uint16_t len);
+
+/**
+ * @brief Get pixel binning
+ *
+ * @param factor Number of CCD elements per pixel
+ * @param sum true if the elements are summed, false if averaged
+ */
+void spectro_get_bin(uint8_t *factor, bool *sum);
+
+/**
+ * @brief Set pixel binning
+ *
+ * @param factor Number of CCD elements per pixel, 1, 2, 4 or 8. 1 disables
+ *               binning
+ * @param sum true to sum the elements, false to average them
+ * @return int
+ * @retval 0 Success
+ * @retval -EINVAL Invalid factor
+ * @retval <0 Negative errno code
+ */
+int spectro_set_bin(uint8_t factor, bool sum);
+
+/**
+ * @brief Check if the raw frame is read along with the processed frame
+ *
+ * @return bool true if dual readout is enabled
+ */
+bool spectro_get_dual_readout(void);
+
+/**
+ * @brief Read the raw frame along with the processed frame
+ *
+ * Both frames are from the same exposure, and the raw frame is streamed
+ * after the processed frame.
+ *
+ * @param dual true to enable dual readout
+ * @return int
+ * @retval 0 Success
+ * @retval -ENOTSUP Frame buffers too small, or total average enabled
+ * @retval <0 Negative errno code
+ */
+int spectro_set_dual_readout(bool dual);
+
 /**
  * @brief Set ctrl parameters for pipeline
  *
@@ -80,4 +280,13 @@ int spectro_set_moving_avg_n(uint8_t n);
  */
 int spectro_set_total_avg_n(uint8_t n);
 
+/**
+ * @brief Force a dark current calibration on the next sample
+ *
+ * @return int
+ * @retval 0 Success
+ * @retval <0 Negative errno code
+ */
+int spectro_dc_invalidate(void);
+
 #endif /* SPECTRO_H__ */
@@ -16,28 +16,45 @@ LOG_MODULE_REGISTER(bomc1_usb);
 #define BOMC1_VRQ_SPECTRO_PL_CTRL  (0x3) /* Pipeline control */
 #define BOMC1_VRQ_SPECTRO_MOVAVG_N (0x4) /* Moving average N */
 #define BOMC1_VRQ_SPECTRO_TOTAVG_N (0x5) /* Total average N */
+#define BOMC1_VRQ_SPECTRO_DC_CALIB (0x6) /* Recalibrate dark current */
+#define BOMC1_VRQ_SPECTRO_OVERFLOW (0x7) /* Dropped sample count */
+#define BOMC1_VRQ_SPECTRO_STREAM   (0x8) /* Begin burst of CCD reads */
+#define BOMC1_VRQ_SPECTRO_STOP     (0x9) /* Stop burst of CCD reads */
+#define BOMC1_VRQ_SPECTRO_STATS    (0xa) /* Phase latency statistics */
+#define BOMC1_VRQ_SPECTRO_AUTO_EXP (0xb) /* Auto exposure target peak */
+#define BOMC1_VRQ_SPECTRO_ROI      (0xc) /* Region of interest */
+#define BOMC1_VRQ_SPECTRO_BIN      (0xd) /* Pixel binning */
+#define BOMC1_VRQ_SPECTRO_DUAL     (0xe) /* Dual raw and processed readout */
 
 #define BOMC1_PL_CTRL_DC     (0)
 #define BOMC1_PL_CTRL_MOVAVG (1)
 #define BOMC1_PL_CTRL_TOTAVG (2)
 
 #define BOMC1_TX_ENABLED (0)
-#define BOMC1_TX_BUSY    (1)
-#define BOMC1_TX_MORE    (2)
+
+/* The bulk IN buffers share the UDC pool with the control transfers */
+BUILD_ASSERT(CONFIG_BOMC1_USB_TX_BUF_SIZE * CONFIG_BOMC1_USB_TX_BUF_COUNT <
+                     CONFIG_UDC_BUF_POOL_SIZE,
+             "UDC_BUF_POOL_SIZE too small for the bulk IN buffers");
 
 struct bomc1_usb_desc {
         struct usb_association_descriptor iad;
         struct usb_if_descriptor if0;
         struct usb_ep_descriptor if0_in_ep;
+        struct usb_ep_descriptor if0_hs_in_ep;
         struct usb_desc_header nil_desc;
 };
 
 struct bomc1_usb_ctx {
         struct bomc1_usb_desc *desc;
-        const struct usb_desc_header **desc_list;
+        const struct usb_desc_header **fs_desc_list;
+        const struct usb_desc_header **hs_desc_list;
 
         atomic_t state;
 
+        /* Number of bulk IN buffers enqueued */
+        atomic_t tx_pending;
+
         struct k_work_delayable tx_work;
 
         struct k_work_q workq;
@@ -58,16 +75,23 @@ static int get_bulk_in(struct usbd_class_data *const c_data)
 
 static size_t get_bulk_mps(struct usbd_class_data *const c_data)
 {
+        struct usbd_context *usb_ctx = usbd_class_get_ctx(c_data);
         struct bomc1_usb_ctx *ctx = usbd_class_get_private(c_data);
 
+        if (usbd_bus_speed(usb_ctx) == USBD_SPEED_HS) {
+                return sys_le16_to_cpu(ctx->desc->if0_hs_in_ep.wMaxPacketSize);
+        }
+
         return sys_le16_to_cpu(ctx->desc->if0_in_ep.wMaxPacketSize);
 }
 
 static void tx_handler(struct k_work *work)
 {
         int status;
+        int more;
         int ep;
         size_t mps;
+        size_t size;
         size_t real_size;
         struct net_buf *buf;
         struct k_work_delayable *dwork = k_work_delayable_from_work(work);
@@ -80,46 +104,57 @@ static void tx_handler(struct k_work *work)
                 return;
         }
 
-        if (atomic_test_and_set_bit(&ctx->state, BOMC1_TX_BUSY)) {
-                return;
-        }
-
         ep = get_bulk_in(c_data);
+
+        /* The UDC splits each buffer into packets. Only the last buffer of a
+         * sample may end in a short packet, so all others must be a multiple
+         * of the max packet size. */
         mps = get_bulk_mps(c_data);
+        size = ROUND_DOWN(CONFIG_BOMC1_USB_TX_BUF_SIZE, mps);
 
-        buf = usbd_ep_buf_alloc(c_data, ep, mps);
-        if (buf == NULL) {
-                LOG_ERR("out of memory");
+        while (atomic_get(&ctx->tx_pending) < CONFIG_BOMC1_USB_TX_BUF_COUNT) {
+                buf = usbd_ep_buf_alloc(c_data, ep, size);
+                if (buf == NULL) {
+                        LOG_ERR("out of memory");
 
-                (void)k_work_schedule_for_queue(&ctx->workq, &ctx->tx_work,
-                                                K_MSEC(1));
-                return;
-        }
+                        (void)k_work_schedule_for_queue(
+                                &ctx->workq, &ctx->tx_work, K_MSEC(1));
+                        return;
+                }
 
-        status = spectro_stream_read(buf->data, buf->size, &real_size);
-        if (status < 0) {
-                LOG_ERR("read failed: %i", status);
+                more = spectro_stream_read(buf->data, size, &real_size);
+                if (more < 0) {
+                        if (more != -ENODATA) {
+                                LOG_ERR("read failed: %i", more);
+                        }
 
-                net_buf_unref(buf);
-                return;
-        }
+                        net_buf_unref(buf);
+                        return;
+                }
 
-        /* Add read size to the buffer */
-        net_buf_add(buf, real_size);
+                /* Add read size to the buffer */
+                net_buf_add(buf, real_size);
 
-        if (status > 0) {
-                atomic_set_bit(&ctx->state, BOMC1_TX_MORE);
-        } else {
-                atomic_clear_bit(&ctx->state, BOMC1_TX_MORE);
-        }
+                /* The host reads each sample into a buffer sized for the
+                 * largest one, so a sample must always end the transfer. */
+                if (more != 1 && real_size % mps == 0) {
+                        udc_ep_buf_set_zlp(buf);
+                }
 
-        status = usbd_ep_enqueue(c_data, buf);
-        if (status != 0) {
-                LOG_ERR("enqueue failed: %i", status);
+                (void)atomic_inc(&ctx->tx_pending);
 
-                net_buf_unref(buf);
-                atomic_clear_bit(&ctx->state, BOMC1_TX_MORE);
-                atomic_clear_bit(&ctx->state, BOMC1_TX_BUSY);
+                status = usbd_ep_enqueue(c_data, buf);
+                if (status != 0) {
+                        LOG_ERR("enqueue failed: %i", status);
+
+                        net_buf_unref(buf);
+                        (void)atomic_dec(&ctx->tx_pending);
+                        return;
+                }
+
+                if (more == 0) {
+                        return;
+                }
         }
 }
 
@@ -127,7 +162,7 @@ static void data_rdy_handler(void *user_arg)
 {
         struct bomc1_usb_ctx *ctx = user_arg;
 
-        (void)k_work_schedule_for_queue(&ctx->workq, &ctx->tx_work, K_TICKS(1));
+        (void)k_work_schedule_for_queue(&ctx->workq, &ctx->tx_work, K_NO_WAIT);
 }
 
 static int bomc1_usbd_request(struct usbd_class_data *const c_data,
@@ -150,12 +185,11 @@ static int bomc1_usbd_request(struct usbd_class_data *const c_data,
         }
 
         if (ep == get_bulk_in(c_data)) {
-                atomic_clear_bit(&ctx->state, BOMC1_TX_BUSY);
+                (void)atomic_dec(&ctx->tx_pending);
 
-                if (atomic_test_bit(&ctx->state, BOMC1_TX_MORE)) {
-                        (void)k_work_schedule_for_queue(
-                                &ctx->workq, &ctx->tx_work, K_TICKS(1));
-                }
+                /* Refill the pipeline with the rest of the stream */
+                (void)k_work_schedule_for_queue(&ctx->workq, &ctx->tx_work,
+                                                K_NO_WAIT);
         } else {
                 __ASSERT(0, "unrecognized endpoint");
         }
@@ -163,10 +197,45 @@ static int bomc1_usbd_request(struct usbd_class_data *const c_data,
         return usbd_ep_buf_free(usb_ctx, buf);
 }
 
+/** @brief Serialize the statistics of the phase selected by wValue */
+static int bomc1_usbd_stats(const struct usb_setup_packet *const setup,
+                            struct net_buf *const buf)
+{
+        int status;
+        struct bofp1_phase_stats stats;
+        size_t size = 3 * sizeof(uint32_t) + sizeof(uint64_t) +
+                      sizeof(stats.hist);
+
+        if (buf == NULL || setup->wLength < size) {
+                return -ENOMEM;
+        }
+
+        status = spectro_get_phase_stats(setup->wValue, &stats);
+        if (status != 0) {
+                return status;
+        }
+
+        net_buf_add_le32(buf, stats.count);
+        net_buf_add_le32(buf, stats.min);
+        net_buf_add_le32(buf, stats.max);
+        net_buf_add_le64(buf, stats.sum);
+
+        for (size_t i = 0; i < ARRAY_SIZE(stats.hist); i++) {
+                net_buf_add_le32(buf, stats.hist[i]);
+        }
+
+        return 0;
+}
+
 static int bomc1_usbd_cth(struct usbd_class_data *const c_data,
                           const struct usb_setup_packet *const setup,
                           struct net_buf *const buf)
 {
+        uint16_t start;
+        uint16_t len;
+        uint8_t factor;
+        bool sum;
+
         LOG_DBG("vendor request %" PRIu8 " (to host)", setup->bRequest);
 
         switch (setup->bRequest) {
@@ -177,6 +246,47 @@ static int bomc1_usbd_cth(struct usbd_class_data *const c_data,
 
                 net_buf_add_le32(buf, spectro_get_int_time());
                 return 0;
+        case BOMC1_VRQ_SPECTRO_OVERFLOW:
+                if (buf == NULL || setup->wLength < sizeof(uint32_t)) {
+                        return -ENOMEM;
+                }
+
+                net_buf_add_le32(buf, spectro_get_overflow());
+                return 0;
+        case BOMC1_VRQ_SPECTRO_AUTO_EXP:
+                if (buf == NULL || setup->wLength < sizeof(uint16_t)) {
+                        return -ENOMEM;
+                }
+
+                net_buf_add_le16(buf, spectro_get_auto_exposure());
+                return 0;
+        case BOMC1_VRQ_SPECTRO_ROI:
+                if (buf == NULL || setup->wLength < 2 * sizeof(uint16_t)) {
+                        return -ENOMEM;
+                }
+
+                spectro_get_roi(&start, &len);
+                net_buf_add_le16(buf, start);
+                net_buf_add_le16(buf, len);
+                return 0;
+        case BOMC1_VRQ_SPECTRO_BIN:
+                if (buf == NULL || setup->wLength < 2) {
+                        return -ENOMEM;
+                }
+
+                spectro_get_bin(&factor, &sum);
+                net_buf_add_u8(buf, factor);
+                net_buf_add_u8(buf, sum);
+                return 0;
+        case BOMC1_VRQ_SPECTRO_DUAL:
+                if (buf == NULL || setup->wLength < sizeof(uint8_t)) {
+                        return -ENOMEM;
+                }
+
+                net_buf_add_u8(buf, spectro_get_dual_readout());
+                return 0;
+        case BOMC1_VRQ_SPECTRO_STATS:
+                return bomc1_usbd_stats(setup, buf);
         default:
                 break;
         }
@@ -190,6 +300,8 @@ static int bomc1_usbd_ctd(struct usbd_class_data *const c_data,
 {
         int status;
         uint32_t int_time;
+        uint32_t count;
+        uint32_t period;
         uint8_t byte;
         struct bomc1_usb_ctx *ctx = usbd_class_get_private(c_data);
 
@@ -205,6 +317,42 @@ static int bomc1_usbd_ctd(struct usbd_class_data *const c_data,
                 }
 
                 break;
+        case BOMC1_VRQ_SPECTRO_STREAM:
+                if (setup->wLength != sizeof(count) + sizeof(period)) {
+                        return -ENOTSUP;
+                }
+
+                count = sys_get_le32(buf->data);
+                period = sys_get_le32(buf->data + sizeof(count));
+
+                LOG_INF("spectro begin stream (count: %" PRIu32
+                        ", period: %" PRIu32 " us)",
+                        count, period);
+
+                status = spectro_stream_start(count, period, data_rdy_handler,
+                                              ctx);
+                if (status != 0) {
+                        LOG_ERR("failed to stream from spectrometer: %i",
+                                status);
+                }
+
+                break;
+        case BOMC1_VRQ_SPECTRO_STOP:
+                LOG_INF("spectro stop stream");
+
+                status = spectro_stream_stop();
+                if (status != 0) {
+                        return status;
+                }
+
+                /* Abort the rest of a frame already queued on the bulk
+                 * endpoint. The refill then drops the acquired frames. */
+                status = usbd_ep_dequeue(usbd_class_get_ctx(c_data),
+                                         get_bulk_in(c_data));
+                (void)k_work_schedule_for_queue(&ctx->workq, &ctx->tx_work,
+                                                K_NO_WAIT);
+
+                return status;
         case BOMC1_VRQ_SPECTRO_INT_TIME:
                 if (setup->wLength != sizeof(int_time)) {
                         return -ENOTSUP;
@@ -212,6 +360,31 @@ static int bomc1_usbd_ctd(struct usbd_class_data *const c_data,
 
                 int_time = sys_get_le32(buf->data);
                 return spectro_set_int_time(int_time);
+        case BOMC1_VRQ_SPECTRO_AUTO_EXP:
+                if (setup->wLength != sizeof(uint16_t)) {
+                        return -ENOTSUP;
+                }
+
+                return spectro_set_auto_exposure(sys_get_le16(buf->data));
+        case BOMC1_VRQ_SPECTRO_ROI:
+                if (setup->wLength != 2 * sizeof(uint16_t)) {
+                        return -ENOTSUP;
+                }
+
+                return spectro_set_roi(sys_get_le16(buf->data),
+                                       sys_get_le16(buf->data + 2));
+        case BOMC1_VRQ_SPECTRO_BIN:
+                if (setup->wLength != 2) {
+                        return -ENOTSUP;
+                }
+
+                return spectro_set_bin(buf->data[0], buf->data[1] != 0);
+        case BOMC1_VRQ_SPECTRO_DUAL:
+                if (setup->wLength != sizeof(uint8_t)) {
+                        return -ENOTSUP;
+                }
+
+                return spectro_set_dual_readout(buf->data[0] != 0);
         case BOMC1_VRQ_SPECTRO_PL_CTRL:
                 if (setup->wLength != sizeof(uint8_t)) {
                         return -ENOTSUP;
@@ -236,6 +409,10 @@ static int bomc1_usbd_ctd(struct usbd_class_data *const c_data,
                 }
 
                 return spectro_set_total_avg_n(byte);
+        case BOMC1_VRQ_SPECTRO_DC_CALIB:
+                return spectro_dc_invalidate();
+        case BOMC1_VRQ_SPECTRO_STATS:
+                return spectro_reset_phase_stats();
         default:
                 return -ENOTSUP;
         }
@@ -247,7 +424,12 @@ static void *bomc1_usbd_get_desc(struct usbd_class_data *const c_data,
                                  const enum usbd_speed speed)
 {
         struct bomc1_usb_ctx *ctx = usbd_class_get_private(c_data);
-        return ctx->desc_list;
+
+        if (speed == USBD_SPEED_HS) {
+                return ctx->hs_desc_list;
+        }
+
+        return ctx->fs_desc_list;
 }
 
 static void bomc1_usbd_enable(struct usbd_class_data *const c_data)
@@ -326,21 +508,38 @@ static struct bomc1_usb_desc bomc1_usb_desc_s = {
                         .wMaxPacketSize = sys_cpu_to_le16(64U),
                         .bInterval = 0,
                 },
+        .if0_hs_in_ep =
+                {
+                        .bLength = sizeof(struct usb_ep_descriptor),
+                        .bDescriptorType = USB_DESC_ENDPOINT,
+                        .bEndpointAddress = 0x81,
+                        .bmAttributes = USB_EP_TYPE_BULK,
+                        .wMaxPacketSize = sys_cpu_to_le16(512U),
+                        .bInterval = 0,
+                },
         .nil_desc = {/* sentinel */},
 };
 
-static const struct usb_desc_header *bomc1_usb_desc[] = {
+static const struct usb_desc_header *bomc1_usb_fs_desc[] = {
         (struct usb_desc_header *)&bomc1_usb_desc_s.iad,
         (struct usb_desc_header *)&bomc1_usb_desc_s.if0,
         (struct usb_desc_header *)&bomc1_usb_desc_s.if0_in_ep,
         (struct usb_desc_header *)&bomc1_usb_desc_s.nil_desc,
 };
 
+static const struct usb_desc_header *bomc1_usb_hs_desc[] = {
+        (struct usb_desc_header *)&bomc1_usb_desc_s.iad,
+        (struct usb_desc_header *)&bomc1_usb_desc_s.if0,
+        (struct usb_desc_header *)&bomc1_usb_desc_s.if0_hs_in_ep,
+        (struct usb_desc_header *)&bomc1_usb_desc_s.nil_desc,
+};
+
 K_THREAD_STACK_DEFINE(bomc1_usb_workq_stack, 512);
 
 static struct bomc1_usb_ctx bomc1_usb_ctx = {
         .desc = &bomc1_usb_desc_s,
-        .desc_list = bomc1_usb_desc,
+        .fs_desc_list = bomc1_usb_fs_desc,
+        .hs_desc_list = bomc1_usb_hs_desc,
         .stack = bomc1_usb_workq_stack,
         .stack_size = K_THREAD_STACK_SIZEOF(bomc1_usb_workq_stack),
 };
@@ -348,7 +547,14 @@ static struct bomc1_usb_ctx bomc1_usb_ctx = {
 struct usbd_cctx_vendor_req bomc1_usb_vendor_req =
         USBD_VENDOR_REQ(BOMC1_VRQ_SPECTRO_READ, BOMC1_VRQ_SPECTRO_INT_TIME,
                         BOMC1_VRQ_SPECTRO_PL_CTRL, BOMC1_VRQ_SPECTRO_MOVAVG_N,
-                        BOMC1_VRQ_SPECTRO_TOTAVG_N);
+                        BOMC1_VRQ_SPECTRO_TOTAVG_N,
+                        BOMC1_VRQ_SPECTRO_DC_CALIB,
+                        BOMC1_VRQ_SPECTRO_OVERFLOW,
+                        BOMC1_VRQ_SPECTRO_STREAM, BOMC1_VRQ_SPECTRO_STOP,
+                        BOMC1_VRQ_SPECTRO_STATS,
+                        BOMC1_VRQ_SPECTRO_AUTO_EXP,
+                        BOMC1_VRQ_SPECTRO_ROI, BOMC1_VRQ_SPECTRO_BIN,
+                        BOMC1_VRQ_SPECTRO_DUAL);
 
 USBD_DEFINE_CLASS(bomc1_usb, &bomc1_usb_api, &bomc1_usb_ctx,
                   &bomc1_usb_vendor_req);
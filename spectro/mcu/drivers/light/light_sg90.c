@@ -9,9 +9,11 @@ struct sg90_light_cfg {
         struct pwm_dt_spec pwm;
         uint32_t dc_on;
         uint32_t dc_off;
+        uint32_t settle_time;
 };
 
 struct sg90_light_data {
+        struct light_driver_data common;
 };
 
 static int sg90_light_on(const struct device *dev)
@@ -26,9 +28,19 @@ static int sg90_light_off(const struct device *dev)
         return pwm_set_pulse_dt(&cfg->pwm, cfg->dc_off);
 }
 
+static int sg90_light_get_settle_time(const struct device *dev,
+                                      uint32_t *time_ms)
+{
+        const struct sg90_light_cfg *cfg = dev->config;
+
+        *time_ms = cfg->settle_time;
+        return 0;
+}
+
 static DEVICE_API(light, sg90_light_api) = {
         .light_on = sg90_light_on,
         .light_off = sg90_light_off,
+        .get_settle_time = sg90_light_get_settle_time,
 };
 
 static int sg90_light_init(const struct device *dev)
@@ -47,6 +59,7 @@ static int sg90_light_init(const struct device *dev)
                 .pwm = PWM_DT_SPEC_INST_GET_BY_NAME(node_, pwm),               \
                 .dc_off = DT_INST_PROP(node_, dc_off),                         \
                 .dc_on = DT_INST_PROP(node_, dc_on),                           \
+                .settle_time = DT_INST_PROP(node_, settle_time_ms),            \
         };                                                                     \
         static struct sg90_light_data sg90_light_data_##node_##__;             \
         DEVICE_DT_INST_DEFINE(node_, sg90_light_init, NULL,                    \
@@ -16,6 +16,11 @@
 
 LOG_MODULE_REGISTER(DT_DRV_COMPAT);
 
+/* Used when the light driver does not report a settle time */
+#define LIGHT_SETTLE_DEFAULT_MS (300)
+
+static int bofp1_regs_push(const struct device *dev);
+
 int bofp1_access(const struct device *dev, bool write, uint8_t addr, void *data,
                  size_t size)
 {
@@ -51,6 +56,57 @@ int bofp1_access(const struct device *dev, bool write, uint8_t addr, void *data,
         return spi_transceive_dt(&cfg->bus, &tx_set, &rx_set);
 }
 
+/**
+ * @brief Access @p size consecutive registers starting at @p addr
+ *
+ * @param dev
+ * @param write true to write @p data to the registers, false to read
+ * @param addr First register
+ * @param data One byte per register
+ * @param size Number of registers, at most 255
+ * @return int
+ * @retval 0 Success
+ * @retval <0 Negative errno code
+ */
+int bofp1_burst(const struct device *dev, bool write, uint8_t addr, void *data,
+                size_t size)
+{
+        uint8_t cmd[2];
+        const struct bofp1_cfg *cfg = dev->config;
+        struct spi_buf bufs[] = {
+                {
+                        .buf = cmd,
+                        .len = sizeof(cmd),
+                },
+                {
+                        .buf = data,
+                        .len = size,
+                },
+        };
+        struct spi_buf_set tx_set = {
+                .buffers = bufs,
+                .count = write ? 2 : 1,
+        };
+        struct spi_buf_set rx_set = {
+                .buffers = bufs,
+                .count = ARRAY_SIZE(bufs),
+        };
+
+        if (size > UINT8_MAX) {
+                return -EINVAL;
+        }
+
+        cmd[0] = (write ? BOFP1_WRITE_REG(addr) : BOFP1_READ_REG(addr)) |
+                 BOFP1_REG_BIT_BURST;
+        cmd[1] = size;
+
+        if (write) {
+                return spi_write_dt(&cfg->bus, &tx_set);
+        }
+
+        return spi_transceive_dt(&cfg->bus, &tx_set, &rx_set);
+}
+
 int bofp1_write_reg(const struct device *dev, uint8_t addr, uint8_t value)
 {
         return bofp1_access(dev, true, addr, &value, sizeof(value));
@@ -69,8 +125,9 @@ int bofp1_read_reg(const struct device *dev, uint8_t addr, uint8_t *value)
 static uint32_t bofp1_mclk_freq(const struct device *dev)
 {
         const struct bofp1_cfg *cfg = dev->config;
+        struct bofp1_data *data = dev->data;
 
-        return cfg->clock_frequency / cfg->clkdiv;
+        return cfg->clock_frequency / data->clkdiv;
 }
 
 static uint32_t bofp1_sample_freq(const struct device *dev)
@@ -83,7 +140,7 @@ static uint32_t bofp1_sh_div(const struct device *dev, uint32_t freq)
         return (bofp1_mclk_freq(dev) / freq) - 1;
 }
 
-static uint32_t bofp1_integration_time(const struct device *dev)
+uint32_t bofp1_integration_time(const struct device *dev)
 {
         struct bofp1_data *data = dev->data;
         uint32_t div;
@@ -93,6 +150,48 @@ static uint32_t bofp1_integration_time(const struct device *dev)
         return 1000000000UL / (bofp1_mclk_freq(dev) / (div + 1));
 }
 
+/**
+ * @brief Words read per FIFO chunk, which is also the FIFO watermark
+ *
+ * Picks the largest chunk for which the FIFO does not overflow from the
+ * watermark until the chunk is read out. The FIFO then has to take the
+ * words written within the latency budget and the transfer:
+ * chunk + fill * (latency + chunk / drain) <= size
+ */
+size_t bofp1_read_chunk(const struct device *dev)
+{
+        const struct bofp1_cfg *cfg = dev->config;
+        struct bofp1_data *data = dev->data;
+        uint64_t fill;
+        uint64_t drain;
+        uint64_t backlog;
+        uint64_t chunk = 0;
+
+        if (data->read_chunk != 0) {
+                return data->read_chunk;
+        }
+
+        /* Words per second into the FIFO that paces the readout, and out
+         * over SPI. Both FIFOs share the bus in a dual readout. */
+        fill = bofp1_sample_freq(dev);
+        drain = cfg->bus.config.frequency / 16;
+        if (data->dual) {
+                drain /= 2;
+        } else if (bofp1_get_prc(dev, BOFP1_PRC_BIN_ENA)) {
+                fill >>= data->bin & BOFP1_BIN_SHIFT_MASK;
+        }
+
+        backlog = fill * CONFIG_BOFP1_READ_LATENCY_US / USEC_PER_SEC;
+        if (backlog < BOFP1_FIFO_SIZE) {
+                chunk = (BOFP1_FIFO_SIZE - backlog) * drain / (drain + fill);
+        }
+
+        chunk = ROUND_DOWN(chunk, BOFP1_FIFO_WMARK_UNIT);
+
+        return CLAMP(chunk, BOFP1_FIFO_WMARK_UNIT,
+                     BOFP1_FIFO_SIZE - BOFP1_FIFO_WMARK_UNIT);
+}
+
 static int bofp1_set_integration_time(const struct device *dev,
                                       uint32_t time_ns)
 {
@@ -118,52 +217,206 @@ static int bofp1_set_integration_time(const struct device *dev,
         }
 
         sys_put_be24(div, data->shdiv);
+        bofp1_dc_select(dev);
 
-        status = bofp1_write_reg(dev, BOFP1_REG_CCD_SH1, data->shdiv[0]);
-        if (status != 0) {
-                goto exit;
+        status = bofp1_regs_push(dev);
+
+exit:
+        k_sem_give(&data->lock);
+
+        return status;
+}
+
+/**
+ * @brief Adjust the integration time toward the auto exposure target
+ *
+ * Uses the statistics of the frame that was just read out. The new SH
+ * divider is written to the FPGA before the next sample.
+ */
+void bofp1_ae_update(const struct device *dev)
+{
+        struct bofp1_data *data = dev->data;
+        uint32_t target = data->ae_target;
+        uint32_t peak;
+        uint32_t saturated;
+        uint32_t cur;
+        uint32_t next;
+        uint32_t min;
+        uint32_t max;
+
+        if (target == 0) {
+                return;
         }
 
-        status = bofp1_write_reg(dev, BOFP1_REG_CCD_SH2, data->shdiv[1]);
-        if (status != 0) {
-                goto exit;
+        peak = sys_get_be16(&data->stats_raw[2]);
+        saturated = sys_get_be16(&data->stats_raw[10]);
+        cur = sys_get_be24(data->shdiv) + 1;
+
+        /* Same limits as bofp1_set_integration_time(), the longest being
+         * 1 s, which also keeps the integration time in ns within 32 bits */
+        min = bofp1_sh_div(dev, NSEC_PER_SEC / BOFP1_AE_MIN_TIME_NS) + 1;
+        max = MIN(bofp1_sh_div(dev, 1) + 1, BIT(24));
+
+        next = bofp1_ae_next(cur, peak, saturated, target, min, max);
+        if (next == cur) {
+                return;
         }
 
-        status = bofp1_write_reg(dev, BOFP1_REG_CCD_SH3, data->shdiv[2]);
+        sys_put_be24(next - 1, data->shdiv);
+        bofp1_dc_select(dev);
+        atomic_set_bit(&data->state, BOFP1_AE_PENDING);
+
+        LOG_DBG("auto exposure: peak %" PRIu32 ", saturated %" PRIu32
+                ", integration time %" PRIu32 " ns",
+                peak, saturated, bofp1_integration_time(dev));
+}
+
+/** @brief Pack the configuration into the shadow register file */
+void bofp1_regs_pack(const struct device *dev)
+{
+        struct bofp1_data *data = dev->data;
+        uint8_t *regs = data->regs;
+
+        (void)memcpy(&regs[BOFP1_REGS_IDX(BOFP1_REG_CCD_SH1)], data->shdiv,
+                     sizeof(data->shdiv));
+        regs[BOFP1_REGS_IDX(BOFP1_REG_PRCCTRL)] = data->prc;
+        regs[BOFP1_REGS_IDX(BOFP1_REG_MOVING_AVG_N)] = data->moving_avg_n;
+        regs[BOFP1_REGS_IDX(BOFP1_REG_TOTAL_AVG_N)] = data->total_avg_n;
+        sys_put_be16(data->roi_start,
+                     &regs[BOFP1_REGS_IDX(BOFP1_REG_ROI_START1)]);
+        sys_put_be16(data->roi_len, &regs[BOFP1_REGS_IDX(BOFP1_REG_ROI_LEN1)]);
+        regs[BOFP1_REGS_IDX(BOFP1_REG_BIN)] = data->bin;
+        regs[BOFP1_REGS_IDX(BOFP1_REG_MCLK_DIV)] = data->clkdiv;
+        regs[BOFP1_REGS_IDX(BOFP1_REG_FIR_TAPS)] = data->fir_taps;
+        regs[BOFP1_REGS_IDX(BOFP1_REG_DC_SLOT)] = data->dc_slot;
+        regs[BOFP1_REGS_IDX(BOFP1_REG_DC_FRAMES)] = data->dc_frames;
+        regs[BOFP1_REGS_IDX(BOFP1_REG_FIFO_WMARK)] =
+                bofp1_read_chunk(dev) / BOFP1_FIFO_WMARK_UNIT;
+        regs[BOFP1_REGS_IDX(BOFP1_REG_CAPTURE_MODE)] =
+                atomic_test_bit(&data->state, BOFP1_CAPTURING) ?
+                        data->capture_mode :
+                        BOFP1_CAPTURE_SINGLE;
+}
+
+/** @brief Unpack the shadow register file into the configuration */
+static void bofp1_regs_unpack(const struct device *dev)
+{
+        struct bofp1_data *data = dev->data;
+        uint8_t *regs = data->regs;
+
+        (void)memcpy(data->shdiv, &regs[BOFP1_REGS_IDX(BOFP1_REG_CCD_SH1)],
+                     sizeof(data->shdiv));
+        data->prc = regs[BOFP1_REGS_IDX(BOFP1_REG_PRCCTRL)];
+        data->moving_avg_n = regs[BOFP1_REGS_IDX(BOFP1_REG_MOVING_AVG_N)];
+        data->total_avg_n = regs[BOFP1_REGS_IDX(BOFP1_REG_TOTAL_AVG_N)];
+        data->roi_start =
+                sys_get_be16(&regs[BOFP1_REGS_IDX(BOFP1_REG_ROI_START1)]);
+        data->roi_len = sys_get_be16(&regs[BOFP1_REGS_IDX(BOFP1_REG_ROI_LEN1)]);
+        data->bin = regs[BOFP1_REGS_IDX(BOFP1_REG_BIN)];
+        data->clkdiv = regs[BOFP1_REGS_IDX(BOFP1_REG_MCLK_DIV)];
+        data->fir_taps = regs[BOFP1_REGS_IDX(BOFP1_REG_FIR_TAPS)];
+        data->dc_slot = regs[BOFP1_REGS_IDX(BOFP1_REG_DC_SLOT)];
+        data->dc_frames = regs[BOFP1_REGS_IDX(BOFP1_REG_DC_FRAMES)];
+}
+
+/** @brief Load the shadow register file from the FPGA, e.g. after a reset */
+static int bofp1_regs_load(const struct device *dev)
+{
+        int status;
+        struct bofp1_data *data = dev->data;
+
+        status = bofp1_burst(dev, false, BOFP1_REGS_FIRST, data->regs,
+                             sizeof(data->regs));
         if (status != 0) {
-                goto exit;
+                return status;
         }
 
-exit:
-        k_sem_give(&data->lock);
+        bofp1_regs_unpack(dev);
 
-        return status;
+        return 0;
 }
 
-static int bofp1_set_reg(const struct device *dev, uint8_t reg, uint8_t val)
+/**
+ * @brief Write the whole configuration to the FPGA, and verify it
+ *
+ * Both the write and the readback are a single burst.
+ */
+static int bofp1_regs_push(const struct device *dev)
 {
         int status;
-        uint8_t check;
+        uint8_t check[BOFP1_REGS_LEN];
+        struct bofp1_data *data = dev->data;
+
+        bofp1_regs_pack(dev);
 
-        status = bofp1_write_reg(dev, reg, val);
+        status = bofp1_burst(dev, true, BOFP1_REGS_FIRST, data->regs,
+                             sizeof(data->regs));
         if (status != 0) {
                 return status;
         }
 
-        status = bofp1_read_reg(dev, reg, &check);
+        status = bofp1_burst(dev, false, BOFP1_REGS_FIRST, check,
+                             sizeof(check));
         if (status != 0) {
                 return status;
-        } else if (check != val) {
-                LOG_ERR("Unable to set register; returned value did not match "
-                        "desired value");
+        } else if (memcmp(check, data->regs, sizeof(check)) != 0) {
+                LOG_ERR("Unable to set registers; returned values did not "
+                        "match desired values");
                 return -EIO;
         }
 
-        LOG_DBG("set register %d to %d", reg, val);
+        LOG_HEXDUMP_DBG(data->regs, sizeof(data->regs), "set registers");
 
         return 0;
 }
 
+static int bofp1_set_mclk_div(const struct device *dev, uint32_t div)
+{
+        int status;
+        uint32_t time_ns;
+        uint32_t freq;
+        uint32_t sh_div;
+        uint8_t prev;
+        uint8_t prev_sh[3];
+        const struct bofp1_cfg *cfg = dev->config;
+        struct bofp1_data *data = dev->data;
+
+        if (div == 0 || div > UINT8_MAX) {
+                return -EINVAL;
+        }
+
+        freq = cfg->clock_frequency / div;
+        if (freq < BOFP1_MCLK_FREQ_MIN || freq > BOFP1_MCLK_FREQ_MAX) {
+                LOG_ERR("MCLK frequency %" PRIu32 " is out of range.", freq);
+                return -EINVAL;
+        }
+
+        (void)k_sem_take(&data->lock, K_FOREVER);
+
+        /* The SH divider counts MCLK periods, so it is scaled along to keep
+         * the integration time. The dark current depends on both. */
+        prev = data->clkdiv;
+        time_ns = prev != 0 ? bofp1_integration_time(dev) :
+                              cfg->integration_time_dt;
+
+        (void)memcpy(prev_sh, data->shdiv, sizeof(prev_sh));
+        data->clkdiv = div;
+        sh_div = bofp1_sh_div(dev, NSEC_PER_SEC / time_ns);
+        sys_put_be24(MIN(sh_div, (1 << 24) - 1), data->shdiv);
+        bofp1_dc_select(dev);
+
+        status = bofp1_regs_push(dev);
+        if (status != 0) {
+                data->clkdiv = prev;
+                (void)memcpy(data->shdiv, prev_sh, sizeof(prev_sh));
+                bofp1_dc_select(dev);
+        }
+
+        k_sem_give(&data->lock);
+
+        return status;
+}
+
 static int bofp1_set_moving_avg_n(const struct device *dev, uint8_t n)
 {
         int status = 0;
@@ -171,7 +424,12 @@ static int bofp1_set_moving_avg_n(const struct device *dev, uint8_t n)
 
         (void)k_sem_take(&data->lock, K_FOREVER);
 
-        status = bofp1_set_reg(dev, BOFP1_REG_MOVING_AVG_N, n);
+        if (n != data->moving_avg_n) {
+                bofp1_dc_invalidate(dev);
+        }
+
+        data->moving_avg_n = n;
+        status = bofp1_regs_push(dev);
         data->moving_avg_n = status == 0 ? n : 0;
 
         k_sem_give(&data->lock);
@@ -179,6 +437,45 @@ static int bofp1_set_moving_avg_n(const struct device *dev, uint8_t n)
         return status;
 }
 
+int bofp1_set_fir(const struct device *dev, const int16_t *coefs,
+                  size_t taps)
+{
+        int status;
+        struct bofp1_data *data = dev->data;
+        /* Index and coefficient, written as a single burst */
+        uint8_t coef[3];
+
+        if (taps > BOFP1_FIR_TAPS_MAX) {
+                return -EINVAL;
+        }
+
+        (void)k_sem_take(&data->lock, K_FOREVER);
+
+        bofp1_dc_invalidate(dev);
+
+        /* Fall back to the boxcar average while the coefficients are
+         * replaced */
+        data->fir_taps = 0;
+        status = bofp1_regs_push(dev);
+
+        for (size_t i = 0; status == 0 && i < taps; i++) {
+                coef[0] = i;
+                sys_put_be16(coefs[i], &coef[1]);
+                status = bofp1_burst(dev, true, BOFP1_REG_FIR_ADDR, coef,
+                                     sizeof(coef));
+        }
+
+        if (status == 0) {
+                data->fir_taps = taps;
+                status = bofp1_regs_push(dev);
+                data->fir_taps = status == 0 ? taps : 0;
+        }
+
+        k_sem_give(&data->lock);
+
+        return status;
+}
+
 static int bofp1_set_total_avg_n(const struct device *dev, uint8_t n)
 {
         int status = 0;
@@ -186,7 +483,12 @@ static int bofp1_set_total_avg_n(const struct device *dev, uint8_t n)
 
         (void)k_sem_take(&data->lock, K_FOREVER);
 
-        status = bofp1_set_reg(dev, BOFP1_REG_TOTAL_AVG_N, n);
+        if (n != data->total_avg_n) {
+                bofp1_dc_invalidate(dev);
+        }
+
+        data->total_avg_n = n;
+        status = bofp1_regs_push(dev);
         data->total_avg_n = status == 0 ? n : 0;
 
         k_sem_give(&data->lock);
@@ -194,38 +496,224 @@ static int bofp1_set_total_avg_n(const struct device *dev, uint8_t n)
         return status;
 }
 
-static int bofp1_set_prc(const struct device *dev, bool dc_ena, bool movavg_ena,
-                         bool totavg_ena)
+static int bofp1_set_dc_frames(const struct device *dev, uint8_t n)
+{
+        int status;
+        uint8_t prev;
+        struct bofp1_data *data = dev->data;
+
+        (void)k_sem_take(&data->lock, K_FOREVER);
+
+        /* Maps averaged over another number of frames are stale */
+        if (n != data->dc_frames) {
+                bofp1_dc_invalidate(dev);
+        }
+
+        prev = data->dc_frames;
+        data->dc_frames = n;
+        status = bofp1_regs_push(dev);
+        if (status != 0) {
+                data->dc_frames = prev;
+        }
+
+        k_sem_give(&data->lock);
+
+        return status;
+}
+
+static int bofp1_set_roi(const struct device *dev, uint16_t start,
+                         uint16_t len)
+{
+        int status;
+        struct bofp1_data *data = dev->data;
+
+        (void)k_sem_take(&data->lock, K_FOREVER);
+
+        data->roi_start = start;
+        data->roi_len = len;
+        status = bofp1_regs_push(dev);
+
+        /* Fall back to the full frame, as the FPGA may be left with a
+         * partial update */
+        data->roi_start = status == 0 ? start : 0;
+        data->roi_len = status == 0 ? len : 0;
+
+        k_sem_give(&data->lock);
+
+        return status;
+}
+
+/** @brief Update the bits in @p mask of the PRC register to @p val */
+static int bofp1_update_prc(const struct device *dev, uint8_t mask, uint8_t val)
 {
         int status = 0;
-        uint8_t val;
         uint8_t cur;
         struct bofp1_data *data = dev->data;
 
-        val = (dc_ena << BOFP1_PRC_DC_ENA) |
-              (movavg_ena << BOFP1_PRC_MOVAVG_ENA) |
-              (totavg_ena << BOFP1_PRC_TOTAVG_ENA);
+        (void)k_sem_take(&data->lock, K_FOREVER);
+
+        cur = data->prc & ~mask;
+        cur |= val & mask;
+
+        /* Every pass of the total average is written to the raw FIFO,
+         * which a dual readout cannot keep apart, and the raw FIFO cannot
+         * hold on to a frame like the frame buffer */
+        if (data->dual && (cur & ((1 << BOFP1_PRC_TOTAVG_ENA) |
+                                  (1 << BOFP1_PRC_FRAME_BUF))) != 0) {
+                k_sem_give(&data->lock);
+                return -ENOTSUP;
+        }
+
+        /* Frames captured without the driver have to wait in the frame
+         * buffer until they are read */
+        if (data->capture_mode != BOFP1_CAPTURE_SINGLE &&
+            (cur & (1 << BOFP1_PRC_FRAME_BUF)) == 0) {
+                k_sem_give(&data->lock);
+                return -ENOTSUP;
+        }
+
+        /* The dark current stage comes after the averaging stages, so the
+         * calibration is only valid for the same averaging settings. */
+        if (((cur ^ data->prc) & ((1 << BOFP1_PRC_MOVAVG_ENA) |
+                                  (1 << BOFP1_PRC_TOTAVG_ENA))) != 0) {
+                bofp1_dc_invalidate(dev);
+        }
+
+        data->prc = cur;
+        status = bofp1_regs_push(dev);
+        data->prc = status == 0 ? cur : 0;
+
+        k_sem_give(&data->lock);
+
+        return status;
+}
+
+static int bofp1_set_bin(const struct device *dev, uint8_t factor, bool sum)
+{
+        int status;
+        uint8_t bin;
+        struct bofp1_data *data = dev->data;
+
+        if (factor == 0 || factor > 8 || !IS_POWER_OF_TWO(factor)) {
+                return -EINVAL;
+        }
+
+        bin = LOG2(factor) & BOFP1_BIN_SHIFT_MASK;
+        if (sum) {
+                bin |= 1 << BOFP1_BIN_SUM;
+        }
 
         (void)k_sem_take(&data->lock, K_FOREVER);
 
-        status = bofp1_read_reg(dev, BOFP1_REG_PRCCTRL, &cur);
+        data->bin = bin;
+        status = bofp1_regs_push(dev);
+        data->bin = status == 0 ? bin : 0;
+
+        k_sem_give(&data->lock);
+
         if (status != 0) {
-                k_sem_give(&data->lock);
                 return status;
         }
 
-        cur &= ~((1 << BOFP1_PRC_DC_ENA) | (1 << BOFP1_PRC_MOVAVG_ENA) |
-                 (1 << BOFP1_PRC_TOTAVG_ENA));
-        cur |= val;
+        return bofp1_update_prc(dev, 1 << BOFP1_PRC_BIN_ENA,
+                                factor > 1 ? 1 << BOFP1_PRC_BIN_ENA : 0);
+}
 
-        status = bofp1_set_reg(dev, BOFP1_REG_PRCCTRL, cur);
-        data->prc = status == 0 ? cur : 0;
+static int bofp1_set_dual(const struct device *dev, bool dual)
+{
+        int status;
+        struct bofp1_data *data = dev->data;
+
+        if (dual && (bofp1_get_prc(dev, BOFP1_PRC_TOTAVG_ENA) ||
+                     bofp1_get_prc(dev, BOFP1_PRC_FRAME_BUF))) {
+                return -ENOTSUP;
+        }
+
+        /* The raw FIFO fills up at least as fast as the pipeline FIFO, so it
+         * paces a dual readout */
+        status = bofp1_update_prc(dev, 1 << BOFP1_PRC_WMARK_SRC,
+                                  dual ? 0 : 1 << BOFP1_PRC_WMARK_SRC);
+        if (status != 0) {
+                return status;
+        }
+
+        (void)k_sem_take(&data->lock, K_FOREVER);
+
+        /* The watermark follows the FIFO that paces the readout */
+        data->dual = dual;
+        status = bofp1_regs_push(dev);
+        data->dual = status == 0 ? dual : false;
+
+        k_sem_give(&data->lock);
+
+        return status;
+}
+
+static int bofp1_set_read_chunk(const struct device *dev, uint16_t chunk)
+{
+        int status;
+        struct bofp1_data *data = dev->data;
+
+        (void)k_sem_take(&data->lock, K_FOREVER);
+
+        data->read_chunk = ROUND_DOWN(chunk, BOFP1_FIFO_WMARK_UNIT);
+        status = bofp1_regs_push(dev);
+        data->read_chunk = status == 0 ? data->read_chunk : 0;
+
+        k_sem_give(&data->lock);
+
+        return status;
+}
+
+static int bofp1_set_capture_mode(const struct device *dev,
+                                  enum bofp1_capture_mode mode)
+{
+        int status;
+        struct bofp1_data *data = dev->data;
+
+        if (mode != BOFP1_CAPTURE_SINGLE && mode != BOFP1_CAPTURE_CONTINUOUS &&
+            mode != BOFP1_CAPTURE_TRIGGER) {
+                return -EINVAL;
+        }
+
+        (void)k_sem_take(&data->lock, K_FOREVER);
+
+        if (mode != BOFP1_CAPTURE_SINGLE &&
+            !bofp1_get_prc(dev, BOFP1_PRC_FRAME_BUF)) {
+                k_sem_give(&data->lock);
+                return -ENOTSUP;
+        }
+
+        /* A stream in progress switches over right away. Back in single
+         * mode, the next frame is started by the driver again. */
+        if (mode == BOFP1_CAPTURE_SINGLE) {
+                atomic_clear_bit(&data->state, BOFP1_CAPTURING);
+        }
+
+        data->capture_mode = mode;
+        status = bofp1_regs_push(dev);
+        data->capture_mode = status == 0 ? mode : BOFP1_CAPTURE_SINGLE;
 
         k_sem_give(&data->lock);
 
         return status;
 }
 
+static int bofp1_set_prc(const struct device *dev, bool dc_ena, bool movavg_ena,
+                         bool totavg_ena)
+{
+        uint8_t val;
+        uint8_t mask;
+
+        val = (dc_ena << BOFP1_PRC_DC_ENA) |
+              (movavg_ena << BOFP1_PRC_MOVAVG_ENA) |
+              (totavg_ena << BOFP1_PRC_TOTAVG_ENA);
+        mask = (1 << BOFP1_PRC_DC_ENA) | (1 << BOFP1_PRC_MOVAVG_ENA) |
+               (1 << BOFP1_PRC_TOTAVG_ENA);
+
+        return bofp1_update_prc(dev, mask, val);
+}
+
 uint8_t bofp1_get_prc(const struct device *dev, unsigned int bit)
 {
         struct bofp1_data *data = dev->data;
@@ -233,6 +721,67 @@ uint8_t bofp1_get_prc(const struct device *dev, unsigned int bit)
         return (data->prc >> bit) & 0x1;
 }
 
+void bofp1_dc_invalidate(const struct device *dev)
+{
+        struct bofp1_data *data = dev->data;
+
+        for (size_t i = 0; i < ARRAY_SIZE(data->dc_maps); i++) {
+                data->dc_maps[i].valid = false;
+        }
+}
+
+/**
+ * @brief Select the dark current map of the current integration time
+ *
+ * A map calibrated at the same dividers is reused, so that switching back
+ * to an integration time doesn't need a new calibration. Otherwise the
+ * least recently calibrated map is taken over.
+ */
+void bofp1_dc_select(const struct device *dev)
+{
+        struct bofp1_data *data = dev->data;
+        struct bofp1_dc_map *maps = data->dc_maps;
+        uint32_t shdiv = sys_get_be24(data->shdiv);
+        size_t oldest = 0;
+
+        for (size_t i = 0; i < ARRAY_SIZE(data->dc_maps); i++) {
+                if (maps[i].shdiv == shdiv && maps[i].clkdiv == data->clkdiv) {
+                        data->dc_slot = i;
+                        return;
+                }
+
+                if (maps[oldest].valid &&
+                    (!maps[i].valid ||
+                     maps[i].timestamp < maps[oldest].timestamp)) {
+                        oldest = i;
+                }
+        }
+
+        maps[oldest].shdiv = shdiv;
+        maps[oldest].clkdiv = data->clkdiv;
+        maps[oldest].valid = false;
+        data->dc_slot = oldest;
+}
+
+bool bofp1_dc_expired(const struct device *dev)
+{
+        struct bofp1_data *data = dev->data;
+        const struct bofp1_dc_map *map;
+
+        /* No calibration is needed if the stage is skipped */
+        if (!bofp1_get_prc(dev, BOFP1_PRC_DC_ENA)) {
+                return false;
+        }
+
+        map = &data->dc_maps[data->dc_slot];
+        if (!map->valid) {
+                return true;
+        }
+
+        return data->dc_max_age != 0 &&
+               k_uptime_get() - map->timestamp > data->dc_max_age;
+}
+
 static int bofp1_reset(const struct device *dev)
 {
         return bofp1_write_reg(dev, BOFP1_REG_RESET, 0);
@@ -266,6 +815,52 @@ static int bofp1_attr_get(const struct device *dev, enum sensor_channel chan,
         case SENSOR_ATTR_BOFP1_TOTAL_AVG_ENA:
                 val->val1 = bofp1_get_prc(dev, BOFP1_PRC_TOTAVG_ENA);
                 break;
+        case SENSOR_ATTR_BOFP1_DC_POLICY:
+                val->val1 = data->dc_policy;
+                break;
+        case SENSOR_ATTR_BOFP1_DC_MAX_AGE:
+                val->val1 = data->dc_max_age;
+                break;
+        case SENSOR_ATTR_BOFP1_DC_FRAMES:
+                val->val1 = data->dc_frames;
+                break;
+        case SENSOR_ATTR_BOFP1_STATS_ONLY:
+                val->val1 = bofp1_get_prc(dev, BOFP1_PRC_STATS_ONLY);
+                break;
+        case SENSOR_ATTR_BOFP1_AUTO_EXPOSURE:
+                val->val1 = data->ae_target;
+                break;
+        case SENSOR_ATTR_BOFP1_ROI:
+                val->val1 = data->roi_start;
+                val->val2 = data->roi_len;
+                break;
+        case SENSOR_ATTR_BOFP1_BIN:
+                val->val1 = bofp1_get_prc(dev, BOFP1_PRC_BIN_ENA) ?
+                                    1 << (data->bin & BOFP1_BIN_SHIFT_MASK) :
+                                    1;
+                val->val2 = (data->bin >> BOFP1_BIN_SUM) & 0x1;
+                break;
+        case SENSOR_ATTR_BOFP1_DUAL_READOUT:
+                val->val1 = data->dual;
+                break;
+        case SENSOR_ATTR_BOFP1_FRAME_BUFFER:
+                val->val1 = bofp1_get_prc(dev, BOFP1_PRC_FRAME_BUF);
+                break;
+        case SENSOR_ATTR_BOFP1_CAPTURE_MODE:
+                val->val1 = data->capture_mode;
+                break;
+        case SENSOR_ATTR_BOFP1_TRIGGER_TIMEOUT:
+                val->val1 = data->trigger_timeout;
+                break;
+        case SENSOR_ATTR_BOFP1_MCLK_DIV:
+                val->val1 = data->clkdiv;
+                break;
+        case SENSOR_ATTR_BOFP1_READ_CHUNK:
+                val->val1 = bofp1_read_chunk(dev);
+                break;
+        case SENSOR_ATTR_BOFP1_FIR_TAPS:
+                val->val1 = data->fir_taps;
+                break;
         default:
                 return -EINVAL;
         }
@@ -280,6 +875,7 @@ static int bofp1_attr_set(const struct device *dev, enum sensor_channel chan,
         uint8_t dc_ena;
         uint8_t movavg_ena;
         uint8_t totavg_ena;
+        struct bofp1_data *data = dev->data;
 
         if (chan != (enum sensor_channel)SENSOR_CHAN_BOFP1_INTENSITY) {
                 return -EINVAL;
@@ -295,13 +891,95 @@ static int bofp1_attr_set(const struct device *dev, enum sensor_channel chan,
         case SENSOR_ATTR_BOFP1_MOVING_AVG_N:
                 return bofp1_set_moving_avg_n(dev, (uint8_t)val->val1);
         case SENSOR_ATTR_BOFP1_TOTAL_AVG_N:
-                return bofp1_set_total_avg_n(dev, (uint8_t)val->val1);
+                if (val->val1 < 0 || val->val1 > UINT8_MAX) {
+                        return -EINVAL;
+                }
+
+                return bofp1_set_total_avg_n(dev, val->val1);
         case SENSOR_ATTR_BOFP1_DARK_CURRENT_ENA:
                 return bofp1_set_prc(dev, val->val1, movavg_ena, totavg_ena);
         case SENSOR_ATTR_BOFP1_MOVING_AVG_ENA:
                 return bofp1_set_prc(dev, dc_ena, val->val1, totavg_ena);
         case SENSOR_ATTR_BOFP1_TOTAL_AVG_ENA:
                 return bofp1_set_prc(dev, dc_ena, movavg_ena, val->val1);
+        case SENSOR_ATTR_BOFP1_DC_POLICY:
+                if (val->val1 != BOFP1_DC_POLICY_ALWAYS &&
+                    val->val1 != BOFP1_DC_POLICY_CACHED) {
+                        return -EINVAL;
+                }
+
+                data->dc_policy = val->val1;
+                break;
+        case SENSOR_ATTR_BOFP1_DC_MAX_AGE:
+                if (val->val1 < 0) {
+                        return -EINVAL;
+                }
+
+                data->dc_max_age = val->val1;
+                break;
+        case SENSOR_ATTR_BOFP1_DC_FRAMES:
+                if (val->val1 < 0 || val->val1 > UINT8_MAX) {
+                        return -EINVAL;
+                }
+
+                return bofp1_set_dc_frames(dev, val->val1);
+        case SENSOR_ATTR_BOFP1_DC_INVALIDATE:
+                bofp1_dc_invalidate(dev);
+                break;
+        case SENSOR_ATTR_BOFP1_STATS_ONLY:
+                return bofp1_update_prc(
+                        dev, 1 << BOFP1_PRC_STATS_ONLY,
+                        val->val1 != 0 ? 1 << BOFP1_PRC_STATS_ONLY : 0);
+        case SENSOR_ATTR_BOFP1_AUTO_EXPOSURE:
+                if (val->val1 < 0 || val->val1 > UINT16_MAX) {
+                        return -EINVAL;
+                }
+
+                data->ae_target = val->val1;
+                break;
+        case SENSOR_ATTR_BOFP1_ROI:
+                if (val->val1 < 0 || val->val2 < 0 ||
+                    val->val1 + val->val2 > BOFP1_NUM_ELEMENTS) {
+                        return -EINVAL;
+                }
+
+                return bofp1_set_roi(dev, val->val2 != 0 ? val->val1 : 0,
+                                     val->val2);
+        case SENSOR_ATTR_BOFP1_BIN:
+                if (val->val1 < 0 || val->val1 > UINT8_MAX) {
+                        return -EINVAL;
+                }
+
+                return bofp1_set_bin(dev, val->val1, val->val2 != 0);
+        case SENSOR_ATTR_BOFP1_DUAL_READOUT:
+                return bofp1_set_dual(dev, val->val1 != 0);
+        case SENSOR_ATTR_BOFP1_FRAME_BUFFER:
+                return bofp1_update_prc(
+                        dev, 1 << BOFP1_PRC_FRAME_BUF,
+                        val->val1 != 0 ? 1 << BOFP1_PRC_FRAME_BUF : 0);
+        case SENSOR_ATTR_BOFP1_CAPTURE_MODE:
+                return bofp1_set_capture_mode(dev, val->val1);
+        case SENSOR_ATTR_BOFP1_TRIGGER_TIMEOUT:
+                if (val->val1 < 0) {
+                        return -EINVAL;
+                }
+
+                data->trigger_timeout = val->val1;
+                break;
+        case SENSOR_ATTR_BOFP1_MCLK_DIV:
+                if (val->val1 < 0) {
+                        return -EINVAL;
+                }
+
+                return bofp1_set_mclk_div(dev, val->val1);
+        case SENSOR_ATTR_BOFP1_READ_CHUNK:
+                if (val->val1 < 0 ||
+                    val->val1 > BOFP1_FIFO_SIZE - BOFP1_FIFO_WMARK_UNIT ||
+                    (val->val1 != 0 && val->val1 < BOFP1_FIFO_WMARK_UNIT)) {
+                        return -EINVAL;
+                }
+
+                return bofp1_set_read_chunk(dev, val->val1);
         default:
                 return -EINVAL;
         }
@@ -309,6 +987,19 @@ static int bofp1_attr_set(const struct device *dev, enum sensor_channel chan,
         return 0;
 }
 
+static uint32_t bofp1_frame_duration(const struct device *dev)
+{
+        return 1000000000ULL / bofp1_sample_freq(dev) * BOFP1_NUM_ELEMENTS;
+}
+
+k_timeout_t bofp1_flush_time(const struct device *dev)
+{
+        /* The flush first synchronizes to the integration time, and then
+         * reads out a full frame that is discarded. */
+        return K_NSEC(2ULL * bofp1_integration_time(dev) +
+                      bofp1_frame_duration(dev));
+}
+
 static k_timeout_t bofp1_timeout(const struct device *dev)
 {
         uint64_t ns;
@@ -320,11 +1011,14 @@ static k_timeout_t bofp1_timeout(const struct device *dev)
          * the integration time, and may not start until after the
          * integration time has passed. If total averages is enabled,
          * this repeats N times. It will then use roughly 5ms to
-         * collect 1024 samples, which is more than what we need. */
-        frame_duration =
-                1000000000ULL / bofp1_sample_freq(dev) * BOFP1_NUM_ELEMENTS;
+         * collect 1024 samples, which is more than what we need. A dark
+         * current calibration averages its own number of frames. */
+        frame_duration = bofp1_frame_duration(dev);
         ns = bofp1_integration_time(dev) + frame_duration;
-        if (bofp1_get_prc(dev, BOFP1_PRC_TOTAVG_ENA)) {
+        if (atomic_test_bit(&data->state, BOFP1_DC_CALIB) &&
+            data->dc_frames != 0) {
+                ns += (data->dc_frames) * (frame_duration + ns);
+        } else if (bofp1_get_prc(dev, BOFP1_PRC_TOTAVG_ENA)) {
                 ns += (data->total_avg_n) * (frame_duration + ns);
         }
         ns += 5000000;
@@ -340,6 +1034,22 @@ int bofp1_enable_read(const struct device *dev)
 
         status = gpio_pin_interrupt_configure_dt(&cfg->fifo_w_gpios,
                                                  GPIO_INT_EDGE_TO_ACTIVE);
+
+        /* A frame of a triggered stream waits for the external trigger,
+         * which may come at any time */
+        if (data->capture_mode == BOFP1_CAPTURE_TRIGGER &&
+            atomic_test_bit(&data->state, BOFP1_STREAMING) &&
+            !atomic_test_bit(&data->state, BOFP1_DC_CALIB)) {
+                if (data->trigger_timeout != 0) {
+                        k_work_reschedule(&data->watchdog_work,
+                                          K_MSEC(data->trigger_timeout));
+                } else {
+                        (void)k_work_cancel_delayable(&data->watchdog_work);
+                }
+
+                return status;
+        }
+
         k_work_reschedule(&data->watchdog_work, bofp1_timeout(dev));
 
         return status;
@@ -363,6 +1073,12 @@ static void bofp1_busy_fall(const struct device *dev)
 {
         struct bofp1_data *data = dev->data;
 
+        /* Busy falls after every frame of a free running capture, so the
+         * watermark of the frame buffer paces the readout instead */
+        if (atomic_test_bit(&data->state, BOFP1_CAPTURING)) {
+                return;
+        }
+
         if (!atomic_test_and_clear_bit(&data->state, BOFP1_BUSY)) {
                 return;
         }
@@ -461,6 +1177,7 @@ static int bofp1_init_gpio(const struct gpio_dt_spec *spec,
 static int bofp1_init(const struct device *dev)
 {
         int status;
+        uint32_t settle_ms;
         const struct bofp1_cfg *cfg = dev->config;
         struct bofp1_data *data = dev->data;
 
@@ -470,6 +1187,10 @@ static int bofp1_init(const struct device *dev)
 
         (void)bofp1_rtio_init(dev);
 
+        data->dc_policy = cfg->dc_policy_dt;
+        data->dc_max_age = cfg->dc_max_age_dt;
+        data->trigger_timeout = cfg->trigger_timeout_dt;
+
         status = k_sem_init(&data->lock, 1, K_SEM_MAX_LIMIT);
         if (status != 0) {
                 return status;
@@ -480,6 +1201,15 @@ static int bofp1_init(const struct device *dev)
                 return status;
         }
 
+        status = light_get_settle_time(cfg->light, &settle_ms);
+        if (status == -ENOTSUP) {
+                settle_ms = LIGHT_SETTLE_DEFAULT_MS;
+        } else if (status != 0) {
+                return status;
+        }
+
+        data->light_settle = K_MSEC(settle_ms);
+
         status = bofp1_init_gpio(&cfg->busy_gpios, bofp1_busy_fall_cb,
                                  &data->busy_fall_cb, BIT(cfg->busy_gpios.pin));
         if (status != 0) {
@@ -505,6 +1235,18 @@ static int bofp1_init(const struct device *dev)
                 return status;
         }
 
+        /* Start from the defaults of the FPGA */
+        status = bofp1_regs_load(dev);
+        if (status != 0) {
+                return status;
+        }
+
+        status = bofp1_set_mclk_div(dev, cfg->clkdiv);
+        if (status != 0) {
+                LOG_ERR("unable to set MCLK divider: %i", status);
+                return status;
+        }
+
         status = bofp1_set_integration_time(dev, cfg->integration_time_dt);
         if (status != 0) {
                 LOG_ERR("unable to set integration time: %i", status);
@@ -516,6 +1258,11 @@ static int bofp1_init(const struct device *dev)
                 return status;
         }
 
+        status = bofp1_set_dc_frames(dev, cfg->dc_frames_dt);
+        if (status != 0) {
+                return status;
+        }
+
         status = bofp1_set_moving_avg_n(dev, cfg->moving_avg_n_dt);
         if (status != 0) {
                 return status;
@@ -526,6 +1273,13 @@ static int bofp1_init(const struct device *dev)
                 return status;
         }
 
+        status = bofp1_update_prc(
+                dev, 1 << BOFP1_PRC_FRAME_BUF,
+                cfg->frame_buf_dt ? 1 << BOFP1_PRC_FRAME_BUF : 0);
+        if (status != 0) {
+                return status;
+        }
+
         return 0;
 }
 
@@ -550,7 +1304,13 @@ static int bofp1_init(const struct device *dev)
                 .totavg_dt = DT_INST_PROP(inst_, total_avg),                   \
                 .movavg_dt = DT_INST_PROP(inst_, moving_avg),                  \
                 .dc_dt = DT_INST_PROP(inst_, dark_current),                    \
+                .frame_buf_dt = DT_INST_PROP(inst_, frame_buffer),             \
+                .dc_policy_dt = DT_INST_ENUM_IDX(inst_, dark_current_policy),  \
+                .dc_max_age_dt = DT_INST_PROP(inst_, dark_current_max_age),    \
+                .dc_frames_dt = DT_INST_PROP(inst_, dark_current_frames),      \
+                .trigger_timeout_dt = DT_INST_PROP(inst_, trigger_timeout),    \
                 .light = DEVICE_DT_GET(DT_INST_PHANDLE(inst_, light)),         \
+                .light_linger = DT_INST_PROP(inst_, light_linger),             \
         };                                                                     \
         static struct bofp1_data bofp1_data_##inst_##__ = {                    \
                 .iodev_bus = &bofp1_iodev_##inst_##__,                         \
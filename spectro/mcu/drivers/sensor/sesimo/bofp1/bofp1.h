@@ -6,12 +6,18 @@
 #include <zephyr/drivers/spi.h>
 #include <zephyr/drivers/gpio.h>
 
+#include <drivers/sensor/bofp1.h>
+
 #define BOFP1_REG_OFFSET (0)
 #define BOFP1_REG_BIT_WR (1 << 7)
+/* Burst of consecutive registers, with the length in the following byte */
+#define BOFP1_REG_BIT_BURST (1 << 6)
 
 #define BOFP1_READ_REG(r)  (r << BOFP1_REG_OFFSET)
 #define BOFP1_WRITE_REG(r) ((r << BOFP1_REG_OFFSET) | BOFP1_REG_BIT_WR)
 
+/* Stream raw CCD data for entirety of transmission */
+#define BOFP1_REG_STREAM_RAW   (0x0)
 /* Stream pipeline data for entirety of transmission */
 #define BOFP1_REG_STREAM       (0x1)
 #define BOFP1_REG_SAMPLE       (0x2) /* Begin sample. Write only */
@@ -25,17 +31,101 @@
 #define BOFP1_REG_STATUS       (0xa) /* Status register */
 #define BOFP1_REG_DC_CALIB     (0xb) /* Trigger DC calibration*/
 #define BOFP1_REG_FLUSH        (0xc) /* Flush CCD array */
+#define BOFP1_REG_STREAM_STATS (0xd) /* Stream statistics of last frame */
+#define BOFP1_REG_ROI_START1   (0xe) /* 16bit first pixel of ROI MSB byte 0 */
+#define BOFP1_REG_ROI_START2   (0xf) /* 16bit first pixel of ROI MSB byte 1 */
+#define BOFP1_REG_ROI_LEN1     (0x10) /* 16bit pixels in ROI MSB byte 0 */
+#define BOFP1_REG_ROI_LEN2     (0x11) /* 16bit pixels in ROI MSB byte 1 */
+#define BOFP1_REG_BIN          (0x12) /* Pixel binning */
+#define BOFP1_REG_SPI_LANES    (0x13) /* log2 of stream data lanes */
+/* Stream pipeline data with a header and CRC, see BOFP1_FRAME_* */
+#define BOFP1_REG_STREAM_FRAMED (0x14)
+/* Start of captures, enum bofp1_capture_mode */
+#define BOFP1_REG_CAPTURE_MODE  (0x15)
+#define BOFP1_REG_MCLK_DIV      (0x16) /* MCLK period in clock cycles */
+/* FIFO watermark in units of BOFP1_FIFO_WMARK_UNIT words */
+#define BOFP1_REG_FIFO_WMARK    (0x17)
+/* FIR taps in place of the moving average, 0 for the boxcar average */
+#define BOFP1_REG_FIR_TAPS      (0x18)
+#define BOFP1_REG_DC_SLOT       (0x19) /* Dark current map in use */
+/* Dark frames averaged by a calibration, 0 for the total average */
+#define BOFP1_REG_DC_FRAMES     (0x1a)
+#define BOFP1_REG_FIR_ADDR      (0x1b) /* Index of the FIR coefficient */
+#define BOFP1_REG_FIR_COEF1     (0x1c) /* 16bit FIR coefficient MSB byte 0 */
+/* 16bit FIR coefficient MSB byte 1. Writing it stores the coefficient */
+#define BOFP1_REG_FIR_COEF2     (0x1d)
 
 #define BOFP1_PRC_WMARK_SRC  (0x0)
 #define BOFP1_PRC_BUSY_SRC   (0x1)
 #define BOFP1_PRC_TOTAVG_ENA (0x2)
 #define BOFP1_PRC_MOVAVG_ENA (0x3)
 #define BOFP1_PRC_DC_ENA     (0x4)
+#define BOFP1_PRC_STATS_ONLY (0x5)
+#define BOFP1_PRC_BIN_ENA    (0x6)
+#define BOFP1_PRC_FRAME_BUF  (0x7)
+
+/* Errors of the status register */
+#define BOFP1_ERR_FIFO_PL_OVERFLOW  (0x2)
+#define BOFP1_ERR_FIFO_PL_UNDERFLOW (0x3)
+
+#define BOFP1_BIN_SHIFT_MASK (0x3) /* log2 of pixels per bin */
+#define BOFP1_BIN_SUM        (0x2) /* Sum instead of average */
+
+/* Min, max, argmax, sum (32 bit) and saturated count as big endian words */
+#define BOFP1_STATS_SIZE (12)
+
+/* Sequence and payload length (words) as big endian words */
+#define BOFP1_FRAME_HDR_SIZE (4)
+/* CRC-16/CCITT-FALSE over the header and payload, then the status sampled
+ * after the payload, as big endian words */
+#define BOFP1_FRAME_TRL_SIZE (4)
+#define BOFP1_FRAME_CRC_INIT (0xffff)
+
+/* Shadow register file, the span of registers holding the configuration.
+ * Registers in between that are not configuration read back as 0. */
+#define BOFP1_REGS_FIRST   (BOFP1_REG_CCD_SH1)
+#define BOFP1_REGS_LAST    (BOFP1_REG_DC_FRAMES)
+#define BOFP1_REGS_LEN     (BOFP1_REGS_LAST - BOFP1_REGS_FIRST + 1)
+#define BOFP1_REGS_IDX(r)  ((r) - BOFP1_REGS_FIRST)
 
 #define BOFP1_NUM_ELEMENTS (3648)
 
-#define BOFP1_BUSY     (0) /* Sensor busy */
-#define BOFP1_DC_CALIB (1) /* In DC calib */
+/* MCLK frequency range of the CCD (Hz) */
+#define BOFP1_MCLK_FREQ_MIN (800000)
+#define BOFP1_MCLK_FREQ_MAX (4000000)
+
+/* Words in the raw and pipeline FIFOs */
+#define BOFP1_FIFO_SIZE       (1024)
+#define BOFP1_FIFO_WMARK_UNIT (16)
+
+/* Dark current maps held by the FPGA */
+#define BOFP1_DC_SLOTS (4)
+
+#define BOFP1_BUSY       (0) /* Sensor busy */
+#define BOFP1_DC_CALIB   (1) /* In DC calib */
+#define BOFP1_STREAMING  (2) /* Streaming session active */
+#define BOFP1_LIGHT      (3) /* Light session held by the driver */
+#define BOFP1_AE_PENDING (4) /* SH divider changed by the auto exposure */
+#define BOFP1_CAPTURING  (5) /* FPGA starts captures by itself */
+
+#if defined(CONFIG_BOFP1_STATS)
+struct bofp1_stats {
+        struct k_spinlock lock;
+        /* Phases in progress, bitmask of enum bofp1_phase */
+        uint32_t active;
+        uint64_t start[BOFP1_PHASE_COUNT];
+        struct bofp1_phase_stats phase[BOFP1_PHASE_COUNT];
+};
+#endif
+
+/* Dark current map on the FPGA, keyed by the integration time */
+struct bofp1_dc_map {
+        /* SH and MCLK dividers the map belongs to */
+        uint32_t shdiv;
+        uint8_t clkdiv;
+        bool valid;
+        int64_t timestamp;
+};
 
 struct bofp1_cfg {
         uint8_t clkdiv;
@@ -46,6 +136,12 @@ struct bofp1_cfg {
         bool totavg_dt;
         bool dc_dt;
         bool movavg_dt;
+        bool frame_buf_dt;
+        uint8_t dc_policy_dt;
+        uint32_t dc_max_age_dt;
+        uint8_t dc_frames_dt;
+        uint32_t trigger_timeout_dt;
+        uint32_t light_linger;
 
         struct spi_dt_spec bus;
         struct gpio_dt_spec busy_gpios;
@@ -55,14 +151,59 @@ struct bofp1_cfg {
 };
 
 struct bofp1_data {
+        uint8_t clkdiv;
         uint8_t shdiv[3];
         uint8_t total_avg_n;
         uint8_t moving_avg_n;
+        /* FIR taps, replacing the moving average when non-zero */
+        uint8_t fir_taps;
 
         uint8_t prc;
+        uint8_t bin;
+
+        /* Read the raw frame along with the processed one */
+        bool dual;
+
+        /* Words per FIFO chunk read, chosen by the driver when 0 */
+        uint16_t read_chunk;
+
+        /* Region of interest on the pipeline output, all pixels when the
+         * length is 0 */
+        uint16_t roi_start;
+        uint16_t roi_len;
+
+        /* Target peak of the auto exposure (counts), 0 when disabled */
+        uint16_t ae_target;
+
+        /* Dark current calibration policy */
+        enum bofp1_dc_policy dc_policy;
+        uint32_t dc_max_age;
+        /* Dark frames averaged by a calibration, 0 for the total average */
+        uint8_t dc_frames;
+        struct bofp1_dc_map dc_maps[BOFP1_DC_SLOTS];
+        /* Map of the current integration time */
+        uint8_t dc_slot;
+
+        /* Only applied while streaming */
+        enum bofp1_capture_mode capture_mode;
+        /* Max wait for an external trigger (ms). 0 = no limit */
+        uint32_t trigger_timeout;
+
+        /* Configuration registers as written to the FPGA, packed from the
+         * fields above */
+        uint8_t regs[BOFP1_REGS_LEN];
 
         /* Status on FPGA */
         uint8_t status_raw;
+        uint8_t stats_raw[BOFP1_STATS_SIZE];
+
+        /* Framing of the last pipeline chunk, checked once it is read */
+        uint8_t frame_hdr[BOFP1_FRAME_HDR_SIZE];
+        uint8_t frame_trl[BOFP1_FRAME_TRL_SIZE];
+        uint8_t *frame_buf;
+        size_t frame_len;
+        bool frame_first;
+        uint16_t frame_seq;
 
         struct gpio_callback busy_fall_cb;
         struct gpio_callback fifo_w_cb;
@@ -72,31 +213,147 @@ struct bofp1_data {
         const struct device *dev;
 
         struct rtio_iodev_sqe *iodev_sqe;
+        /* Multishot sqe of the stream in progress */
+        struct rtio_iodev_sqe *stream_sqe;
         struct rtio *rtio_ctx;
 
+        /* Header of the frame in progress. Copied into the buffer when the
+         * readout completes. */
+        struct bofp1_rtio_header header;
+
         struct rtio_iodev *iodev_bus;
 
         uint8_t *wr_buf;
         size_t wr_index;
+        size_t raw_index;
 
         struct k_sem lock;
 
         struct k_work_delayable watchdog_work;
         struct k_work_delayable light_wait_work;
+        struct k_work_delayable light_linger_work;
+        /* Retries a stream frame once the reader may have released a
+         * buffer */
+        struct k_work_delayable buf_wait_work;
+
+        /* Time for the light to settle after being toggled */
+        k_timeout_t light_settle;
 
         atomic_t state;
         atomic_t status;
+
+#if defined(CONFIG_BOFP1_STATS)
+        struct bofp1_stats stats;
+#endif
 };
 
 struct bofp1_rtio_header {
         size_t frames;
+        /* Raw pixels following the processed ones in a dual readout */
+        size_t raw_frames;
+        /* Buffer was produced by a stream on frame completion */
+        bool stream;
+
+        /* Snapshot of the settings and status of the sample */
+        uint8_t prc;
+        uint8_t moving_avg_n;
+        uint8_t total_avg_n;
+        uint8_t bin;
+        uint8_t status;
+        /* Index of the first pixel in the frame */
+        uint16_t roi_start;
+        uint32_t integration_time;
+        /* Uptime in ticks when the sample was started. The 32 bit cycle
+         * counter of some SoCs wraps within a minute. */
+        uint64_t timestamp;
+        /* Frame statistics as read from the FPGA */
+        uint8_t stats[BOFP1_STATS_SIZE];
 };
 
+/* Shortest integration time chosen by the auto exposure */
+#define BOFP1_AE_MIN_TIME_NS (10000)
+/* Largest factor the integration time changes by between two frames */
+#define BOFP1_AE_MAX_STEP (8)
+/* A peak within target / 2^n of the target keeps the integration time */
+#define BOFP1_AE_HYST_SHIFT (4)
+
+/**
+ * @brief Next SH period chosen by the auto exposure
+ *
+ * @param cur Current SH period, in MCLK cycles
+ * @param peak Peak pixel of the last frame
+ * @param saturated Number of saturated pixels in the last frame
+ * @param target Target peak
+ * @param min Shortest SH period
+ * @param max Longest SH period
+ *
+ * @return The next SH period within [min, max], or cur when the peak is
+ * close enough to the target
+ */
+static inline uint32_t bofp1_ae_next(uint32_t cur, uint32_t peak,
+                                     uint32_t saturated, uint32_t target,
+                                     uint32_t min, uint32_t max)
+{
+        uint64_t next;
+
+        if (saturated != 0) {
+                /* The peak is clipped, so it only tells that the exposure
+                 * is too long */
+                next = cur / BOFP1_AE_MAX_STEP;
+        } else if (peak * BOFP1_AE_MAX_STEP <= target) {
+                next = (uint64_t)cur * BOFP1_AE_MAX_STEP;
+        } else if ((peak > target ? peak - target : target - peak) <=
+                   (target >> BOFP1_AE_HYST_SHIFT)) {
+                return cur;
+        } else {
+                /* The response of the CCD is linear in the exposure */
+                next = (uint64_t)cur * target / peak;
+        }
+
+        return CLAMP(next, min, max);
+}
+
+static inline uint64_t bofp1_cycles(void)
+{
+#if defined(CONFIG_TIMER_HAS_64BIT_CYCLE_COUNTER)
+        return k_cycle_get_64();
+#else
+        return k_cycle_get_32();
+#endif
+}
+
+#if defined(CONFIG_BOFP1_STATS)
+void bofp1_stats_begin(const struct device *dev, enum bofp1_phase phase);
+
+void bofp1_stats_end(const struct device *dev, enum bofp1_phase phase);
+
+void bofp1_stats_cancel(const struct device *dev);
+#else
+static inline void bofp1_stats_begin(const struct device *dev,
+                                     enum bofp1_phase phase)
+{
+}
+
+static inline void bofp1_stats_end(const struct device *dev,
+                                   enum bofp1_phase phase)
+{
+}
+
+static inline void bofp1_stats_cancel(const struct device *dev)
+{
+}
+#endif
+
 int bofp1_rtio_init(const struct device *dev);
 
 int bofp1_access(const struct device *dev, bool write, uint8_t addr, void *data,
                  size_t size);
 
+int bofp1_burst(const struct device *dev, bool write, uint8_t addr, void *data,
+                size_t size);
+
+void bofp1_regs_pack(const struct device *dev);
+
 int bofp1_write_reg(const struct device *dev, uint8_t addr, uint8_t value);
 
 int bofp1_stream(const struct device *dev, void *data, size_t size);
@@ -105,6 +362,20 @@ int bofp1_read_reg(const struct device *dev, uint8_t addr, uint8_t *value);
 
 uint8_t bofp1_get_prc(const struct device *dev, unsigned int bit);
 
+uint32_t bofp1_integration_time(const struct device *dev);
+
+size_t bofp1_read_chunk(const struct device *dev);
+
+void bofp1_ae_update(const struct device *dev);
+
+void bofp1_dc_invalidate(const struct device *dev);
+
+void bofp1_dc_select(const struct device *dev);
+
+bool bofp1_dc_expired(const struct device *dev);
+
+k_timeout_t bofp1_flush_time(const struct device *dev);
+
 void bofp1_submit(const struct device *dev, struct rtio_iodev_sqe *sqe);
 
 int bofp1_get_decoder(const struct device *dev,
@@ -2,6 +2,10 @@
 #include <zephyr/drivers/sensor.h>
 #include <zephyr/sys/byteorder.h>
 
+#if defined(CONFIG_ARM)
+#include <cmsis_core.h>
+#endif
+
 #include <drivers/sensor/bofp1.h>
 
 #include "bofp1.h"
@@ -15,45 +19,206 @@ static q31_t to_q31(uint16_t value, int shift)
         return CLAMP(shifted, INT32_MIN, INT32_MAX);
 }
 
+static bool bofp1_is_intensity(struct sensor_chan_spec chan)
+{
+        return (chan.chan_type ==
+                        (enum sensor_channel)SENSOR_CHAN_BOFP1_INTENSITY ||
+                chan.chan_type ==
+                        (enum sensor_channel)SENSOR_CHAN_BOFP1_INTENSITY_U16) &&
+               chan.chan_idx <= 1;
+}
+
+/** @brief Get the pixels of the processed or raw frame in the buffer */
+static const uint8_t *bofp1_pixels(const uint8_t *buf,
+                                   const struct bofp1_rtio_header *header,
+                                   struct sensor_chan_spec chan, size_t *count)
+{
+        const uint8_t *ptr = buf + sizeof(*header);
+
+        if (chan.chan_idx == 1) {
+                *count = header->raw_frames;
+                return ptr + header->frames * sizeof(uint16_t);
+        }
+
+        *count = header->frames;
+        return ptr;
+}
+
+static bool bofp1_is_meta(struct sensor_chan_spec chan)
+{
+        return chan.chan_type == (enum sensor_channel)SENSOR_CHAN_BOFP1_META &&
+               chan.chan_idx == 0;
+}
+
+static bool bofp1_is_stats(struct sensor_chan_spec chan)
+{
+        return chan.chan_type ==
+                       (enum sensor_channel)SENSOR_CHAN_BOFP1_STATS &&
+               chan.chan_idx == 0;
+}
+
+static int bofp1_decode_stats(const struct bofp1_rtio_header *header,
+                              uint32_t *fit, struct bofp1_frame_stats *stats)
+{
+        if (*fit > 0) {
+                return 0;
+        }
+
+        stats->min = sys_get_be16(&header->stats[0]);
+        stats->max = sys_get_be16(&header->stats[2]);
+        stats->argmax = sys_get_be16(&header->stats[4]);
+        stats->sum = sys_get_be32(&header->stats[6]);
+        stats->saturated = sys_get_be16(&header->stats[10]);
+
+        *fit = 1;
+
+        return 1;
+}
+
+static int bofp1_decode_meta(const struct bofp1_rtio_header *header,
+                             uint32_t *fit, struct bofp1_frame_meta *meta)
+{
+        if (*fit > 0) {
+                return 0;
+        }
+
+        *meta = (struct bofp1_frame_meta){
+                .timestamp = k_ticks_to_ns_floor64(header->timestamp),
+                .integration_time = header->integration_time,
+                .pixels = header->frames,
+                .offset = header->roi_start,
+                .moving_avg_n = header->moving_avg_n,
+                .total_avg_n = header->total_avg_n,
+                .status = header->status,
+        };
+
+        if (header->prc & BIT(BOFP1_PRC_DC_ENA)) {
+                meta->flags |= BOFP1_META_DC;
+        }
+        if (header->prc & BIT(BOFP1_PRC_MOVAVG_ENA)) {
+                meta->flags |= BOFP1_META_MOVAVG;
+        }
+        if (header->prc & BIT(BOFP1_PRC_TOTAVG_ENA)) {
+                meta->flags |= BOFP1_META_TOTAVG;
+        }
+        if (header->prc & BIT(BOFP1_PRC_BIN_ENA)) {
+                meta->bin = 1 << (header->bin & BOFP1_BIN_SHIFT_MASK);
+        } else {
+                meta->bin = 1;
+        }
+        if (header->bin & BIT(BOFP1_BIN_SUM)) {
+                meta->flags |= BOFP1_META_BIN_SUM;
+        }
+
+        *fit = 1;
+
+        return 1;
+}
+
+/** @brief Copy big endian pixels from the FPGA to CPU byte order */
+static void bofp1_copy_be16(uint16_t *dst, const uint8_t *src, size_t count)
+{
+#if defined(CONFIG_ARM) && !defined(CONFIG_BIG_ENDIAN)
+        /* REV16 swaps the bytes of both halfwords in a word, so two pixels
+         * are converted per instruction. */
+        for (; count >= 2; count -= 2) {
+                UNALIGNED_PUT(__REV16(UNALIGNED_GET((const uint32_t *)src)),
+                              (uint32_t *)dst);
+                src += sizeof(uint32_t);
+                dst += 2;
+        }
+#endif
+
+        for (; count > 0; count--) {
+                UNALIGNED_PUT(sys_get_be16(src), dst);
+                src += sizeof(uint16_t);
+                dst++;
+        }
+}
+
 static int bofp1_decode(const uint8_t *buf, struct sensor_chan_spec chan,
                         uint32_t *fit, uint16_t max_count, void *data_out)
 {
-        struct sensor_q31_data *data = data_out;
+        struct bofp1_rtio_header header;
+        struct sensor_q31_data *data;
         const uint8_t *ptr;
-        uint16_t value;
+        size_t frames;
+        uint16_t count;
 
-        if (chan.chan_type !=
-                    (enum sensor_channel)SENSOR_CHAN_BOFP1_INTENSITY ||
-            chan.chan_idx != 0) {
+        if (!bofp1_is_intensity(chan) && !bofp1_is_meta(chan) &&
+            !bofp1_is_stats(chan)) {
                 return -ENOTSUP;
         }
 
-        if (*fit >= BOFP1_NUM_ELEMENTS) {
+        (void)memcpy(&header, buf, sizeof(header));
+
+        if (bofp1_is_meta(chan) || bofp1_is_stats(chan)) {
+                if (max_count == 0) {
+                        return 0;
+                }
+
+                if (bofp1_is_stats(chan)) {
+                        return bofp1_decode_stats(&header, fit, data_out);
+                }
+
+                return bofp1_decode_meta(&header, fit, data_out);
+        }
+
+        ptr = bofp1_pixels(buf, &header, chan, &frames);
+        if (*fit >= frames) {
                 return 0;
         }
 
-        ptr = buf + sizeof(struct bofp1_rtio_header) + *fit * sizeof(uint16_t);
-        value = sys_get_be16(ptr);
+        count = MIN(max_count, frames - *fit);
+        ptr += *fit * sizeof(uint16_t);
 
-        data->shift = 16;
-        data->readings[0].value = to_q31(value, data->shift);
+        if (chan.chan_type ==
+            (enum sensor_channel)SENSOR_CHAN_BOFP1_INTENSITY_U16) {
+                bofp1_copy_be16(data_out, ptr, count);
+        } else {
+                data = data_out;
+                data->header.reading_count = count;
+                data->shift = 16;
 
-        *fit += 1;
+                for (uint16_t i = 0; i < count; i++) {
+                        data->readings[i].value =
+                                to_q31(sys_get_be16(ptr), data->shift);
+                        ptr += sizeof(uint16_t);
+                }
+        }
 
-        return 1;
+        *fit += count;
+
+        return count;
 }
 
 static int bofp1_get_size_info(struct sensor_chan_spec chan, size_t *base_size,
                                size_t *frame_size)
 {
-        if (chan.chan_type !=
-                    (enum sensor_channel)SENSOR_CHAN_BOFP1_INTENSITY ||
-            chan.chan_idx != 0) {
+        if (bofp1_is_meta(chan)) {
+                *base_size = sizeof(struct bofp1_frame_meta);
+                *frame_size = sizeof(struct bofp1_frame_meta);
+                return 0;
+        }
+
+        if (bofp1_is_stats(chan)) {
+                *base_size = sizeof(struct bofp1_frame_stats);
+                *frame_size = sizeof(struct bofp1_frame_stats);
+                return 0;
+        }
+
+        if (!bofp1_is_intensity(chan)) {
                 return -ENOTSUP;
         }
 
-        *base_size = sizeof(struct sensor_q31_data);
-        *frame_size = sizeof(struct sensor_q31_sample_data);
+        if (chan.chan_type ==
+            (enum sensor_channel)SENSOR_CHAN_BOFP1_INTENSITY_U16) {
+                *base_size = sizeof(uint16_t);
+                *frame_size = sizeof(uint16_t);
+        } else {
+                *base_size = sizeof(struct sensor_q31_data);
+                *frame_size = sizeof(struct sensor_q31_sample_data);
+        }
 
         return 0;
 }
@@ -63,24 +228,40 @@ static int bofp1_get_frame_count(const uint8_t *buf,
                                  uint16_t *frame_count)
 {
         struct bofp1_rtio_header header;
+        size_t frames;
+
+        if (bofp1_is_meta(chan) || bofp1_is_stats(chan)) {
+                *frame_count = 1;
+                return 0;
+        }
 
-        if (chan.chan_type !=
-                    (enum sensor_channel)SENSOR_CHAN_BOFP1_INTENSITY ||
-            chan.chan_idx != 0) {
+        if (!bofp1_is_intensity(chan)) {
                 return -ENOTSUP;
         }
 
         (void)memcpy(&header, buf, sizeof(header));
 
-        /* Driver currently only supports a full, constant-length readout */
-        *frame_count = header.frames;
+        (void)bofp1_pixels(buf, &header, chan, &frames);
+        *frame_count = frames;
         return 0;
 }
 
+static bool bofp1_has_trigger(const uint8_t *buf,
+                              enum sensor_trigger_type trigger)
+{
+        struct bofp1_rtio_header header;
+
+        (void)memcpy(&header, buf, sizeof(header));
+
+        /* Every streamed buffer holds exactly one complete frame */
+        return header.stream && trigger == SENSOR_TRIG_DATA_READY;
+}
+
 SENSOR_DECODER_API_DT_DEFINE() = {
         .decode = bofp1_decode,
         .get_size_info = bofp1_get_size_info,
         .get_frame_count = bofp1_get_frame_count,
+        .has_trigger = bofp1_has_trigger,
 };
 
 int bofp1_get_decoder(const struct device *dev,
@@ -3,6 +3,8 @@
 #include <zephyr/rtio/work.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/drivers/sensor.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
 
 #include <drivers/light.h>
 
@@ -10,22 +12,108 @@
 
 LOG_MODULE_DECLARE(sesimo_bofp1);
 
-#define READ_CHUNK_SIZE (1024 * sizeof(uint16_t))
-#define LIGHT_TIMEOUT   (K_MSEC(300))
+/* Retry period of a lingering light release while the driver is locked */
+#define BOFP1_LINGER_RETRY_MS (10)
+/* Retry period of a stream waiting for the reader to release a buffer */
+#define BOFP1_BUF_RETRY_MS (1)
 
 static void bofp1_finish(const struct device *dev, int status);
 
 static void bofp1_rtio_err(struct rtio *r, const struct rtio_sqe *sqe,
                            void *dev_arg);
 
+static k_timeout_t bofp1_max_timeout(k_timeout_t a, k_timeout_t b)
+{
+        return a.ticks > b.ticks ? a : b;
+}
+
+/**
+ * @brief Hold or release the light session of the driver
+ *
+ * @param dev
+ * @param on true to hold the light on, false to release it
+ * @param settle Time to wait for the light to settle
+ * @return int
+ * @retval 0 Success
+ * @retval <0 Negative errno code
+ */
+static int bofp1_light(const struct device *dev, bool on, k_timeout_t *settle)
+{
+        int status;
+        const struct bofp1_cfg *cfg = dev->config;
+        struct bofp1_data *data = dev->data;
+
+        *settle = K_NO_WAIT;
+
+        if (on == atomic_test_bit(&data->state, BOFP1_LIGHT)) {
+                return 0;
+        }
+
+        if (on) {
+                status = light_session_get(cfg->light);
+        } else {
+                status = light_session_put(cfg->light);
+        }
+
+        if (status < 0) {
+                return status;
+        }
+
+        atomic_set_bit_to(&data->state, BOFP1_LIGHT, on);
+        if (status > 0) {
+                *settle = data->light_settle;
+        }
+
+        return 0;
+}
+
+/** @brief Size of the raw frame read along with a dual readout */
+static inline size_t bofp1_raw_frame_size(const struct device *dev)
+{
+        struct bofp1_data *data = dev->data;
+
+        return data->dual ? BOFP1_NUM_ELEMENTS * sizeof(uint16_t) : 0;
+}
+
+/** @brief Pixels of a frame lost to the window of the moving average */
+static size_t bofp1_window(const struct device *dev)
+{
+        struct bofp1_data *data = dev->data;
+
+        if (!bofp1_get_prc(dev, BOFP1_PRC_MOVAVG_ENA)) {
+                return 0;
+        }
+
+        if (data->fir_taps != 0) {
+                return data->fir_taps - 1;
+        }
+
+        return data->moving_avg_n * 2 + 1;
+}
+
 static inline size_t bofp1_frame_size(const struct device *dev)
 {
         struct bofp1_data *data = dev->data;
         size_t ret;
 
-        ret = BOFP1_NUM_ELEMENTS;
-        if (bofp1_get_prc(dev, BOFP1_PRC_MOVAVG_ENA)) {
-                ret -= data->moving_avg_n * 2 + 1;
+        /* Only the statistics are read out */
+        if (bofp1_get_prc(dev, BOFP1_PRC_STATS_ONLY)) {
+                return 0;
+        }
+
+        ret = BOFP1_NUM_ELEMENTS - bofp1_window(dev);
+
+        /* A partial bin at the end of the frame is dropped */
+        if (bofp1_get_prc(dev, BOFP1_PRC_BIN_ENA)) {
+                ret >>= data->bin & BOFP1_BIN_SHIFT_MASK;
+        }
+
+        /* The FPGA only writes the pixels inside the region of interest,
+         * which may be cut short by the moving average */
+        if (data->roi_len != 0) {
+                ret = data->roi_start < ret ?
+                              MIN(data->roi_len, ret - data->roi_start) :
+                              0;
         }
 
         return ret * sizeof(uint16_t);
@@ -46,7 +134,7 @@ static void bofp1_dc_calib_done(struct rtio_iodev_sqe *iodev_sqe)
         const struct sensor_read_config *config = iodev_sqe->sqe.iodev->data;
         const struct device *dev = config->sensor;
         struct bofp1_data *data = dev->data;
-        const struct bofp1_cfg *cfg = dev->config;
+        k_timeout_t settle;
 
         /* Busy should be cleared by the ISR/GPIO callback, before submitting
          * this callback to the work queue. If it is set, something strange
@@ -57,51 +145,105 @@ static void bofp1_dc_calib_done(struct rtio_iodev_sqe *iodev_sqe)
                 return;
         }
 
-        status = light_on(cfg->light);
+        bofp1_stats_end(dev, BOFP1_PHASE_DC_CALIB);
+        bofp1_stats_begin(dev, BOFP1_PHASE_LIGHT);
+
+        data->dc_maps[data->dc_slot].valid = true;
+        data->dc_maps[data->dc_slot].timestamp = k_uptime_get();
+
+        status = bofp1_light(dev, true, &settle);
         if (status != 0) {
                 bofp1_finish(dev, status);
                 return;
         }
 
-        k_work_reschedule(&data->light_wait_work, LIGHT_TIMEOUT);
+        k_work_reschedule(&data->light_wait_work, settle);
 
         LOG_INF("dc calibration done");
 }
 
+/** @brief Start a sample or DC calibration and wait for the readout */
+static int bofp1_begin(const struct device *dev, uint8_t reg)
+{
+        int status;
+        const struct bofp1_cfg *cfg = dev->config;
+        struct bofp1_data *data = dev->data;
+        struct rtio_sqe *sqe;
+        uint8_t cmd[2];
+
+        status = bofp1_enable_read(dev);
+        if (status != 0) {
+                return status;
+        }
+
+        atomic_set_bit(&data->state, BOFP1_BUSY);
+
+        if (reg == BOFP1_REG_SAMPLE) {
+                data->header.timestamp = k_uptime_ticks();
+                bofp1_stats_begin(dev, BOFP1_PHASE_SAMPLE);
+        } else {
+                bofp1_stats_begin(dev, BOFP1_PHASE_DC_CALIB);
+        }
+
+        cmd[0] = BOFP1_WRITE_REG(reg);
+        cmd[1] = 0;
+
+        /* In a stream, the FPGA is left to start the captures after the
+         * first one, and the driver only waits for the next frame in the
+         * frame buffer. The timestamp is then the time the readout is
+         * armed. */
+        if (reg == BOFP1_REG_SAMPLE &&
+            data->capture_mode != BOFP1_CAPTURE_SINGLE &&
+            atomic_test_bit(&data->state, BOFP1_STREAMING)) {
+                if (atomic_test_and_set_bit(&data->state, BOFP1_CAPTURING)) {
+                        /* The edge may have passed while the frame was
+                         * waiting */
+                        if (gpio_pin_get_dt(&cfg->fifo_w_gpios) > 0) {
+                                bofp1_rtio_read(dev);
+                        }
+
+                        return 0;
+                }
+
+                cmd[0] = BOFP1_WRITE_REG(BOFP1_REG_CAPTURE_MODE);
+                cmd[1] = data->capture_mode;
+        }
+
+        sqe = rtio_sqe_acquire(data->rtio_ctx);
+        __ASSERT_NO_MSG(sqe != NULL);
+
+        rtio_sqe_prep_tiny_write(sqe, data->iodev_bus, RTIO_PRIO_NORM, cmd,
+                                 sizeof(cmd), NULL);
+        rtio_submit(data->rtio_ctx, 0);
+
+        return 0;
+}
+
 static void bofp1_light_ready(struct rtio_iodev_sqe *iodev_sqe)
 {
         int status;
         const struct sensor_read_config *config = iodev_sqe->sqe.iodev->data;
         const struct device *dev = config->sensor;
         struct bofp1_data *data = dev->data;
-        struct rtio_sqe *sqe;
-        uint8_t reg[2];
+        uint8_t reg;
+
+        bofp1_stats_end(dev, BOFP1_PHASE_FLUSH);
+        bofp1_stats_end(dev, BOFP1_PHASE_LIGHT);
 
         if (atomic_test_bit(&data->state, BOFP1_DC_CALIB)) {
-                reg[0] = BOFP1_WRITE_REG(BOFP1_REG_DC_CALIB);
+                reg = BOFP1_REG_DC_CALIB;
 
                 LOG_INF("begin dc calibration");
         } else {
-                reg[0] = BOFP1_WRITE_REG(BOFP1_REG_SAMPLE);
+                reg = BOFP1_REG_SAMPLE;
 
                 LOG_INF("begin sampling");
         }
 
-        status = bofp1_enable_read(dev);
+        status = bofp1_begin(dev, reg);
         if (status != 0) {
                 bofp1_finish(dev, status);
-                return;
         }
-
-        atomic_set_bit(&data->state, BOFP1_BUSY);
-
-        sqe = rtio_sqe_acquire(data->rtio_ctx);
-        __ASSERT_NO_MSG(sqe != NULL);
-
-        reg[1] = 0;
-        rtio_sqe_prep_tiny_write(sqe, data->iodev_bus, RTIO_PRIO_NORM, reg,
-                                 sizeof(reg), NULL);
-        rtio_submit(data->rtio_ctx, 0);
 }
 
 static void bofp1_light_ready_work(struct k_work *work)
@@ -116,40 +258,191 @@ static void bofp1_light_ready_work(struct k_work *work)
         rtio_work_req_submit(req, data->iodev_sqe, bofp1_light_ready);
 }
 
-static void bofp1_submit_fetch(struct rtio_iodev_sqe *iodev_sqe)
+/** @brief Size of the RTIO buffer of a frame, including the header */
+static size_t bofp1_buf_size(const struct device *dev)
+{
+        return sizeof(struct bofp1_rtio_header) + bofp1_frame_size(dev) +
+               bofp1_raw_frame_size(dev);
+}
+
+/** @brief Allocate the RTIO buffer for a frame and prepare for readout */
+static int bofp1_prepare(const struct device *dev,
+                         struct rtio_iodev_sqe *iodev_sqe)
 {
         int status;
         const struct sensor_read_config *config = iodev_sqe->sqe.iodev->data;
-        const struct device *dev = config->sensor;
         struct bofp1_data *data = dev->data;
-        const struct bofp1_cfg *cfg = dev->config;
         size_t req_len;
         size_t real_len;
-        struct bofp1_rtio_header header;
+        struct bofp1_rtio_header *header = &data->header;
+
+        req_len = bofp1_buf_size(dev);
+
+        status = rtio_sqe_rx_buf(iodev_sqe, req_len, req_len, &data->wr_buf,
+                                 &real_len);
+        if (status != 0) {
+                return status;
+        }
+
+        *header = (struct bofp1_rtio_header){
+                .frames = bofp1_frame_size(dev) / 2,
+                .raw_frames = bofp1_raw_frame_size(dev) / 2,
+                .stream = config->is_streaming,
+                .prc = data->prc,
+                .moving_avg_n = data->moving_avg_n,
+                .total_avg_n = data->total_avg_n,
+                .bin = data->bin,
+                .roi_start = data->roi_start,
+                .integration_time = bofp1_integration_time(dev),
+        };
+
+        atomic_set(&data->status, 0);
+
+        data->iodev_sqe = iodev_sqe;
+        data->wr_index = 0;
+        data->raw_index = 0;
+        data->frame_len = 0;
+
+        return 0;
+}
+
+/**
+ * @brief Queue a write that returns the FPGA to single captures
+ *
+ * @param dev
+ * @return bool
+ * @retval true The write was queued
+ * @retval false The FPGA was not capturing by itself
+ */
+static bool bofp1_prep_capture_stop(const struct device *dev)
+{
+        struct bofp1_data *data = dev->data;
+        struct rtio_sqe *sqe;
+        uint8_t cmd[2];
+
+        if (!atomic_test_and_clear_bit(&data->state, BOFP1_CAPTURING)) {
+                return false;
+        }
+
+        sqe = rtio_sqe_acquire(data->rtio_ctx);
+        __ASSERT_NO_MSG(sqe != NULL);
+
+        cmd[0] = BOFP1_WRITE_REG(BOFP1_REG_CAPTURE_MODE);
+        cmd[1] = BOFP1_CAPTURE_SINGLE;
+
+        rtio_sqe_prep_tiny_write(sqe, data->iodev_bus, RTIO_PRIO_HIGH, cmd,
+                                 sizeof(cmd), NULL);
+
+        return true;
+}
+
+/**
+ * @brief End the stream state, stop the FPGA captures and release the light
+ *
+ * @param dev
+ * @param linger Let the light linger, rather than turning it off now
+ */
+static void bofp1_stream_end(const struct device *dev, bool linger)
+{
+        const struct bofp1_cfg *cfg = dev->config;
+        struct bofp1_data *data = dev->data;
+        k_timeout_t settle;
+
+        atomic_clear_bit(&data->state, BOFP1_STREAMING);
+        data->stream_sqe = NULL;
+
+        if (bofp1_prep_capture_stop(dev)) {
+                rtio_submit(data->rtio_ctx, 0);
+        }
+
+        if (linger && cfg->light_linger != 0) {
+                k_work_reschedule(&data->light_linger_work,
+                                  K_MSEC(cfg->light_linger));
+        } else {
+                (void)bofp1_light(dev, false, &settle);
+        }
+}
+
+/** @brief Queue a write of the SH divider chosen by the auto exposure */
+static void bofp1_prep_ae_write(const struct device *dev)
+{
+        struct bofp1_data *data = dev->data;
+        struct rtio_sqe *sqe;
+        uint8_t reg_conf_sh[6];
+        uint8_t reg_dc_slot[2];
+
+        if (!atomic_test_and_clear_bit(&data->state, BOFP1_AE_PENDING)) {
+                return;
+        }
+
+        sqe = rtio_sqe_acquire(data->rtio_ctx);
+        __ASSERT_NO_MSG(sqe != NULL);
+
+        reg_conf_sh[0] = BOFP1_WRITE_REG(BOFP1_REG_CCD_SH1);
+        reg_conf_sh[1] = data->shdiv[0];
+        reg_conf_sh[2] = BOFP1_WRITE_REG(BOFP1_REG_CCD_SH2);
+        reg_conf_sh[3] = data->shdiv[1];
+        reg_conf_sh[4] = BOFP1_WRITE_REG(BOFP1_REG_CCD_SH3);
+        reg_conf_sh[5] = data->shdiv[2];
+
+        rtio_sqe_prep_tiny_write(sqe, data->iodev_bus, RTIO_PRIO_HIGH,
+                                 reg_conf_sh, sizeof(reg_conf_sh), NULL);
+
+        /* The new integration time may have its own dark current map. A
+         * tiny write holds at most 7 bytes, so this takes its own sqe. */
+        sqe = rtio_sqe_acquire(data->rtio_ctx);
+        __ASSERT_NO_MSG(sqe != NULL);
+
+        reg_dc_slot[0] = BOFP1_WRITE_REG(BOFP1_REG_DC_SLOT);
+        reg_dc_slot[1] = data->dc_slot;
+
+        rtio_sqe_prep_tiny_write(sqe, data->iodev_bus, RTIO_PRIO_HIGH,
+                                 reg_dc_slot, sizeof(reg_dc_slot), NULL);
+}
+
+static void bofp1_submit_fetch(struct rtio_iodev_sqe *iodev_sqe)
+{
+        int status;
+        const struct sensor_read_config *config = iodev_sqe->sqe.iodev->data;
+        const struct device *dev = config->sensor;
+        struct bofp1_data *data = dev->data;
         struct rtio_sqe *sqe;
         uint8_t flush_reg[2];
+        k_timeout_t settle;
+
+        /* Set before anything can fail so that bofp1_finish has a sqe to
+         * complete. */
+        data->iodev_sqe = iodev_sqe;
+
+        /* Keep a lingering light on for this sample */
+        (void)k_work_cancel_delayable(&data->light_linger_work);
+
+        bofp1_stats_begin(dev, BOFP1_PHASE_TOTAL);
 
-        status = light_off(cfg->light);
+        status = bofp1_prepare(dev, iodev_sqe);
         if (status != 0) {
                 goto error;
         }
 
-        header.frames = bofp1_frame_size(dev) / 2;
-        req_len = sizeof(header) + bofp1_frame_size(dev);
+        if (data->dc_policy == BOFP1_DC_POLICY_ALWAYS ||
+            bofp1_dc_expired(dev)) {
+                atomic_set_bit(&data->state, BOFP1_DC_CALIB);
+                status = bofp1_light(dev, false, &settle);
+        } else {
+                /* Reuse the calibration stored on the FPGA */
+                status = bofp1_light(dev, true, &settle);
+        }
 
-        status = rtio_sqe_rx_buf(iodev_sqe, req_len, req_len, &data->wr_buf,
-                                 &real_len);
         if (status != 0) {
                 goto error;
         }
 
-        (void)memcpy(data->wr_buf, &header, sizeof(header));
-
-        atomic_set(&data->status, 0);
-        atomic_set_bit(&data->state, BOFP1_DC_CALIB);
+        /* Captures started by the FPGA would refill the frame buffer
+         * behind the flush, and keep the calibration from starting */
+        (void)bofp1_prep_capture_stop(dev);
 
-        data->iodev_sqe = iodev_sqe;
-        data->wr_index = 0;
+        /* The new integration time takes effect with the flush */
+        bofp1_prep_ae_write(dev);
 
         sqe = rtio_sqe_acquire(data->rtio_ctx);
         __ASSERT_NO_MSG(sqe != NULL);
@@ -162,8 +455,10 @@ static void bofp1_submit_fetch(struct rtio_iodev_sqe *iodev_sqe)
 
         rtio_submit(data->rtio_ctx, 0);
 
-        /* The light timeout is more than enough to flush */
-        k_work_reschedule(&data->light_wait_work, LIGHT_TIMEOUT);
+        bofp1_stats_begin(dev, BOFP1_PHASE_FLUSH);
+
+        k_work_reschedule(&data->light_wait_work,
+                          bofp1_max_timeout(settle, bofp1_flush_time(dev)));
 
         return;
 
@@ -171,42 +466,243 @@ error:
         bofp1_finish(dev, status);
 }
 
+static void bofp1_submit_oneshot(struct rtio_iodev_sqe *iodev_sqe)
+{
+        const struct sensor_read_config *config = iodev_sqe->sqe.iodev->data;
+        const struct device *dev = config->sensor;
+        struct bofp1_data *data = dev->data;
+
+        /* A stream cancelled in between frames is never resubmitted. End
+         * it here, so that this sample is not taken as part of it. */
+        if (atomic_test_bit(&data->state, BOFP1_STREAMING)) {
+                LOG_DBG("previous stream ended");
+                bofp1_stream_end(dev, true);
+        }
+
+        bofp1_submit_fetch(iodev_sqe);
+}
+
+/**
+ * @brief Wait for a buffer of the pool when the reader holds all of them
+ *
+ * A multishot sqe is resubmitted as soon as a frame completes, so failing
+ * it would only start over. Waiting instead throttles the stream to the
+ * reader.
+ *
+ * @param dev
+ * @param iodev_sqe
+ * @return bool
+ * @retval true The frame is retried once a buffer may be free
+ * @retval false A buffer is allocated, or the frame can't wait for one
+ */
+static bool bofp1_buf_wait(const struct device *dev,
+                           struct rtio_iodev_sqe *iodev_sqe)
+{
+        struct bofp1_data *data = dev->data;
+        size_t size = bofp1_buf_size(dev);
+        uint8_t *buf;
+        uint32_t len;
+
+        if ((iodev_sqe->sqe.flags & RTIO_SQE_MEMPOOL_BUFFER) == 0 ||
+            (iodev_sqe->sqe.flags & RTIO_SQE_CANCELED) != 0) {
+                return false;
+        }
+
+        if (rtio_sqe_rx_buf(iodev_sqe, size, size, &buf, &len) != -ENOMEM) {
+                return false;
+        }
+
+        k_work_reschedule(&data->buf_wait_work, K_MSEC(BOFP1_BUF_RETRY_MS));
+
+        return true;
+}
+
+static void bofp1_submit_stream(struct rtio_iodev_sqe *iodev_sqe)
+{
+        int status;
+        const struct sensor_read_config *config = iodev_sqe->sqe.iodev->data;
+        const struct device *dev = config->sensor;
+        struct bofp1_data *data = dev->data;
+
+        /* Lock must be held for the entire transmission. It is taken here
+         * rather than in bofp1_submit, since the stream is resubmitted from
+         * the completion of the previous frame, which may run in an ISR. */
+        (void)k_sem_take(&data->lock, K_FOREVER);
+
+        /* A stream cancelled in between frames is never resubmitted, so
+         * its state is left behind until another stream starts */
+        if (atomic_test_bit(&data->state, BOFP1_STREAMING) &&
+            data->stream_sqe != iodev_sqe) {
+                LOG_DBG("previous stream ended");
+                bofp1_stream_end(dev, true);
+        }
+
+        data->stream_sqe = iodev_sqe;
+
+        if (bofp1_buf_wait(dev, iodev_sqe)) {
+                k_sem_give(&data->lock);
+                return;
+        }
+
+        if (!atomic_test_and_set_bit(&data->state, BOFP1_STREAMING) ||
+            atomic_test_bit(&data->state, BOFP1_AE_PENDING) ||
+            bofp1_dc_expired(dev)) {
+                /* First frame of the stream flushes, calibrates and turns on
+                 * the light just like a regular fetch. This is repeated if
+                 * the calibration is invalidated or the integration time is
+                 * changed by the auto exposure during the stream. */
+                bofp1_submit_fetch(iodev_sqe);
+                return;
+        }
+
+        /* The light is still on and the calibration still valid, so the
+         * FPGA can be re-armed straight away. */
+        data->iodev_sqe = iodev_sqe;
+
+        bofp1_stats_begin(dev, BOFP1_PHASE_TOTAL);
+
+        status = bofp1_prepare(dev, iodev_sqe);
+        if (status == 0) {
+                status = bofp1_begin(dev, BOFP1_REG_SAMPLE);
+        }
+
+        if (status != 0) {
+                bofp1_finish(dev, status);
+        }
+}
+
 static void bofp1_finish(const struct device *dev, int status)
 {
         struct bofp1_data *data = dev->data;
         struct rtio_iodev_sqe *sqe = data->iodev_sqe;
-        const struct bofp1_cfg *cfg = dev->config;
 
         data->iodev_sqe = NULL;
         data->wr_buf = NULL;
 
+        /* A stream keeps the light on between frames, until it either fails
+         * or is cancelled. Otherwise the light lingers, so that a burst of
+         * samples does not toggle the light for every frame. */
+        if (!atomic_test_bit(&data->state, BOFP1_STREAMING) || status != 0 ||
+            (sqe->sqe.flags & RTIO_SQE_CANCELED) != 0) {
+                bofp1_stream_end(dev, status == 0);
+        }
+
+        atomic_clear_bit(&data->state, BOFP1_BUSY);
+        atomic_clear_bit(&data->state, BOFP1_DC_CALIB);
+
+        if (status == 0) {
+                bofp1_stats_end(dev, BOFP1_PHASE_TOTAL);
+        }
+
+        bofp1_stats_cancel(dev);
+
+        /* Release before completing, as completing a multishot sqe will
+         * resubmit it for the next frame of the stream. */
+        k_sem_give(&data->lock);
+
         if (status == 0) {
                 rtio_iodev_sqe_ok(sqe, 0);
         } else {
                 rtio_iodev_sqe_err(sqe, status);
         }
 
-        (void)light_off(cfg->light);
-        atomic_clear_bit(&data->state, BOFP1_BUSY);
-        k_sem_give(&data->lock);
-
         LOG_INF("done");
 }
 
+/**
+ * @brief Check the header and trailer of the last framed chunk
+ *
+ * @param dev
+ * @return int
+ * @retval 0 Valid, or no framed chunk was read
+ * @retval -EBADMSG The chunk is corrupted, out of sequence, or the pipeline
+ * FIFO overflowed or underflowed while it was read
+ */
+static int bofp1_frame_check(const struct device *dev)
+{
+        struct bofp1_data *data = dev->data;
+        uint16_t seq;
+        uint16_t len;
+        uint16_t crc;
+        size_t frame_len = data->frame_len;
+
+        if (frame_len == 0) {
+                return 0;
+        }
+
+        data->frame_len = 0;
+
+        crc = crc16_itu_t(BOFP1_FRAME_CRC_INIT, data->frame_hdr,
+                          sizeof(data->frame_hdr));
+        crc = crc16_itu_t(crc, data->frame_buf, frame_len);
+        if (crc != sys_get_be16(&data->frame_trl[0])) {
+                LOG_ERR("frame CRC 0x%04x, expected 0x%04x",
+                        sys_get_be16(&data->frame_trl[0]), crc);
+                return -EBADMSG;
+        }
+
+        seq = sys_get_be16(&data->frame_hdr[0]);
+        len = sys_get_be16(&data->frame_hdr[2]);
+        if (len != frame_len / sizeof(uint16_t)) {
+                LOG_ERR("frame of %u words, expected %zu", len,
+                        frame_len / sizeof(uint16_t));
+                return -EBADMSG;
+        }
+
+        if (!data->frame_first && seq != (uint16_t)(data->frame_seq + 1)) {
+                LOG_ERR("frame sequence %u, expected %u", seq,
+                        (uint16_t)(data->frame_seq + 1));
+                return -EBADMSG;
+        }
+
+        data->frame_seq = seq;
+        data->status_raw = data->frame_trl[3];
+
+        /* The CRC is computed over the data as it was sent, so a chunk
+         * drained from a FIFO in error still passes it */
+        if ((data->status_raw & (BIT(BOFP1_ERR_FIFO_PL_OVERFLOW) |
+                                 BIT(BOFP1_ERR_FIFO_PL_UNDERFLOW))) != 0) {
+                LOG_ERR("frame read with FIFO errors: 0x%x",
+                        (uint32_t)data->status_raw);
+                return -EBADMSG;
+        }
+
+        return 0;
+}
+
 static void bofp1_rtio_finish(struct rtio *r, const struct rtio_sqe *sqe,
                               void *dev_arg)
 {
-        ARG_UNUSED(r);
-        ARG_UNUSED(sqe);
-
         const struct device *dev = dev_arg;
         struct bofp1_data *data = dev->data;
+        int ret;
+
+        /* Also reached after a reset, which is not a readout */
+        if (atomic_get(&data->status) == 0) {
+                ret = bofp1_frame_check(dev);
+                if (ret != 0) {
+                        bofp1_set_status(dev, ret);
+                        bofp1_rtio_err(r, sqe, dev_arg);
+                        return;
+                }
+
+                bofp1_stats_end(dev, BOFP1_PHASE_CHUNK);
+                bofp1_stats_end(dev, BOFP1_PHASE_READOUT);
+
+                /* The header keeps the integration time of this frame */
+                bofp1_ae_update(dev);
+        }
 
         if (data->status_raw != 0) {
                 LOG_WRN("read produced errors: 0x%x",
                         (uint32_t)data->status_raw);
         }
 
+        data->header.status = data->status_raw;
+        (void)memcpy(data->header.stats, data->stats_raw,
+                     sizeof(data->header.stats));
+        (void)memcpy(data->wr_buf, &data->header, sizeof(data->header));
+
         bofp1_finish(dev_arg, atomic_get(&data->status));
 }
 
@@ -217,22 +713,27 @@ static void bofp1_rtio_err(struct rtio *r, const struct rtio_sqe *sqe,
         ARG_UNUSED(sqe);
 
         uint8_t reg_reset[2];
-        uint8_t reg_conf_sh[6];
-        uint8_t reg_conf_cap[4];
+        uint8_t reg_conf[2];
         const struct device *dev = dev_arg;
         struct bofp1_data *data = dev->data;
         struct rtio_sqe *reset;
-        struct rtio_sqe *conf_sh;
-        struct rtio_sqe *conf_cap;
+        struct rtio_sqe *conf_cmd;
+        struct rtio_sqe *conf_regs;
         struct rtio_sqe *finish;
 
         reset = rtio_sqe_acquire(data->rtio_ctx);
-        conf_sh = rtio_sqe_acquire(data->rtio_ctx);
-        conf_cap = rtio_sqe_acquire(data->rtio_ctx);
+        conf_cmd = rtio_sqe_acquire(data->rtio_ctx);
+        conf_regs = rtio_sqe_acquire(data->rtio_ctx);
         finish = rtio_sqe_acquire(data->rtio_ctx);
 
         LOG_INF("resetting FPGA");
 
+        /* Do not trust the dark current map after a reset */
+        bofp1_dc_invalidate(dev);
+
+        /* The reset returns the FPGA to single captures */
+        atomic_clear_bit(&data->state, BOFP1_CAPTURING);
+
         /* The FPGA can handle two consecutive commands, but it requires
          * some clock cycles to perform the reset and we should therefore split
          * the transaction into two. The delay on the MCU between these two
@@ -240,32 +741,23 @@ static void bofp1_rtio_err(struct rtio *r, const struct rtio_sqe *sqe,
         reg_reset[0] = BOFP1_WRITE_REG(BOFP1_REG_RESET); /* Reset */
         reg_reset[1] = 0;
 
-        /* Tiny writes are hard-coded capped at 7 bytes, so the
-         * transaction for configuration needs to be split into two
-         * transactions. */
-        reg_conf_sh[0] = BOFP1_WRITE_REG(BOFP1_REG_CCD_SH1); /* Set SH div */
-        reg_conf_sh[1] = data->shdiv[0];
-        reg_conf_sh[2] = BOFP1_WRITE_REG(BOFP1_REG_CCD_SH2); /* Set SH div */
-        reg_conf_sh[3] = data->shdiv[1];
-        reg_conf_sh[4] = BOFP1_WRITE_REG(BOFP1_REG_CCD_SH3); /* Set SH div */
-        reg_conf_sh[5] = data->shdiv[2];
-
-        /* Configure pipeline-specific registers */
-        reg_conf_cap[0] = BOFP1_WRITE_REG(BOFP1_REG_MOVING_AVG_N);
-        reg_conf_cap[1] = data->moving_avg_n;
-        reg_conf_cap[2] = BOFP1_WRITE_REG(BOFP1_REG_TOTAL_AVG_N);
-        reg_conf_cap[3] = data->total_avg_n;
+        /* The whole configuration, which the reset returns to the
+         * defaults, is restored with a single burst from the shadow
+         * register file. It stays untouched until the readout finishes. */
+        bofp1_regs_pack(dev);
+        reg_conf[0] = BOFP1_WRITE_REG(BOFP1_REGS_FIRST) | BOFP1_REG_BIT_BURST;
+        reg_conf[1] = sizeof(data->regs);
 
         rtio_sqe_prep_tiny_write(reset, data->iodev_bus, RTIO_PRIO_NORM,
                                  reg_reset, sizeof(reg_reset), NULL);
-        rtio_sqe_prep_tiny_write(conf_sh, data->iodev_bus, RTIO_PRIO_NORM,
-                                 reg_conf_sh, sizeof(reg_conf_sh), NULL);
-        rtio_sqe_prep_tiny_write(conf_cap, data->iodev_bus, RTIO_PRIO_NORM,
-                                 reg_conf_cap, sizeof(reg_conf_cap), NULL);
+        rtio_sqe_prep_tiny_write(conf_cmd, data->iodev_bus, RTIO_PRIO_NORM,
+                                 reg_conf, sizeof(reg_conf), NULL);
+        rtio_sqe_prep_write(conf_regs, data->iodev_bus, RTIO_PRIO_NORM,
+                            data->regs, sizeof(data->regs), NULL);
 
         reset->flags = RTIO_SQE_CHAINED;
-        conf_sh->flags = RTIO_SQE_CHAINED;
-        conf_cap->flags = RTIO_SQE_CHAINED;
+        conf_cmd->flags = RTIO_SQE_TRANSACTION;
+        conf_regs->flags = RTIO_SQE_CHAINED;
 
         rtio_sqe_prep_callback(finish, bofp1_rtio_finish, (void *)dev, NULL);
 
@@ -275,36 +767,214 @@ static void bofp1_rtio_err(struct rtio *r, const struct rtio_sqe *sqe,
 static void bofp1_rtio_continue(struct rtio *r, const struct rtio_sqe *sqe,
                                 void *dev_arg)
 {
-        ARG_UNUSED(r);
-        ARG_UNUSED(sqe);
+        int ret;
+
+        ret = bofp1_frame_check(dev_arg);
+        if (ret != 0) {
+                bofp1_set_status(dev_arg, ret);
+                bofp1_rtio_err(r, sqe, dev_arg);
+                return;
+        }
+
+        bofp1_stats_end(dev_arg, BOFP1_PHASE_CHUNK);
 
         if (!bofp1_gpio_check(dev_arg)) {
                 bofp1_enable_read(dev_arg);
         }
 }
 
+/** @brief Queue a read of the frame statistics latched by the FPGA */
+static int bofp1_prep_stats_read(const struct device *dev)
+{
+        struct bofp1_data *data = dev->data;
+        struct rtio_sqe *wr_stats;
+        struct rtio_sqe *rd_stats;
+        uint8_t reg[2];
+
+        wr_stats = rtio_sqe_acquire(data->rtio_ctx);
+        rd_stats = rtio_sqe_acquire(data->rtio_ctx);
+        if (wr_stats == NULL || rd_stats == NULL) {
+                return -ENOMEM;
+        }
+
+        reg[0] = BOFP1_READ_REG(BOFP1_REG_STREAM_STATS);
+        reg[1] = 0;
+        rtio_sqe_prep_tiny_write(wr_stats, data->iodev_bus, RTIO_PRIO_HIGH, reg,
+                                 sizeof(reg), NULL);
+        rtio_sqe_prep_read(rd_stats, data->iodev_bus, RTIO_PRIO_HIGH,
+                           data->stats_raw, sizeof(data->stats_raw), NULL);
+
+        wr_stats->flags = RTIO_SQE_TRANSACTION;
+        rd_stats->flags = RTIO_SQE_CHAINED;
+
+        return 0;
+}
+
+/** @brief Queue a read of @p size bytes from the stream register @p reg */
+static int bofp1_prep_stream_read(const struct device *dev, uint8_t reg,
+                                  uint8_t *buf, size_t size)
+{
+        struct bofp1_data *data = dev->data;
+        struct rtio_sqe *wr_reg;
+        struct rtio_sqe *rd_data;
+        uint8_t cmd[2];
+
+        wr_reg = rtio_sqe_acquire(data->rtio_ctx);
+        rd_data = rtio_sqe_acquire(data->rtio_ctx);
+        if (wr_reg == NULL || rd_data == NULL) {
+                return -ENOMEM;
+        }
+
+        cmd[0] = BOFP1_READ_REG(reg);
+        cmd[1] = 0;
+        rtio_sqe_prep_tiny_write(wr_reg, data->iodev_bus, RTIO_PRIO_HIGH, cmd,
+                                 sizeof(cmd), NULL);
+        rtio_sqe_prep_read(rd_data, data->iodev_bus, RTIO_PRIO_HIGH, buf, size,
+                           NULL);
+
+        wr_reg->flags = RTIO_SQE_TRANSACTION;
+        rd_data->flags = RTIO_SQE_CHAINED;
+
+        return 0;
+}
+
+/**
+ * @brief Queue a framed read of @p size bytes of pipeline data
+ *
+ * The length is sent along with the command. The FPGA answers with a header
+ * holding the sequence number and length, followed by the payload, a CRC
+ * and the status sampled after the payload, all within the same
+ * transaction. The framing is checked by bofp1_frame_check() once the read
+ * completes.
+ *
+ * @param dev
+ * @param buf Buffer for the payload
+ * @param size Size of the payload in bytes
+ * @param first First framed read of the frame, which starts the sequence
+ * @return int
+ * @retval 0 Success
+ * @retval -ENOMEM Out of sqes
+ */
+static int bofp1_prep_framed_read(const struct device *dev, uint8_t *buf,
+                                  size_t size, bool first)
+{
+        struct bofp1_data *data = dev->data;
+        struct rtio_sqe *wr_cmd;
+        struct rtio_sqe *rd_hdr;
+        struct rtio_sqe *rd_data;
+        struct rtio_sqe *rd_trl;
+        uint8_t cmd[4];
+
+        wr_cmd = rtio_sqe_acquire(data->rtio_ctx);
+        rd_hdr = rtio_sqe_acquire(data->rtio_ctx);
+        rd_data = rtio_sqe_acquire(data->rtio_ctx);
+        rd_trl = rtio_sqe_acquire(data->rtio_ctx);
+        if (wr_cmd == NULL || rd_hdr == NULL || rd_data == NULL ||
+            rd_trl == NULL) {
+                return -ENOMEM;
+        }
+
+        /* Length in words, followed by a dummy byte to complete the word */
+        cmd[0] = BOFP1_READ_REG(BOFP1_REG_STREAM_FRAMED);
+        sys_put_be16(size / sizeof(uint16_t), &cmd[1]);
+        cmd[3] = 0;
+        rtio_sqe_prep_tiny_write(wr_cmd, data->iodev_bus, RTIO_PRIO_HIGH, cmd,
+                                 sizeof(cmd), NULL);
+        rtio_sqe_prep_read(rd_hdr, data->iodev_bus, RTIO_PRIO_HIGH,
+                           data->frame_hdr, sizeof(data->frame_hdr), NULL);
+        rtio_sqe_prep_read(rd_data, data->iodev_bus, RTIO_PRIO_HIGH, buf, size,
+                           NULL);
+        rtio_sqe_prep_read(rd_trl, data->iodev_bus, RTIO_PRIO_HIGH,
+                           data->frame_trl, sizeof(data->frame_trl), NULL);
+
+        wr_cmd->flags = RTIO_SQE_TRANSACTION;
+        rd_hdr->flags = RTIO_SQE_TRANSACTION;
+        rd_data->flags = RTIO_SQE_TRANSACTION;
+        rd_trl->flags = RTIO_SQE_CHAINED;
+
+        data->frame_buf = buf;
+        data->frame_len = size;
+        data->frame_first = first;
+
+        return 0;
+}
+
+/**
+ * @brief Size of the pipeline data produced once @p raw pixels are captured
+ *
+ * Follows the pixels through the moving average, binning and region of
+ * interest, so that a dual readout never reads ahead of the pipeline.
+ */
+static size_t bofp1_pl_avail(const struct device *dev, size_t raw)
+{
+        struct bofp1_data *data = dev->data;
+        size_t window = bofp1_window(dev);
+        size_t n = raw;
+
+        n = n > window ? n - window : 0;
+
+        if (bofp1_get_prc(dev, BOFP1_PRC_BIN_ENA)) {
+                n >>= data->bin & BOFP1_BIN_SHIFT_MASK;
+        }
+
+        if (data->roi_len != 0) {
+                n = n > data->roi_start ?
+                            MIN(n - data->roi_start, data->roi_len) :
+                            0;
+        }
+
+        return MIN(n * sizeof(uint16_t), bofp1_frame_size(dev));
+}
+
 static void bofp1_data_read(const struct device *dev)
 {
         struct bofp1_data *data = dev->data;
         size_t size;
         size_t index;
-        uint8_t reg[2];
+        size_t frame_size;
+        size_t raw_size;
+        size_t raw_index;
+        size_t raw_frame_size;
+        size_t chunk;
         uint8_t status_reg;
-        struct rtio_sqe *wr_reg;
+        uint8_t *pl_buf;
         struct rtio_sqe *wr_status;
         struct rtio_sqe *rd_status;
-        struct rtio_sqe *rd_data;
         struct rtio_sqe *cb_action;
 
+        /* A frame of size 0 only reads out the statistics */
+        frame_size = bofp1_frame_size(dev);
+        raw_frame_size = bofp1_raw_frame_size(dev);
+        chunk = bofp1_read_chunk(dev) * sizeof(uint16_t);
+        pl_buf = data->wr_buf + sizeof(struct bofp1_rtio_header);
+
         index = data->wr_index;
-        if (index >= bofp1_frame_size(dev)) {
+        raw_index = data->raw_index;
+        if (frame_size + raw_frame_size != 0 && index >= frame_size &&
+            raw_index >= raw_frame_size) {
                 LOG_WRN("duplicate read detected");
                 return;
         }
 
-        size = bofp1_frame_size(dev) - index;
-        if (size > READ_CHUNK_SIZE) {
-                size = READ_CHUNK_SIZE;
+        size = frame_size - index;
+        raw_size = raw_frame_size - raw_index;
+
+        if (raw_frame_size != 0 && atomic_test_bit(&data->state, BOFP1_BUSY)) {
+                /* The raw FIFO sets the pace of a dual readout. Only the
+                 * pipeline data of the raw pixels read so far is certain to
+                 * be in the pipeline FIFO. */
+                raw_size = MIN(raw_size, chunk);
+                size = bofp1_pl_avail(dev, (raw_index + raw_size) /
+                                                   sizeof(uint16_t)) -
+                       index;
+        }
+
+        /* The frame buffer holds the complete frame by the time the
+         * watermark is raised or busy falls, so it is read out in one go.
+         * The FIFOs are drained a chunk at a time. */
+        if (!bofp1_get_prc(dev, BOFP1_PRC_FRAME_BUF) &&
+            (size > chunk || raw_size > chunk)) {
+                size = MIN(size, chunk);
 
                 if (!atomic_test_bit(&data->state, BOFP1_BUSY)) {
                         LOG_ERR("sensor completed while data is still in fifo");
@@ -318,55 +988,83 @@ static void bofp1_data_read(const struct device *dev)
                 }
         }
 
-        LOG_INF("index: %zu, size: %zu", index, size);
-
-        wr_reg = rtio_sqe_acquire(data->rtio_ctx);
-        rd_data = rtio_sqe_acquire(data->rtio_ctx);
-        wr_status = rtio_sqe_acquire(data->rtio_ctx);
-        rd_status = rtio_sqe_acquire(data->rtio_ctx);
-        cb_action = rtio_sqe_acquire(data->rtio_ctx);
+        LOG_INF("index: %zu, size: %zu, raw index: %zu, raw size: %zu", index,
+                size, raw_index, raw_size);
 
-        if (wr_reg == NULL || rd_data == NULL || cb_action == NULL ||
-            wr_status == NULL || rd_status == NULL) {
-                bofp1_finish(dev, -ENOMEM);
-                return;
+        if (index == 0) {
+                bofp1_stats_end(dev, BOFP1_PHASE_SAMPLE);
+                bofp1_stats_begin(dev, BOFP1_PHASE_READOUT);
         }
 
-        /* Read stream data */
-        reg[0] = BOFP1_READ_REG(BOFP1_REG_STREAM);
-        reg[1] = 0;
-        rtio_sqe_prep_tiny_write(wr_reg, data->iodev_bus, RTIO_PRIO_HIGH, reg,
-                                 sizeof(reg), NULL);
-        rtio_sqe_prep_read(rd_data, data->iodev_bus, RTIO_PRIO_HIGH,
-                           data->wr_buf + sizeof(struct bofp1_rtio_header) +
-                                   index,
-                           size, NULL);
+        bofp1_stats_begin(dev, BOFP1_PHASE_CHUNK);
 
-        wr_reg->flags = RTIO_SQE_TRANSACTION;
-        rd_data->flags = RTIO_SQE_CHAINED;
+        /* Raw data is stored after the processed frame */
+        if (raw_size > 0 &&
+            bofp1_prep_stream_read(dev, BOFP1_REG_STREAM_RAW,
+                                   pl_buf + frame_size + raw_index,
+                                   raw_size) != 0) {
+                goto nomem;
+        }
 
-        /* Read status flag */
-        status_reg = BOFP1_READ_REG(BOFP1_REG_STATUS);
-        rtio_sqe_prep_tiny_write(wr_status, data->iodev_bus, RTIO_PRIO_HIGH,
-                                 &status_reg, sizeof(status_reg), NULL);
-        rtio_sqe_prep_read(rd_status, data->iodev_bus, RTIO_PRIO_HIGH,
-                           &data->status_raw, sizeof(data->status_raw), NULL);
+        /* The status comes with the header of framed pipeline data, and
+         * is only read separately for a chunk without any */
+        if (size > 0) {
+                if (bofp1_prep_framed_read(dev, pl_buf + index, size,
+                                           index == 0) != 0) {
+                        goto nomem;
+                }
+        } else {
+                wr_status = rtio_sqe_acquire(data->rtio_ctx);
+                rd_status = rtio_sqe_acquire(data->rtio_ctx);
+                if (wr_status == NULL || rd_status == NULL) {
+                        goto nomem;
+                }
+
+                status_reg = BOFP1_READ_REG(BOFP1_REG_STATUS);
+                rtio_sqe_prep_tiny_write(wr_status, data->iodev_bus,
+                                         RTIO_PRIO_HIGH, &status_reg,
+                                         sizeof(status_reg), NULL);
+                rtio_sqe_prep_read(rd_status, data->iodev_bus, RTIO_PRIO_HIGH,
+                                   &data->status_raw,
+                                   sizeof(data->status_raw), NULL);
 
-        wr_status->flags = RTIO_SQE_TRANSACTION;
-        rd_status->flags = RTIO_SQE_CHAINED;
+                wr_status->flags = RTIO_SQE_TRANSACTION;
+                rd_status->flags = RTIO_SQE_CHAINED;
+        }
 
         data->wr_index += size;
-        if (data->wr_index >= bofp1_frame_size(dev)) {
-                /* Finish up */
+        data->raw_index += raw_size;
+        if (data->wr_index >= frame_size &&
+            data->raw_index >= raw_frame_size) {
+                /* Finish up, with the statistics of the completed frame */
+                if (bofp1_prep_stats_read(dev) != 0) {
+                        goto nomem;
+                }
+
+                cb_action = rtio_sqe_acquire(data->rtio_ctx);
+                if (cb_action == NULL) {
+                        goto nomem;
+                }
+
                 rtio_sqe_prep_callback(cb_action, bofp1_rtio_finish,
                                        (void *)dev, NULL);
         } else {
+                cb_action = rtio_sqe_acquire(data->rtio_ctx);
+                if (cb_action == NULL) {
+                        goto nomem;
+                }
+
                 /* Re-enable read */
                 rtio_sqe_prep_callback(cb_action, bofp1_rtio_continue,
                                        (void *)dev, NULL);
         }
 
         rtio_submit(data->rtio_ctx, 0);
+        return;
+
+nomem:
+        rtio_sqe_drop_all(data->rtio_ctx);
+        bofp1_finish(dev, -ENOMEM);
 }
 
 static void bofp1_data_read_work(struct rtio_iodev_sqe *iodev_sqe)
@@ -389,19 +1087,44 @@ static void bofp1_abort_work(struct rtio_iodev_sqe *iodev_sqe)
         bofp1_rtio_err(data->rtio_ctx, NULL, (void *)dev);
 }
 
+static int bofp1_check_triggers(const struct sensor_read_config *config)
+{
+        for (size_t i = 0; i < config->count; i++) {
+                if (config->triggers[i].trigger != SENSOR_TRIG_DATA_READY ||
+                    config->triggers[i].opt != SENSOR_STREAM_DATA_INCLUDE) {
+                        return -ENOTSUP;
+                }
+        }
+
+        return 0;
+}
+
 void bofp1_submit(const struct device *dev, struct rtio_iodev_sqe *iodev_sqe)
 {
+        int status;
         struct rtio_work_req *work;
         const struct sensor_read_config *config = iodev_sqe->sqe.iodev->data;
         struct bofp1_data *data = dev->data;
 
-        __ASSERT(!config->is_streaming, "streaming not supported");
+        if (config->is_streaming) {
+                /* Only a complete frame is supported as stream trigger */
+                status = bofp1_check_triggers(config);
+                if (status != 0) {
+                        LOG_ERR("unsupported stream trigger");
+                        rtio_iodev_sqe_err(iodev_sqe, status);
+                        return;
+                }
+
+                work = rtio_work_req_alloc();
+                rtio_work_req_submit(work, iodev_sqe, bofp1_submit_stream);
+                return;
+        }
 
         /* Lock must be held for the entire transmission */
         (void)k_sem_take(&data->lock, K_FOREVER);
 
         work = rtio_work_req_alloc();
-        rtio_work_req_submit(work, iodev_sqe, bofp1_submit_fetch);
+        rtio_work_req_submit(work, iodev_sqe, bofp1_submit_oneshot);
 }
 
 void bofp1_rtio_read(const struct device *dev)
@@ -450,12 +1173,56 @@ void bofp1_rtio_watchdog(struct k_work *work)
         rtio_work_req_submit(req, data->iodev_sqe, bofp1_abort_work);
 }
 
+static void bofp1_light_linger_work(struct k_work *work)
+{
+        struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+        struct bofp1_data *data =
+                CONTAINER_OF(dwork, struct bofp1_data, light_linger_work);
+        k_timeout_t settle;
+
+        /* The lock is held by a sample, which cancels or reschedules the
+         * release once it is done, but also by the attribute setters. Try
+         * again later rather than leave the light on. */
+        if (k_sem_take(&data->lock, K_NO_WAIT) != 0) {
+                (void)k_work_reschedule(dwork, K_MSEC(BOFP1_LINGER_RETRY_MS));
+                return;
+        }
+
+        /* A stream owns the light in between frames */
+        if (!atomic_test_bit(&data->state, BOFP1_STREAMING)) {
+                (void)bofp1_light(data->dev, false, &settle);
+        }
+
+        k_sem_give(&data->lock);
+}
+
+static void bofp1_buf_wait_work(struct k_work *work)
+{
+        struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+        struct bofp1_data *data =
+                CONTAINER_OF(dwork, struct bofp1_data, buf_wait_work);
+        struct rtio_work_req *req;
+
+        /* Ended by a sample while waiting */
+        if (data->stream_sqe == NULL) {
+                return;
+        }
+
+        req = rtio_work_req_alloc();
+        __ASSERT_NO_MSG(req != NULL);
+
+        rtio_work_req_submit(req, data->stream_sqe, bofp1_submit_stream);
+}
+
 int bofp1_rtio_init(const struct device *dev)
 {
         struct bofp1_data *data = dev->data;
 
         k_work_init_delayable(&data->light_wait_work, bofp1_light_ready_work);
+        k_work_init_delayable(&data->light_linger_work,
+                              bofp1_light_linger_work);
         k_work_init_delayable(&data->watchdog_work, bofp1_rtio_watchdog);
+        k_work_init_delayable(&data->buf_wait_work, bofp1_buf_wait_work);
 
         return 0;
 }
@@ -0,0 +1,109 @@
+
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/util.h>
+
+#include <drivers/sensor/bofp1.h>
+
+#include "bofp1.h"
+
+static void bofp1_stats_record(struct bofp1_phase_stats *stats, uint32_t us)
+{
+        size_t bucket;
+
+        if (stats->count == 0 || us < stats->min) {
+                stats->min = us;
+        }
+
+        if (us > stats->max) {
+                stats->max = us;
+        }
+
+        stats->count++;
+        stats->sum += us;
+
+        bucket = us == 0 ? 0 : LOG2(us);
+        stats->hist[MIN(bucket, BOFP1_STATS_BUCKETS - 1)]++;
+}
+
+void bofp1_stats_begin(const struct device *dev, enum bofp1_phase phase)
+{
+        struct bofp1_data *data = dev->data;
+        struct bofp1_stats *stats = &data->stats;
+        k_spinlock_key_t key;
+
+        key = k_spin_lock(&stats->lock);
+
+        stats->start[phase] = bofp1_cycles();
+        stats->active |= BIT(phase);
+
+        k_spin_unlock(&stats->lock, key);
+}
+
+void bofp1_stats_end(const struct device *dev, enum bofp1_phase phase)
+{
+        struct bofp1_data *data = dev->data;
+        struct bofp1_stats *stats = &data->stats;
+        k_spinlock_key_t key;
+        uint64_t cycles;
+
+        cycles = bofp1_cycles();
+
+        key = k_spin_lock(&stats->lock);
+
+        /* Phases are skipped depending on the calibration policy, so an end
+         * without a begin is ignored */
+        if (stats->active & BIT(phase)) {
+                stats->active &= ~BIT(phase);
+
+                cycles -= stats->start[phase];
+                if (!IS_ENABLED(CONFIG_TIMER_HAS_64BIT_CYCLE_COUNTER)) {
+                        cycles = (uint32_t)cycles;
+                }
+
+                bofp1_stats_record(&stats->phase[phase],
+                                   k_cyc_to_us_floor64(cycles));
+        }
+
+        k_spin_unlock(&stats->lock, key);
+}
+
+void bofp1_stats_cancel(const struct device *dev)
+{
+        struct bofp1_data *data = dev->data;
+        struct bofp1_stats *stats = &data->stats;
+        k_spinlock_key_t key;
+
+        key = k_spin_lock(&stats->lock);
+        stats->active = 0;
+        k_spin_unlock(&stats->lock, key);
+}
+
+int bofp1_get_phase_stats(const struct device *dev, enum bofp1_phase phase,
+                          struct bofp1_phase_stats *stats)
+{
+        struct bofp1_data *data = dev->data;
+        k_spinlock_key_t key;
+
+        if (phase >= BOFP1_PHASE_COUNT) {
+                return -EINVAL;
+        }
+
+        key = k_spin_lock(&data->stats.lock);
+        *stats = data->stats.phase[phase];
+        k_spin_unlock(&data->stats.lock, key);
+
+        return 0;
+}
+
+int bofp1_reset_phase_stats(const struct device *dev)
+{
+        struct bofp1_data *data = dev->data;
+        k_spinlock_key_t key;
+
+        key = k_spin_lock(&data->stats.lock);
+        (void)memset(data->stats.phase, 0, sizeof(data->stats.phase));
+        k_spin_unlock(&data->stats.lock, key);
+
+        return 0;
+}
@@ -4,13 +4,26 @@
 
 #include <zephyr/device.h>
 #include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
 
 typedef int (*light_on_t)(const struct device *);
 typedef int (*light_off_t)(const struct device *);
+typedef int (*light_get_settle_time_t)(const struct device *, uint32_t *);
 
 __subsystem struct light_driver_api {
         light_on_t light_on;
         light_off_t light_off;
+        light_get_settle_time_t get_settle_time;
+};
+
+/**
+ * @brief Data common to all light drivers
+ *
+ * Must be the first member of the driver data structure.
+ */
+struct light_driver_data {
+        /* Number of open light sessions */
+        atomic_t sessions;
 };
 
 /**
@@ -53,6 +66,87 @@ static inline int z_impl_light_off(const struct device *dev)
         return api->light_off(dev);
 }
 
+/**
+ * @brief Get the time the light source needs to settle after a change
+ *
+ * @param dev
+ * @param time_ms Settle time in milliseconds
+ * @return int
+ * @retval -ENOTSUP Driver does not implement `get_settle_time`
+ * @retval <0 Negative errno code
+ */
+__syscall int light_get_settle_time(const struct device *dev,
+                                    uint32_t *time_ms);
+
+static inline int z_impl_light_get_settle_time(const struct device *dev,
+                                               uint32_t *time_ms)
+{
+        const struct light_driver_api *api = dev->api;
+        if (api->get_settle_time == NULL) {
+                return -ENOTSUP;
+        }
+
+        return api->get_settle_time(dev, time_ms);
+}
+
+/**
+ * @brief Open a light session
+ *
+ * The light is turned on by the first session, and kept on until all
+ * sessions are closed with @ref light_session_put.
+ *
+ * @param dev
+ * @return int
+ * @retval 0 Light was already on
+ * @retval 1 Light was turned on, and needs to settle
+ * @retval <0 Negative errno code
+ */
+static inline int light_session_get(const struct device *dev)
+{
+        int status;
+        struct light_driver_data *data = dev->data;
+
+        if (atomic_inc(&data->sessions) != 0) {
+                return 0;
+        }
+
+        status = light_on(dev);
+        if (status != 0) {
+                (void)atomic_dec(&data->sessions);
+                return status;
+        }
+
+        return 1;
+}
+
+/**
+ * @brief Close a light session
+ *
+ * The light is turned off when the last session is closed.
+ *
+ * @param dev
+ * @return int
+ * @retval 0 Light is still held on by other sessions
+ * @retval 1 Light was turned off, and needs to settle
+ * @retval <0 Negative errno code
+ */
+static inline int light_session_put(const struct device *dev)
+{
+        int status;
+        struct light_driver_data *data = dev->data;
+
+        if (atomic_dec(&data->sessions) != 1) {
+                return 0;
+        }
+
+        status = light_off(dev);
+        if (status != 0) {
+                return status;
+        }
+
+        return 1;
+}
+
 #include <zephyr/syscalls/light.h>
 
 #endif /* DRV_LIGHT_H__ */
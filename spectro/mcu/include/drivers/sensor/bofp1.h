@@ -1,3 +1,5 @@
+#ifndef DRV_SENSOR_BOFP1_H__
+#define DRV_SENSOR_BOFP1_H__
 
 #include <zephyr/drivers/sensor.h>
 
@@ -7,9 +9,228 @@ enum sensor_attr_bofp1 {
         SENSOR_ATTR_BOFP1_MOVING_AVG_N,
         SENSOR_ATTR_BOFP1_TOTAL_AVG_ENA,
         SENSOR_ATTR_BOFP1_MOVING_AVG_ENA,
-        SENSOR_ATTR_BOFP1_DARK_CURRENT_ENA
+        SENSOR_ATTR_BOFP1_DARK_CURRENT_ENA,
+        /* Dark current calibration policy, see enum bofp1_dc_policy */
+        SENSOR_ATTR_BOFP1_DC_POLICY,
+        /* Max age of a cached dark current calibration (ms). 0 = no limit */
+        SENSOR_ATTR_BOFP1_DC_MAX_AGE,
+        /* Invalidate the dark current calibration. Write only */
+        SENSOR_ATTR_BOFP1_DC_INVALIDATE,
+        /* Only read the frame statistics, and skip the pixel readout */
+        SENSOR_ATTR_BOFP1_STATS_ONLY,
+        /* Target peak of the auto exposure (counts). The integration time
+         * is adjusted after every frame, until the peak of the frame is
+         * close to the target. The target should be below the saturation
+         * threshold of the FPGA. 0 = disabled */
+        SENSOR_ATTR_BOFP1_AUTO_EXPOSURE,
+        /* Region of interest on the processed frame. val1 is the index of
+         * the first pixel and val2 the number of pixels. Only these pixels
+         * are read out. A length of 0 reads out the entire frame */
+        SENSOR_ATTR_BOFP1_ROI,
+        /* Pixel binning after the dark current stage. val1 is the number of
+         * adjacent pixels per bin, 1, 2, 4 or 8, where 1 disables the
+         * stage. val2 is 1 to sum the pixels of a bin, saturating, or 0 to
+         * average them. The region of interest applies to the binned
+         * frame */
+        SENSOR_ATTR_BOFP1_BIN,
+        /* Also read the raw frame of the same exposure, decoded from
+         * channel index 1 of the intensity channels. Not supported along
+         * with the total average */
+        SENSOR_ATTR_BOFP1_DUAL_READOUT,
+        /* Hold complete frames in the double buffered frame store on the
+         * FPGA, instead of streaming them through the pipeline FIFO. The
+         * readout then waits for the frame to complete, but is never paced
+         * by the capture. Not supported along with the dual readout */
+        SENSOR_ATTR_BOFP1_FRAME_BUFFER,
+        /* How the FPGA starts the captures of a stream, see
+         * enum bofp1_capture_mode. Requires the frame buffer. The
+         * statistics are those of the last completed frame, which may be
+         * newer than the frame read out if the readout falls behind */
+        SENSOR_ATTR_BOFP1_CAPTURE_MODE,
+        /* Divider of the CCD master clock, from the FPGA clock. The MCLK
+         * frequency has to be within 800 kHz to 4 MHz. A faster clock
+         * reads out a frame quicker, at the cost of more noise. The
+         * integration time is kept */
+        SENSOR_ATTR_BOFP1_MCLK_DIV,
+        /* Pixels per SPI transfer when the FIFOs are read out, which is
+         * also the FIFO watermark. Rounded down to a multiple of 16, at
+         * most 1008. 0 picks the largest chunk that the FIFO can hold at
+         * the SPI and MCLK frequencies, see CONFIG_BOFP1_READ_LATENCY_US.
+         * Reads back the size in use */
+        SENSOR_ATTR_BOFP1_READ_CHUNK,
+        /* Number of taps of the FIR filter set by bofp1_set_fir(), 0 when
+         * the moving average is a plain boxcar average. Read only */
+        SENSOR_ATTR_BOFP1_FIR_TAPS,
+        /* Dark frames averaged by a dark current calibration, up to 255.
+         * 0 takes the total average setting instead */
+        SENSOR_ATTR_BOFP1_DC_FRAMES,
+        /* Max wait for the external trigger of a frame in a triggered
+         * stream (ms). The FPGA is reset and the stream fails when it
+         * passes. 0 = wait forever */
+        SENSOR_ATTR_BOFP1_TRIGGER_TIMEOUT,
+};
+
+enum bofp1_dc_policy {
+        /* Calibrate the dark current before every sample */
+        BOFP1_DC_POLICY_ALWAYS,
+        /* Reuse the calibration until settings change, it expires or it is
+         * invalidated. A calibration is kept for each of the last few
+         * integration times */
+        BOFP1_DC_POLICY_CACHED,
+};
+
+enum bofp1_capture_mode {
+        /* Every frame is started by the driver */
+        BOFP1_CAPTURE_SINGLE,
+        /* The FPGA captures a frame every integration time for as long as
+         * the stream runs */
+        BOFP1_CAPTURE_CONTINUOUS,
+        /* The FPGA captures a frame on every rising edge of the external
+         * trigger input, see SENSOR_ATTR_BOFP1_TRIGGER_TIMEOUT */
+        BOFP1_CAPTURE_TRIGGER,
 };
 
 enum sensor_channel_bofp1 {
-        SENSOR_CHAN_BOFP1_INTENSITY = SENSOR_ATTR_PRIV_START
+        /* Processed frame at index 0, and raw frame of a dual readout at
+         * index 1 */
+        SENSOR_CHAN_BOFP1_INTENSITY = SENSOR_ATTR_PRIV_START,
+        /* Same as SENSOR_CHAN_BOFP1_INTENSITY, but decoded as a plain array
+         * of uint16_t in CPU byte order, with up to max_count pixels per
+         * call. */
+        SENSOR_CHAN_BOFP1_INTENSITY_U16,
+        /* Metadata of the frame, decoded as one struct bofp1_frame_meta */
+        SENSOR_CHAN_BOFP1_META,
+        /* Statistics computed by the FPGA, decoded as one
+         * struct bofp1_frame_stats */
+        SENSOR_CHAN_BOFP1_STATS,
+};
+
+/* Pipeline stages enabled for a frame, see struct bofp1_frame_meta */
+#define BOFP1_META_DC      BIT(0)
+#define BOFP1_META_MOVAVG  BIT(1)
+#define BOFP1_META_TOTAVG  BIT(2)
+/* Pixels of a bin are summed rather than averaged */
+#define BOFP1_META_BIN_SUM BIT(3)
+
+struct bofp1_frame_meta {
+        /* Time the sample was started (ns since boot, in system ticks) */
+        uint64_t timestamp;
+        /* Integration time (ns) */
+        uint32_t integration_time;
+        /* Number of pixels in the frame */
+        uint16_t pixels;
+        /* Index of the first pixel, non-zero with a region of interest */
+        uint16_t offset;
+        /* Enabled pipeline stages, BOFP1_META_* */
+        uint8_t flags;
+        uint8_t moving_avg_n;
+        uint8_t total_avg_n;
+        /* Number of CCD elements per pixel */
+        uint8_t bin;
+        /* Error bits of the FPGA status register after the readout */
+        uint8_t status;
+};
+
+struct bofp1_frame_stats {
+        uint16_t min;
+        uint16_t max;
+        /* Index of the first pixel with the max value */
+        uint16_t argmax;
+        /* Number of pixels at or above the saturation threshold */
+        uint16_t saturated;
+        uint32_t sum;
+};
+
+enum bofp1_phase {
+        /* CCD flush and light settle before a sample */
+        BOFP1_PHASE_FLUSH,
+        /* Dark current calibration frame */
+        BOFP1_PHASE_DC_CALIB,
+        /* Light settle after the dark current calibration */
+        BOFP1_PHASE_LIGHT,
+        /* Sample trigger until the first FIFO watermark */
+        BOFP1_PHASE_SAMPLE,
+        /* SPI transfer of a single chunk */
+        BOFP1_PHASE_CHUNK,
+        /* First FIFO watermark until the readout is complete */
+        BOFP1_PHASE_READOUT,
+        /* Submission until completion of a sample */
+        BOFP1_PHASE_TOTAL,
+        BOFP1_PHASE_COUNT,
 };
+
+#define BOFP1_STATS_BUCKETS (16)
+
+struct bofp1_phase_stats {
+        uint32_t count;
+        /* Durations (us) */
+        uint32_t min;
+        uint32_t max;
+        uint64_t sum;
+        /* Bucket i counts durations of [2^i, 2^(i+1)) us. The first bucket
+         * also includes 0, and the last one everything above. */
+        uint32_t hist[BOFP1_STATS_BUCKETS];
+};
+
+/* Taps of the FIR filter, see bofp1_set_fir() */
+#define BOFP1_FIR_TAPS_MAX  (64)
+/* Fractional bits of the FIR coefficients */
+#define BOFP1_FIR_COEF_FRAC (14)
+
+/**
+ * @brief Smooth frames with a FIR filter in place of the moving average
+ *
+ * The filter is applied by the FPGA when the moving average is enabled,
+ * e.g. with a Savitzky-Golay or Gaussian kernel. Coefficients are signed
+ * fixed point with BOFP1_FIR_COEF_FRAC fractional bits, where the first one
+ * weights the leftmost pixel of the window. The output starts once the
+ * window is full, so a frame loses @p taps - 1 pixels.
+ *
+ * @param dev
+ * @param coefs Coefficients, @p taps of them
+ * @param taps Number of taps, 0 to go back to the boxcar average
+ * @return int
+ * @retval 0 Success
+ * @retval -EINVAL More than BOFP1_FIR_TAPS_MAX taps
+ * @retval <0 Negative errno code
+ */
+int bofp1_set_fir(const struct device *dev, const int16_t *coefs,
+                  size_t taps);
+
+#if defined(CONFIG_BOFP1_STATS)
+/**
+ * @brief Get latency statistics of a readout phase
+ *
+ * @param dev
+ * @param phase
+ * @param stats
+ * @return int
+ * @retval 0 Success
+ * @retval -EINVAL Invalid phase
+ */
+int bofp1_get_phase_stats(const struct device *dev, enum bofp1_phase phase,
+                          struct bofp1_phase_stats *stats);
+
+/**
+ * @brief Reset latency statistics of all phases
+ *
+ * @param dev
+ * @return int
+ * @retval 0 Success
+ */
+int bofp1_reset_phase_stats(const struct device *dev);
+#else
+static inline int bofp1_get_phase_stats(const struct device *dev,
+                                        enum bofp1_phase phase,
+                                        struct bofp1_phase_stats *stats)
+{
+        return -ENOTSUP;
+}
+
+static inline int bofp1_reset_phase_stats(const struct device *dev)
+{
+        return -ENOTSUP;
+}
+#endif
+
+#endif /* DRV_SENSOR_BOFP1_H__ */
@@ -0,0 +1,78 @@
+#include <zephyr/ztest.h>
+
+#include "bofp1.h"
+
+/* MCLK of the BOMC1, the slowest one in use */
+#define MCLK_FREQ (800000)
+#define TARGET    (50000)
+
+static uint32_t ae_min(void)
+{
+        return MCLK_FREQ / (NSEC_PER_SEC / BOFP1_AE_MIN_TIME_NS);
+}
+
+static uint32_t ae_max(void)
+{
+        return MIN(MCLK_FREQ, BIT(24));
+}
+
+/* Step the auto exposure with the same frame until it settles */
+static uint32_t ae_run(uint32_t cur, uint32_t peak, uint32_t saturated)
+{
+        uint32_t next;
+
+        for (int i = 0; i < 32; i++) {
+                next = bofp1_ae_next(cur, peak, saturated, TARGET, ae_min(),
+                                     ae_max());
+                zassert_between_inclusive(next, ae_min(), ae_max());
+
+                /* As in bofp1_integration_time() */
+                zassert_not_equal(MCLK_FREQ / next, 0);
+
+                if (next == cur) {
+                        return cur;
+                }
+
+                cur = next;
+        }
+
+        zassert_unreachable("auto exposure did not settle");
+
+        return cur;
+}
+
+ZTEST(bofp1_ae, test_dark_saturates)
+{
+        uint32_t cur = ae_run(ae_min(), 0, 0);
+
+        zassert_equal(cur, ae_max());
+        zassert_equal(NSEC_PER_SEC / (MCLK_FREQ / cur), NSEC_PER_SEC);
+}
+
+ZTEST(bofp1_ae, test_saturated_shortens)
+{
+        zassert_equal(ae_run(ae_max(), 0xffff, 1), ae_min());
+}
+
+ZTEST(bofp1_ae, test_linear)
+{
+        zassert_equal(bofp1_ae_next(1000, TARGET / 2, 0, TARGET, ae_min(),
+                                    ae_max()),
+                      2000);
+        zassert_equal(bofp1_ae_next(1000, TARGET * 2, 0, TARGET, ae_min(),
+                                    ae_max()),
+                      500);
+}
+
+ZTEST(bofp1_ae, test_hysteresis)
+{
+        uint32_t peak = TARGET + (TARGET >> BOFP1_AE_HYST_SHIFT);
+
+        zassert_equal(bofp1_ae_next(1000, peak, 0, TARGET, ae_min(), ae_max()),
+                      1000);
+        zassert_not_equal(bofp1_ae_next(1000, peak + 1, 0, TARGET, ae_min(),
+                                        ae_max()),
+                          1000);
+}
+
+ZTEST_SUITE(bofp1_ae, NULL, NULL, NULL, NULL, NULL);